@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "CpuProfiler.h"
 
 Camera::Camera()
 	: position(glm::vec3(0.0f, 0.0f, 0.0f)),
@@ -28,6 +29,7 @@ Camera::Camera(glm::vec3 startPosition, glm::vec3 startUp, GLfloat startYaw, GLf
 }
 
 void Camera::keyControl(bool* keys, GLfloat deltaTime) {
+	PROFILE_ZONE("Camera::keyControl");
 
 	GLfloat velocity = moveSpeed * deltaTime;
 
@@ -46,6 +48,7 @@ void Camera::keyControl(bool* keys, GLfloat deltaTime) {
 }
 
 void Camera::mouseControl(GLfloat xChange, GLfloat yChange) {
+	PROFILE_ZONE("Camera::mouseControl");
 	xChange *= turnSpeed;
 	yChange *= turnSpeed;
 
@@ -72,6 +75,13 @@ void Camera::update() {
 	up = glm::normalize(glm::cross(right, front));
 }
 
+void Camera::setPose(glm::vec3 newPosition, GLfloat newYaw, GLfloat newPitch) {
+	position = newPosition;
+	yaw = newYaw;
+	pitch = newPitch;
+	update();
+}
+
 glm::mat4 Camera::calculateViewMatrix() {
 	return glm::lookAt(position, position + front, up);
 }
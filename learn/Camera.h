@@ -1,3 +1,4 @@
+#pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <GLFW/glfw3.h>
@@ -12,6 +13,10 @@ public:
 	glm::mat4 calculateViewMatrix();
 	glm::vec3 getCameraPosition();
 	glm::vec3 getCameraDirecion();
+	GLfloat getYaw() { return yaw; }
+	GLfloat getPitch() { return pitch; }
+	// Jumps straight to a pose, e.g. one read back from a recorded path.
+	void setPose(glm::vec3 newPosition, GLfloat newYaw, GLfloat newPitch);
 	~Camera();
 
 private:
@@ -0,0 +1,113 @@
+#include "CameraPath.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+const float CameraPath::FIXED_TIMESTEP = 1.0f / 60.0f;
+
+static const uint32_t PATH_MAGIC = 0x48545043;  // "CPTH"
+static const uint32_t PATH_VERSION = 1;
+
+// Keys that switch rendering settings. Movement keys aren't needed: their
+// effect is already in the recorded pose.
+static const int RECORDED_KEYS[] = {
+	GLFW_KEY_F1, GLFW_KEY_F2, GLFW_KEY_F3, GLFW_KEY_F4, GLFW_KEY_F5, GLFW_KEY_F6,
+	GLFW_KEY_F7, GLFW_KEY_F8, GLFW_KEY_F9, GLFW_KEY_F10, GLFW_KEY_F11, GLFW_KEY_F12,
+	GLFW_KEY_P, GLFW_KEY_O
+};
+static const int RECORDED_KEY_COUNT = sizeof(RECORDED_KEYS) / sizeof(RECORDED_KEYS[0]);
+
+CameraPath::CameraPath() {}
+
+void CameraPath::RecordFrame(Camera& camera, const bool* keys) {
+	PathFrame frame;
+	frame.position = camera.getCameraPosition();
+	frame.yaw = camera.getYaw();
+	frame.pitch = camera.getPitch();
+	frame.keys = 0;
+	for (int i = 0; i < RECORDED_KEY_COUNT; i++) {
+		if (keys[RECORDED_KEYS[i]]) {
+			frame.keys |= 1u << i;
+		}
+	}
+	frames.push_back(frame);
+}
+
+void CameraPath::ApplyFrame(unsigned int frame, Camera& camera, bool* keys) const {
+	if (frame >= frames.size()) {
+		return;
+	}
+	const PathFrame& recorded = frames[frame];
+	camera.setPose(recorded.position, recorded.yaw, recorded.pitch);
+	for (int i = 0; i < RECORDED_KEY_COUNT; i++) {
+		keys[RECORDED_KEYS[i]] = (recorded.keys & (1u << i)) != 0;
+	}
+}
+
+bool CameraPath::Save(const char* path) const {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		printf("Failed to open %s for the camera path\n", path);
+		return false;
+	}
+
+	uint32_t header[3] = { PATH_MAGIC, PATH_VERSION, static_cast<uint32_t>(frames.size()) };
+	bool written = fwrite(header, sizeof(header), 1, file) == 1;
+	for (size_t i = 0; i < frames.size() && written; i++) {
+		const PathFrame& frame = frames[i];
+		float pose[5] = { frame.position.x, frame.position.y, frame.position.z, frame.yaw, frame.pitch };
+		uint32_t keys = frame.keys;
+		written = fwrite(pose, sizeof(pose), 1, file) == 1 && fwrite(&keys, sizeof(keys), 1, file) == 1;
+	}
+	fclose(file);
+
+	if (!written) {
+		printf("Failed to write the camera path to %s\n", path);
+		return false;
+	}
+	printf("Saved %u camera path frames to %s\n", GetFrameCount(), path);
+	return true;
+}
+
+bool CameraPath::Load(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		printf("Failed to find: %s\n", path);
+		return false;
+	}
+
+	uint32_t header[3];
+	if (fread(header, sizeof(header), 1, file) != 1 || header[0] != PATH_MAGIC || header[1] != PATH_VERSION) {
+		printf("%s isn't a version %u camera path\n", path, PATH_VERSION);
+		fclose(file);
+		return false;
+	}
+
+	frames.clear();
+	frames.reserve(header[2]);
+	for (uint32_t i = 0; i < header[2]; i++) {
+		float pose[5];
+		uint32_t keys;
+		if (fread(pose, sizeof(pose), 1, file) != 1 || fread(&keys, sizeof(keys), 1, file) != 1) {
+			printf("%s ends after %u of %u frames\n", path, i, header[2]);
+			fclose(file);
+			return false;
+		}
+		PathFrame frame;
+		frame.position = glm::vec3(pose[0], pose[1], pose[2]);
+		frame.yaw = pose[3];
+		frame.pitch = pose[4];
+		frame.keys = keys;
+		frames.push_back(frame);
+	}
+	fclose(file);
+	return true;
+}
+
+void CameraPath::ClearCameraPath() {
+	frames.clear();
+}
+
+CameraPath::~CameraPath() {
+	ClearCameraPath();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+// A recorded camera flight for repeatable benchmarks. Each frame stores the
+// camera pose plus the state of the keys that change rendering settings, so
+// a replay sees the same views and the same mode switches on the same frames.
+//
+// Poses are stored rather than raw input: replaying input would only land on
+// the same path if every frame took exactly as long as when it was recorded.
+// A replay advances one recorded frame per simulated frame and reports
+// FIXED_TIMESTEP as the frame time, whatever the real frame rate.
+class CameraPath {
+public:
+	static const float FIXED_TIMESTEP;
+
+	CameraPath();
+
+	void RecordFrame(Camera& camera, const bool* keys);
+
+	// Poses the camera as in the given frame and overwrites the recorded keys
+	// in keys, so live presses of those keys don't leak into the replay.
+	void ApplyFrame(unsigned int frame, Camera& camera, bool* keys) const;
+	unsigned int GetFrameCount() const { return static_cast<unsigned int>(frames.size()); }
+
+	bool Save(const char* path) const;
+	bool Load(const char* path);
+
+	void ClearCameraPath();
+
+	~CameraPath();
+
+private:
+	struct PathFrame {
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+		// Bit i is RECORDED_KEYS[i].
+		unsigned int keys;
+	};
+
+	std::vector<PathFrame> frames;
+};
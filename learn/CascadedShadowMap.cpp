@@ -0,0 +1,276 @@
+#include "CascadedShadowMap.h"
+#include <math.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "GLState.h"
+#include "GpuMemory.h"
+
+static const char* shadowVertexShader = "shadowVertex.glsl";
+static const char* shadowFragmentShader = "depthFragment.glsl";
+
+// 0 = uniform splits, 1 = logarithmic splits.
+static const GLfloat SPLIT_BLEND = 0.75f;
+
+CascadedShadowMap::CascadedShadowMap() {
+	uniformLightViewProjection = 0;
+	framebufferID = 0;
+	shadowMapID = 0;
+	resolution = 0;
+	cascadeCount = 0;
+	shadowDistance = 40.0f;
+	nextCascade = 1;
+
+	for (int i = 0; i < MAX_SHADOW_CASCADES; i++) {
+		cascades[i].valid = false;
+	}
+	stats.rendered = 0;
+	stats.cached = 0;
+	stats.deferred = 0;
+	stats.castersCulled = 0;
+}
+
+bool CascadedShadowMap::CreateCascadedShadowMap(GLsizei mapResolution, int cascades) {
+	ClearCascadedShadowMap();
+
+	if (cascades < 1 || cascades > MAX_SHADOW_CASCADES) {
+		printf("Cascade count %d out of range [1, %d]\n", cascades, MAX_SHADOW_CASCADES);
+		return false;
+	}
+
+	shadowShader.CreateFromFiles(shadowVertexShader, shadowFragmentShader);
+	if (shadowShader.GetShaderID() == 0) {
+		return false;
+	}
+	uniformLightViewProjection = shadowShader.GetUniformLocation("lightViewProjection");
+
+	resolution = mapResolution;
+	cascadeCount = cascades;
+
+	shadowMapID = GpuMemory::CreateTexture(GPU_MEMORY_SHADOW, "shadow cascades", GL_TEXTURE_2D_ARRAY,
+		1, GL_DEPTH_COMPONENT32F, resolution, resolution, cascadeCount);
+	// Linear filtering with compare mode gives 2x2 PCF per tap for free.
+	glTextureParameteri(shadowMapID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(shadowMapID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(shadowMapID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(shadowMapID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(shadowMapID, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(shadowMapID, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// Cascades not rendered yet read as fully lit.
+	const GLfloat farDepth = 1.0f;
+	glClearTexImage(shadowMapID, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+
+	glCreateFramebuffers(1, &framebufferID);
+	glNamedFramebufferDrawBuffer(framebufferID, GL_NONE);
+	glNamedFramebufferReadBuffer(framebufferID, GL_NONE);
+	glNamedFramebufferTextureLayer(framebufferID, GL_DEPTH_ATTACHMENT, shadowMapID, 0, 0);
+
+	GLenum status = glCheckNamedFramebufferStatus(framebufferID, GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Shadow map framebuffer is incomplete: 0x%x\n", status);
+		ClearCascadedShadowMap();
+		return false;
+	}
+
+	return true;
+}
+
+glm::vec4 CascadedShadowMap::FitCascade(const glm::mat4& lightView, const glm::mat4& inverseView,
+	GLfloat tanHalfX, GLfloat tanHalfY, GLfloat nearSplit, GLfloat farSplit) const {
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++) {
+		GLfloat depth = (i & 4) ? farSplit : nearSplit;
+		glm::vec4 viewCorner(
+			((i & 1) ? 1.0f : -1.0f) * tanHalfX * depth,
+			((i & 2) ? 1.0f : -1.0f) * tanHalfY * depth,
+			-depth, 1.0f);
+		corners[i] = glm::vec3(inverseView * viewCorner);
+	}
+
+	glm::vec3 center(0.0f);
+	for (int i = 0; i < 8; i++) {
+		center += corners[i];
+	}
+	center /= 8.0f;
+
+	// The sphere, unlike a tight box, doesn't change size as the camera turns.
+	GLfloat radius = 0.0f;
+	for (int i = 0; i < 8; i++) {
+		radius = glm::max(radius, glm::length(corners[i] - center));
+	}
+	radius = ceilf(radius * 16.0f) / 16.0f;
+
+	// Move the centre in whole texels so the rasterised shadow doesn't crawl.
+	glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+	GLfloat texel = 2.0f * radius / resolution;
+	GLfloat depthStep = radius * 0.25f;
+	lightCenter.x = floorf(lightCenter.x / texel) * texel;
+	lightCenter.y = floorf(lightCenter.y / texel) * texel;
+	lightCenter.z = floorf(lightCenter.z / depthStep) * depthStep;
+
+	return glm::vec4(lightCenter, radius);
+}
+
+glm::mat4 CascadedShadowMap::CascadeProjection(glm::vec4 box) {
+	// Depth gets a quarter radius of slack for the snapped centre. Casters in
+	// front of the near plane are still caught by depth clamping.
+	GLfloat depthRange = box.w * 1.25f;
+	return glm::ortho(box.x - box.w, box.x + box.w, box.y - box.w, box.y + box.w,
+		-(box.z + depthRange), -(box.z - depthRange));
+}
+
+void CascadedShadowMap::Update(DrawBatch& batch, RingBuffer& ring,
+	const glm::mat4& view, const glm::mat4& projection, glm::vec3 lightDirection) {
+	stats.rendered = 0;
+	stats.cached = 0;
+	stats.deferred = 0;
+	stats.castersCulled = 0;
+
+	if (shadowMapID == 0) {
+		return;
+	}
+
+	lightDirection = glm::normalize(lightDirection);
+	glm::vec3 up = fabsf(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	// Rotation only, so snapping in light space is independent of the camera.
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+	// Frustum shape straight from the projection matrix.
+	GLfloat tanHalfX = 1.0f / fabsf(projection[0][0]);
+	GLfloat tanHalfY = 1.0f / fabsf(projection[1][1]);
+	GLfloat nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	GLfloat farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	farPlane = glm::min(farPlane, shadowDistance);
+
+	glm::mat4 inverseView = glm::inverse(view);
+
+	// Any moved, added or removed caster invalidates every cascade.
+	batch.GetDrawBounds(casterBounds);
+	if (casterBounds != renderedCasterBounds) {
+		for (int i = 0; i < cascadeCount; i++) {
+			cascades[i].valid = false;
+		}
+		renderedCasterBounds = casterBounds;
+	}
+
+	glm::vec4 boxes[MAX_SHADOW_CASCADES];
+	bool dirty[MAX_SHADOW_CASCADES];
+	GLfloat nearSplit = nearPlane;
+	for (int i = 0; i < cascadeCount; i++) {
+		GLfloat t = (GLfloat)(i + 1) / cascadeCount;
+		GLfloat uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+		GLfloat logSplit = nearPlane * powf(farPlane / nearPlane, t);
+		GLfloat farSplit = uniformSplit + (logSplit - uniformSplit) * SPLIT_BLEND;
+
+		boxes[i] = FitCascade(lightView, inverseView, tanHalfX, tanHalfY, nearSplit, farSplit);
+		dirty[i] = !cascades[i].valid || cascades[i].box != boxes[i] || cascades[i].lightDirection != lightDirection;
+		nearSplit = farSplit;
+	}
+
+	int budget = MAX_UPDATES_PER_FRAME;
+	if (dirty[0]) {
+		dirty[0] = !RenderCascade(0, batch, ring, lightView, lightDirection, boxes[0]);
+		budget--;
+	}
+	for (int n = 1; n < cascadeCount && budget > 0; n++) {
+		int i = nextCascade;
+		nextCascade = nextCascade + 1 < cascadeCount ? nextCascade + 1 : 1;
+		if (dirty[i]) {
+			dirty[i] = !RenderCascade(i, batch, ring, lightView, lightDirection, boxes[i]);
+			budget--;
+		}
+	}
+
+	for (int i = 0; i < cascadeCount; i++) {
+		if (dirty[i]) {
+			stats.deferred++;
+		}
+	}
+	stats.cached = cascadeCount - stats.rendered - stats.deferred;
+
+	if (stats.rendered > 0) {
+		glPolygonOffset(0.0f, 0.0f);
+		GLState::Disable(GL_POLYGON_OFFSET_FILL);
+		GLState::Disable(GL_DEPTH_CLAMP);
+		GLState::BindFramebuffer(0);
+	}
+}
+
+bool CascadedShadowMap::RenderCascade(int index, DrawBatch& batch, RingBuffer& ring,
+	const glm::mat4& lightView, glm::vec3 lightDirection, glm::vec4 box) {
+	// Caster culling: only the sides and the far end of the box bound what
+	// can cast into it; anything between the box and the light still counts.
+	GLfloat depthRange = box.w * 1.25f;
+	casterVisible.resize(casterBounds.size());
+	for (size_t i = 0; i < casterBounds.size(); i++) {
+		glm::vec3 center = glm::vec3(lightView * glm::vec4(glm::vec3(casterBounds[i]), 1.0f));
+		GLfloat reach = box.w + casterBounds[i].w;
+		bool visible = fabsf(center.x - box.x) <= reach
+			&& fabsf(center.y - box.y) <= reach
+			&& center.z + casterBounds[i].w >= box.z - depthRange;
+		casterVisible[i] = visible;
+		if (!visible) {
+			stats.castersCulled++;
+		}
+	}
+
+	GLintptr commands = 0;
+	if (!batch.UploadCommandSubset(ring, casterVisible, &commands)) {
+		return false;
+	}
+
+	Cascade& cascade = cascades[index];
+	cascade.matrix = CascadeProjection(box) * lightView;
+	cascade.box = box;
+	cascade.lightDirection = lightDirection;
+	cascade.valid = true;
+
+	glNamedFramebufferTextureLayer(framebufferID, GL_DEPTH_ATTACHMENT, shadowMapID, 0, index);
+	GLState::BindFramebuffer(framebufferID);
+	glViewport(0, 0, resolution, resolution);
+
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_DEPTH_CLAMP);
+	GLState::Enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	glDepthMask(GL_TRUE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	shadowShader.UseShader();
+	glUniformMatrix4fv(uniformLightViewProjection, 1, GL_FALSE, glm::value_ptr(cascade.matrix));
+	batch.RenderPositions(commands);
+
+	stats.rendered++;
+	return true;
+}
+
+void CascadedShadowMap::UseShadowMap(GLuint cascadeMatricesLocation, GLuint cascadeCountLocation) {
+	glm::mat4 matrices[MAX_SHADOW_CASCADES];
+	for (int i = 0; i < cascadeCount; i++) {
+		matrices[i] = cascades[i].matrix;
+	}
+
+	GLState::BindTexture(CASCADE_SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, shadowMapID);
+	glUniformMatrix4fv(cascadeMatricesLocation, cascadeCount, GL_FALSE, glm::value_ptr(matrices[0]));
+	glUniform1i(cascadeCountLocation, cascadeCount);
+}
+
+void CascadedShadowMap::ClearCascadedShadowMap() {
+	if (framebufferID != 0) {
+		GLState::ForgetFramebuffer(framebufferID);
+		glDeleteFramebuffers(1, &framebufferID);
+		framebufferID = 0;
+	}
+	GpuMemory::DeleteTexture(shadowMapID);
+	for (int i = 0; i < MAX_SHADOW_CASCADES; i++) {
+		cascades[i].valid = false;
+	}
+	renderedCasterBounds.clear();
+	resolution = 0;
+	cascadeCount = 0;
+	nextCascade = 1;
+	shadowShader.ClearShader();
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+	ClearCascadedShadowMap();
+}
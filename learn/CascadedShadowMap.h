@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "DrawBatch.h"
+#include "RingBuffer.h"
+#include "Shader.h"
+
+// Cascaded shadow maps for the directional light, one layer of a depth array
+// texture per cascade.
+//
+// The camera frustum up to the shadow distance is split into cascades
+// (blend of logarithmic and uniform splits). Each cascade is an orthographic
+// box around the bounding sphere of its frustum slice, snapped to whole
+// shadow texels so the map doesn't shimmer as the camera moves or turns.
+//
+// A cascade is only re-rendered when its snapped box, the light direction or
+// the shadow casters change, and at most MAX_UPDATES_PER_FRAME cascades are
+// rendered in one frame: the nearest cascade first, the rest round-robin.
+// Cascades that miss their turn keep the matrix they were rendered with, so
+// their shadows stay correct for everything that didn't move.
+class CascadedShadowMap {
+public:
+	struct UpdateStats {
+		unsigned int rendered;
+		unsigned int cached;
+		unsigned int deferred;
+		unsigned int castersCulled;
+	};
+
+	CascadedShadowMap();
+
+	bool CreateCascadedShadowMap(GLsizei mapResolution, int cascades);
+
+	void SetShadowDistance(GLfloat distance) { shadowDistance = distance; }
+
+	// Needs the batch's draw data for this frame to be uploaded already.
+	void Update(DrawBatch& batch, RingBuffer& ring,
+		const glm::mat4& view, const glm::mat4& projection, glm::vec3 lightDirection);
+	void UseShadowMap(GLuint cascadeMatricesLocation, GLuint cascadeCountLocation);
+
+	UpdateStats GetLastStats() const { return stats; }
+	int GetCascadeCount() const { return cascadeCount; }
+
+	void ClearCascadedShadowMap();
+
+	~CascadedShadowMap();
+
+	static const int MAX_UPDATES_PER_FRAME = 2;
+
+private:
+	struct Cascade {
+		glm::mat4 matrix;     // light view-projection the layer was rendered with
+		glm::vec4 box;        // snapped light-space centre and radius it was rendered for
+		glm::vec3 lightDirection;
+		bool valid;
+	};
+
+	Shader shadowShader;
+	GLuint uniformLightViewProjection;
+
+	GLuint framebufferID;
+	GLuint shadowMapID;
+	GLsizei resolution;
+	int cascadeCount;
+	GLfloat shadowDistance;
+
+	Cascade cascades[MAX_SHADOW_CASCADES];
+	int nextCascade;
+
+	std::vector<glm::vec4> casterBounds;
+	std::vector<glm::vec4> renderedCasterBounds;
+	std::vector<bool> casterVisible;
+
+	UpdateStats stats;
+
+	glm::vec4 FitCascade(const glm::mat4& lightView, const glm::mat4& inverseView,
+		GLfloat tanHalfX, GLfloat tanHalfY, GLfloat nearSplit, GLfloat farSplit) const;
+	static glm::mat4 CascadeProjection(glm::vec4 box);
+	bool RenderCascade(int index, DrawBatch& batch, RingBuffer& ring,
+		const glm::mat4& lightView, glm::vec3 lightDirection, glm::vec4 box);
+};
@@ -0,0 +1,98 @@
+#include "ChromeTrace.h"
+
+#include <chrono>
+
+ChromeTrace::ChromeTrace() {
+	file = nullptr;
+	path = nullptr;
+	separator = "\n";
+	zoneCount = 0;
+}
+
+double ChromeTrace::NowUs() {
+	// A function-local static, so profilers may take timestamps while other
+	// statics are still being initialised.
+	static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+bool ChromeTrace::Open(const char* tracePath) {
+	Close();
+	file = fopen(tracePath, "w");
+	if (!file) {
+		printf("Failed to open %s for the profiler trace\n", tracePath);
+		return false;
+	}
+	path = tracePath;
+	separator = "\n";
+	zoneCount = 0;
+	fprintf(file, "{\"traceEvents\":[");
+	return true;
+}
+
+void ChromeTrace::WriteString(const char* text) {
+	fputc('"', file);
+	for (; *text; text++) {
+		if (*text == '"' || *text == '\\') {
+			fputc('\\', file);
+		}
+		fputc(*text, file);
+	}
+	fputc('"', file);
+}
+
+void ChromeTrace::NameProcess(unsigned int pid, const char* name) {
+	if (!file) {
+		return;
+	}
+	fprintf(file, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":", separator, pid);
+	WriteString(name);
+	fprintf(file, "}}");
+	separator = ",\n";
+}
+
+void ChromeTrace::NameThread(unsigned int pid, unsigned int tid, const char* name) {
+	if (!file) {
+		return;
+	}
+	fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":", separator, pid, tid);
+	WriteString(name);
+	fprintf(file, "}}");
+	separator = ",\n";
+}
+
+void ChromeTrace::AddZone(unsigned int pid, unsigned int tid, const char* name, double startUs, double durationUs, unsigned int frame) {
+	if (!file) {
+		return;
+	}
+	fprintf(file, "%s{\"name\":", separator);
+	WriteString(name);
+	fprintf(file, ",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", pid, tid, startUs, durationUs);
+	if (frame != NO_FRAME) {
+		fprintf(file, ",\"args\":{\"frame\":%u}", frame);
+	}
+	fprintf(file, "}");
+	separator = ",\n";
+	zoneCount++;
+}
+
+bool ChromeTrace::Close() {
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "\n]}\n");
+	bool written = ferror(file) == 0;
+	fclose(file);
+	file = nullptr;
+	if (written) {
+		printf("Wrote %u profile zones to %s\n", zoneCount, path);
+	}
+	else {
+		printf("Failed to write the profiler trace to %s\n", path);
+	}
+	return written;
+}
+
+ChromeTrace::~ChromeTrace() {
+	Close();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdio.h>
+
+// Writes a Chrome trace (chrome://tracing, Perfetto) of complete ("X")
+// events. Every profiler places its events on the NowUs() timeline, so CPU
+// zones, frame graph scopes and their GPU execution line up in one file.
+class ChromeTrace {
+public:
+	static const unsigned int NO_FRAME = 0xFFFFFFFFu;
+
+	ChromeTrace();
+
+	bool Open(const char* path);
+
+	// Labels for a process's and a thread's track.
+	void NameProcess(unsigned int pid, const char* name);
+	void NameThread(unsigned int pid, unsigned int tid, const char* name);
+	void AddZone(unsigned int pid, unsigned int tid, const char* name, double startUs, double durationUs, unsigned int frame = NO_FRAME);
+
+	bool Close();
+
+	// Microseconds since the process started, from a monotonic clock.
+	static double NowUs();
+
+	~ChromeTrace();
+
+private:
+	FILE* file;
+	const char* path;
+	const char* separator;
+	unsigned int zoneCount;
+
+	void WriteString(const char* text);
+};
@@ -0,0 +1,104 @@
+#include "CommandRecorder.h"
+#include "CpuProfiler.h"
+
+CommandRecorder::CommandRecorder() {
+	jobSystem = nullptr;
+	batch = nullptr;
+}
+
+bool CommandRecorder::CreateCommandRecorder(JobSystem& jobs) {
+	jobSystem = &jobs;
+	return true;
+}
+
+void CommandRecorder::Record(const DrawBatch& drawBatch, EntityWorld& world,
+	const glm::mat4& viewProjection, FramePacket& packet) {
+	PROFILE_ZONE("CommandRecorder::Record");
+	// Frustum planes straight from the matrix rows (Gribb/Hartmann), normalised
+	// so sphere tests can compare distances against the radius.
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	for (int i = 0; i < 3; i++) {
+		planes[i * 2] = rows[3] + rows[i];
+		planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+	for (int i = 0; i < 6; i++) {
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+
+	batch = &drawBatch;
+
+	size_t chunkCount = world.CountChunks<TransformComponent, MeshComponent, MaterialComponent>();
+	if (slices.size() < chunkCount) {
+		slices.resize(chunkCount);
+	}
+
+	auto recordChunk = [this](size_t slice, unsigned int count, const Entity*,
+		TransformComponent* transforms, MeshComponent* meshes, MaterialComponent* materials) {
+		RecordChunk(slice, count, transforms, meshes, materials);
+	};
+	if (jobSystem) {
+		world.ParallelForEachChunk<TransformComponent, MeshComponent, MaterialComponent>(*jobSystem, recordChunk);
+	}
+	else {
+		// Without a job system everything is recorded on this thread.
+		size_t slice = 0;
+		world.ForEachChunk<TransformComponent, MeshComponent, MaterialComponent>([&](unsigned int count, const Entity* entities,
+			TransformComponent* transforms, MeshComponent* meshes, MaterialComponent* materials) {
+			recordChunk(slice++, count, entities, transforms, meshes, materials);
+		});
+	}
+
+	packet.draws.clear();
+	packet.drawsCulled = 0;
+	for (size_t i = 0; i < chunkCount; i++) {
+		packet.draws.insert(packet.draws.end(), slices[i].draws.begin(), slices[i].draws.end());
+		packet.drawsCulled += slices[i].culled;
+	}
+}
+
+void CommandRecorder::RecordChunk(size_t slice, unsigned int count, const TransformComponent* transforms,
+	const MeshComponent* meshes, const MaterialComponent* materials) {
+	PROFILE_ZONE("frustum cull chunk");
+	Slice& out = slices[slice];
+	out.draws.resize(count);
+	out.culled = 0;
+
+	for (unsigned int i = 0; i < count; i++) {
+		const glm::mat4& model = transforms[i].world;
+		glm::vec4 local = batch->GetMeshBounds(meshes[i].mesh);
+
+		GLfloat scale = glm::max(glm::length(glm::vec3(model[0])),
+			glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		glm::vec4 sphere(glm::vec3(model * glm::vec4(glm::vec3(local), 1.0f)), local.w * scale);
+
+		DrawPacket& draw = out.draws[i];
+		draw.model = model;
+		draw.mesh = meshes[i].mesh;
+		draw.material = materials[i].material;
+		draw.visible = InFrustum(sphere);
+		if (!draw.visible) {
+			out.culled++;
+		}
+	}
+}
+
+bool CommandRecorder::InFrustum(const glm::vec4& sphere) const {
+	for (int i = 0; i < 6; i++) {
+		if (glm::dot(glm::vec3(planes[i]), glm::vec3(sphere)) + planes[i].w < -sphere.w) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void CommandRecorder::ClearCommandRecorder() {
+	jobSystem = nullptr;
+	slices.clear();
+}
+
+CommandRecorder::~CommandRecorder() {
+	ClearCommandRecorder();
+}
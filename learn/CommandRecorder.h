@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DrawBatch.h"
+#include "FramePacket.h"
+#include "JobSystem.h"
+#include "EntityWorld.h"
+#include "Components.h"
+
+// Turns every entity with a transform, mesh and material into a frame's draw
+// packets. Each entity chunk is recorded as its own job: it is frustum culled
+// into a per-chunk list, and the lists are joined in query order. Nothing here
+// touches GL, so it runs on the simulation side of the pipeline.
+class CommandRecorder {
+public:
+	CommandRecorder();
+
+	bool CreateCommandRecorder(JobSystem& jobs);
+
+	void Record(const DrawBatch& batch, EntityWorld& world,
+		const glm::mat4& viewProjection, FramePacket& packet);
+
+	void ClearCommandRecorder();
+
+	~CommandRecorder();
+
+private:
+	struct Slice {
+		std::vector<DrawPacket> draws;
+		unsigned int culled;
+	};
+
+	JobSystem* jobSystem;
+	std::vector<Slice> slices;
+
+	// The frame being recorded; read-only while the jobs run.
+	const DrawBatch* batch;
+	glm::vec4 planes[6];
+
+	void RecordChunk(size_t slice, unsigned int count, const TransformComponent* transforms,
+		const MeshComponent* meshes, const MaterialComponent* materials);
+	bool InFrustum(const glm::vec4& sphere) const;
+};
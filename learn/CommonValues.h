@@ -1,3 +1,41 @@
 #pragma once
 const int MAX_POINT_LIGHTS = 3;
-const int MAX_SPOT_LIGHTS = 3;
\ No newline at end of file
+const int MAX_SPOT_LIGHTS = 3;
+
+// Texture arrays are bound to units [0, MAX_TEXTURE_ARRAYS).
+const int MAX_TEXTURE_ARRAYS = 4;
+
+// G-buffer textures are bound right after the texture arrays, followed by
+// the scene depth read by tiled light culling.
+const int GBUFFER_TEXTURE_UNIT = MAX_TEXTURE_ARRAYS;
+const int TILE_DEPTH_TEXTURE_UNIT = GBUFFER_TEXTURE_UNIT + 4;
+const int CASCADE_SHADOW_TEXTURE_UNIT = TILE_DEPTH_TEXTURE_UNIT + 1;
+const int SHADOW_ATLAS_TEXTURE_UNIT = CASCADE_SHADOW_TEXTURE_UNIT + 1;
+const int VIRTUAL_PAGE_TABLE_TEXTURE_UNIT = SHADOW_ATLAS_TEXTURE_UNIT + 1;
+const int VIRTUAL_PAGE_CACHE_TEXTURE_UNIT = VIRTUAL_PAGE_TABLE_TEXTURE_UNIT + 1;
+
+// A texture handle with this array samples the virtual texture instead.
+const int VIRTUAL_TEXTURE_ARRAY = MAX_TEXTURE_ARRAYS;
+
+// Cascaded shadow maps for the directional light.
+const int MAX_SHADOW_CASCADES = 4;
+
+// Point and spot light shadows share one atlas. Point light i uses shadow slot
+// i, spot light i uses slot MAX_POINT_LIGHTS + i.
+const int MAX_SHADOWED_LIGHTS = MAX_POINT_LIGHTS + MAX_SPOT_LIGHTS;
+
+// Tiled light culling: screen tiles of TILE_SIZE^2 pixels, each keeping up to
+// MAX_LIGHTS_PER_TILE of the (at most MAX_LIGHTS) lights in the light buffer.
+const int TILE_SIZE = 16;
+const int MAX_LIGHTS_PER_TILE = 64;
+const int MAX_LIGHTS = 1024;
+
+// Light ranges leave room for speculars up to this material specularIntensity.
+const float MAX_SPECULAR_INTENSITY = 5.0f;
+
+// Shader storage binding points shared with the GLSL side.
+const int DRAW_DATA_BINDING = 0;
+const int MATERIAL_DATA_BINDING = 1;
+const int LIGHT_DATA_BINDING = 2;
+const int TILE_LIGHT_BINDING = 3;
+const int LIGHT_SHADOW_BINDING = 4;
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "SceneGraph.h"
+#include "PointLight.h"
+#include "SpotLight.h"
+
+// Component types stored in the EntityWorld.
+
+// The world matrix is a copy of the scene graph node's, refreshed whenever
+// the node moves, so the renderer's query reads it straight from the chunk.
+struct TransformComponent {
+	glm::mat4 world;
+	SceneNode node;
+};
+
+struct MeshComponent {
+	unsigned int mesh;
+};
+
+struct MaterialComponent {
+	unsigned int material;
+};
+
+struct PointLightComponent {
+	PointLight light;
+};
+
+struct SpotLightComponent {
+	SpotLight light;
+};
@@ -0,0 +1,94 @@
+#include "CpuProfiler.h"
+
+#include <vector>
+#include <stdio.h>
+
+std::atomic<CpuProfiler::ThreadRing*> CpuProfiler::rings[CpuProfiler::MAX_THREADS];
+std::atomic<unsigned int> CpuProfiler::ringCount(0);
+
+// rdtsc ticks are put on the trace's timeline by comparing against it
+// between start-up and the export.
+static const uint64_t startTicks = CpuProfiler::Now();
+static const double startUs = ChromeTrace::NowUs();
+
+CpuProfiler::ThreadRing* CpuProfiler::GetThreadRing() {
+	static thread_local ThreadRing* ring = nullptr;
+	static thread_local bool registered = false;
+	if (registered) {
+		return ring;
+	}
+	registered = true;
+
+	unsigned int index = ringCount.fetch_add(1);
+	if (index >= MAX_THREADS) {
+		printf("More than %u threads recorded profile zones, dropping this thread's\n", MAX_THREADS);
+		return nullptr;
+	}
+	ring = new ThreadRing();
+	ring->written.store(0, std::memory_order_relaxed);
+	ring->threadName.store(nullptr, std::memory_order_relaxed);
+	rings[index].store(ring, std::memory_order_release);
+	return ring;
+}
+
+void CpuProfiler::Record(const char* name, uint64_t start, uint64_t end) {
+	ThreadRing* ring = GetThreadRing();
+	if (!ring) {
+		return;
+	}
+
+	uint64_t index = ring->written.load(std::memory_order_relaxed);
+	Zone& zone = ring->zones[index % RING_SIZE];
+	zone.name.store(name, std::memory_order_relaxed);
+	zone.start.store(start, std::memory_order_relaxed);
+	zone.end.store(end, std::memory_order_relaxed);
+	ring->written.store(index + 1, std::memory_order_release);
+}
+
+void CpuProfiler::SetThreadName(const char* name) {
+	ThreadRing* ring = GetThreadRing();
+	if (ring) {
+		ring->threadName.store(name, std::memory_order_relaxed);
+	}
+}
+
+void CpuProfiler::AddToTrace(ChromeTrace& trace) {
+	uint64_t elapsedTicks = Now() - startTicks;
+	double usPerTick = elapsedTicks > 0 ? (ChromeTrace::NowUs() - startUs) / elapsedTicks : 0.0;
+
+	trace.NameProcess(TRACE_PID, "CPU");
+	unsigned int threadCount = ringCount.load() < MAX_THREADS ? ringCount.load() : MAX_THREADS;
+	std::vector<Zone> copied(RING_SIZE);
+	for (unsigned int t = 0; t < threadCount; t++) {
+		ThreadRing* ring = rings[t].load(std::memory_order_acquire);
+		if (!ring) {
+			continue;
+		}
+
+		const char* threadName = ring->threadName.load(std::memory_order_relaxed);
+		trace.NameThread(TRACE_PID, t + 1, threadName ? threadName : "thread");
+
+		uint64_t end = ring->written.load(std::memory_order_acquire);
+		uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+		for (uint64_t i = begin; i < end; i++) {
+			const Zone& zone = ring->zones[i % RING_SIZE];
+			Zone& copy = copied[i - begin];
+			copy.name.store(zone.name.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			copy.start.store(zone.start.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			copy.end.store(zone.end.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+
+		// The owner kept recording while we copied: anything it may have
+		// started overwriting since is unreliable.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = ring->written.load(std::memory_order_relaxed);
+		uint64_t firstValid = after + 1 > RING_SIZE ? after + 1 - RING_SIZE : 0;
+		for (uint64_t i = begin > firstValid ? begin : firstValid; i < end; i++) {
+			const Zone& zone = copied[i - begin];
+			uint64_t start = zone.start.load(std::memory_order_relaxed);
+			uint64_t stop = zone.end.load(std::memory_order_relaxed);
+			trace.AddZone(TRACE_PID, t + 1, zone.name.load(std::memory_order_relaxed),
+				startUs + static_cast<int64_t>(start - startTicks) * usPerTick, (stop - start) * usPerTick);
+		}
+	}
+}
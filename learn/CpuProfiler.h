@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+#include "ChromeTrace.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Build with PROFILE_ZONES=0 to compile every PROFILE_ZONE out.
+#ifndef PROFILE_ZONES
+#define PROFILE_ZONES 1
+#endif
+
+// Scoped CPU timing zones. PROFILE_ZONE("name") times the rest of the
+// enclosing block with rdtsc and appends it to the calling thread's ring of
+// the last RING_SIZE zones. Only the owning thread writes a ring, so
+// recording is two rdtscs and a few stores with no locks; AddToTrace()
+// reads every ring from any thread and keeps only zones it knows weren't
+// overwritten while it copied them.
+//
+// Zone names must outlive the profiler (string literals). Rings are created
+// on a thread's first zone and kept for the rest of the process, so zones of
+// threads that have exited still show up in the trace.
+class CpuProfiler {
+public:
+	static const unsigned int RING_SIZE = 8192;
+	static const unsigned int MAX_THREADS = 64;
+	// Each thread is a track of this process in the trace.
+	static const unsigned int TRACE_PID = 1;
+
+	static uint64_t Now() { return __rdtsc(); }
+	static void Record(const char* name, uint64_t start, uint64_t end);
+	// Label for the calling thread's track in the trace.
+	static void SetThreadName(const char* name);
+
+	static void AddToTrace(ChromeTrace& trace);
+
+private:
+	struct Zone {
+		std::atomic<const char*> name;
+		std::atomic<uint64_t> start;
+		std::atomic<uint64_t> end;
+	};
+
+	struct ThreadRing {
+		Zone zones[RING_SIZE];
+		// Zones ever recorded; the newest sits at (written - 1) % RING_SIZE.
+		std::atomic<uint64_t> written;
+		std::atomic<const char*> threadName;
+	};
+
+	static std::atomic<ThreadRing*> rings[MAX_THREADS];
+	static std::atomic<unsigned int> ringCount;
+
+	static ThreadRing* GetThreadRing();
+};
+
+class ProfileZone {
+public:
+	explicit ProfileZone(const char* zoneName) : name(zoneName), start(CpuProfiler::Now()) {}
+	~ProfileZone() { CpuProfiler::Record(name, start, CpuProfiler::Now()); }
+
+private:
+	const char* name;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILE_ZONES
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,215 @@
+#include "DeferredRenderer.h"
+#include <vector>
+#include <float.h>
+#include "GLState.h"
+#include "GpuMemory.h"
+
+static const char* gBufferVertexShader = "vertexShader.glsl";
+static const char* gBufferFragmentShader = "gbufferFragment.glsl";
+static const char* lightVertexShader = "deferredLightVertex.glsl";
+static const char* lightFragmentShader = "deferredLightFragment.glsl";
+
+static const int LIGHT_DIRECTIONAL = 0;
+static const int LIGHT_POINT = 1;
+static const int LIGHT_SPOT = 2;
+
+static const int VOLUME_RINGS = 8;
+static const int VOLUME_SEGMENTS = 16;
+
+DeferredRenderer::DeferredRenderer() {
+	volumeVAO = 0;
+	volumeVBO = 0;
+	volumeEBO = 0;
+	volumeIndexCount = 0;
+
+	uniformLightType = 0;
+	uniformLightIndex = 0;
+	uniformVolume = 0;
+	uniformViewProjection = 0;
+	uniformInverseViewProjection = 0;
+	uniformEyePosition = 0;
+	uniformCascadeMatrices = 0;
+	uniformCascadeCount = 0;
+	uniformAtlasShadows = 0;
+}
+
+GLenum DeferredRenderer::GetGBufferFormat(int attachment) {
+	static const GLenum formats[GBUFFER_ATTACHMENT_COUNT] = { GL_RGBA8, GL_RGBA16F, GL_RG16F, GL_DEPTH_COMPONENT32F };
+	return formats[attachment];
+}
+
+bool DeferredRenderer::CreateDeferredRenderer() {
+	geometryShader.CreateFromFiles(gBufferVertexShader, gBufferFragmentShader);
+	lightShader.CreateFromFiles(lightVertexShader, lightFragmentShader);
+	if (geometryShader.GetShaderID() == 0 || lightShader.GetShaderID() == 0) {
+		return false;
+	}
+
+	uniformLightType = lightShader.GetUniformLocation("lightType");
+	uniformLightIndex = lightShader.GetUniformLocation("lightIndex");
+	uniformVolume = lightShader.GetUniformLocation("volume");
+	uniformViewProjection = lightShader.GetUniformLocation("viewProjection");
+	uniformInverseViewProjection = lightShader.GetUniformLocation("inverseViewProjection");
+	uniformEyePosition = lightShader.GetEyePositionLocation();
+	uniformCascadeMatrices = lightShader.GetUniformLocation("cascadeMatrices");
+	uniformCascadeCount = lightShader.GetUniformLocation("cascadeCount");
+	uniformAtlasShadows = lightShader.GetUniformLocation("atlasShadows");
+
+	CreateVolumeMesh();
+	return true;
+}
+
+void DeferredRenderer::CreateVolumeMesh() {
+	// A UV sphere pushed out far enough that its flat faces enclose the unit sphere.
+	const GLfloat pi = 3.14159265f;
+	const GLfloat radius = 1.0f / (cosf(pi / VOLUME_RINGS) * cosf(pi / VOLUME_SEGMENTS));
+
+	std::vector<GLfloat> vertices;
+	for (int ring = 0; ring <= VOLUME_RINGS; ring++) {
+		GLfloat phi = pi * ring / VOLUME_RINGS;
+		for (int segment = 0; segment <= VOLUME_SEGMENTS; segment++) {
+			GLfloat theta = 2.0f * pi * segment / VOLUME_SEGMENTS;
+			vertices.push_back(radius * sinf(phi) * cosf(theta));
+			vertices.push_back(radius * cosf(phi));
+			vertices.push_back(radius * sinf(phi) * sinf(theta));
+		}
+	}
+
+	std::vector<GLuint> indices;
+	for (int ring = 0; ring < VOLUME_RINGS; ring++) {
+		for (int segment = 0; segment < VOLUME_SEGMENTS; segment++) {
+			GLuint a = ring * (VOLUME_SEGMENTS + 1) + segment;
+			GLuint b = a + VOLUME_SEGMENTS + 1;
+			indices.push_back(a);
+			indices.push_back(a + 1);
+			indices.push_back(b);
+			indices.push_back(b);
+			indices.push_back(a + 1);
+			indices.push_back(b + 1);
+		}
+	}
+	volumeIndexCount = static_cast<GLsizei>(indices.size());
+
+	volumeVBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "light volume vertices",
+		sizeof(GLfloat) * vertices.size(), vertices.data(), 0);
+	volumeEBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "light volume indices",
+		sizeof(GLuint) * indices.size(), indices.data(), 0);
+
+	glCreateVertexArrays(1, &volumeVAO);
+	glVertexArrayVertexBuffer(volumeVAO, 0, volumeVBO, 0, sizeof(GLfloat) * 3);
+	glVertexArrayElementBuffer(volumeVAO, volumeEBO);
+	glVertexArrayAttribFormat(volumeVAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(volumeVAO, 0, 0);
+	glEnableVertexArrayAttrib(volumeVAO, 0);
+}
+
+void DeferredRenderer::DrawVolume(int lightType, int lightIndex, glm::vec3 center, GLfloat radius) {
+	glUniform1i(uniformLightType, lightType);
+	glUniform1i(uniformLightIndex, lightIndex);
+
+	// A radius of FLT_MAX (PointLight::GetRange() for lights that never fall
+	// off) means "unbounded": like the directional light, it covers the
+	// whole screen.
+	if (radius == FLT_MAX || lightType == LIGHT_DIRECTIONAL) {
+		glUniform4f(uniformVolume, center.x, center.y, center.z, 0.0f);
+		GLState::Disable(GL_CULL_FACE);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		return;
+	}
+
+	glUniform4f(uniformVolume, center.x, center.y, center.z, radius);
+	// Back faces only: still correct with the camera inside the volume.
+	GLState::Enable(GL_CULL_FACE);
+	glDrawElements(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_INT, 0);
+}
+
+void DeferredRenderer::RenderGeometry(DrawBatch& batch) {
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Disable(GL_BLEND);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	geometryShader.UseShader();
+	batch.Render();
+}
+
+void DeferredRenderer::RenderLighting(const glm::mat4& viewProjection, glm::vec3 eyePosition,
+	DirectionalLight* dLight,
+	PointLight* pLights, unsigned int pointLightCount,
+	SpotLight* sLights, unsigned int spotLightCount,
+	CascadedShadowMap* shadows, ShadowAtlas* lightShadows) {
+	// Additive light volumes.
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	GLState::Disable(GL_DEPTH_TEST);
+	GLState::Enable(GL_DEPTH_CLAMP);
+	GLState::Enable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glCullFace(GL_FRONT);
+
+	lightShader.UseShader();
+
+	lightShader.SetDirectionalLight(dLight);
+	lightShader.SetPointLights(pLights, pointLightCount);
+	lightShader.SetSpotLights(sLights, spotLightCount);
+
+	glUniformMatrix4fv(uniformViewProjection, 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniformMatrix4fv(uniformInverseViewProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(viewProjection)));
+	glUniform3f(uniformEyePosition, eyePosition.x, eyePosition.y, eyePosition.z);
+
+	if (shadows) {
+		shadows->UseShadowMap(uniformCascadeMatrices, uniformCascadeCount);
+	}
+	else {
+		glUniform1i(uniformCascadeCount, 0);
+	}
+	if (lightShadows) {
+		lightShadows->UseShadowAtlas(uniformAtlasShadows);
+	}
+	else {
+		glUniform1i(uniformAtlasShadows, 0);
+	}
+
+	GLState::BindVertexArray(volumeVAO);
+
+	DrawVolume(LIGHT_DIRECTIONAL, 0, glm::vec3(0.0f), 0.0f);
+
+	if (pointLightCount > MAX_POINT_LIGHTS) pointLightCount = MAX_POINT_LIGHTS;
+	for (unsigned int i = 0; i < pointLightCount; i++) {
+		GLfloat range = pLights[i].GetRange();
+		if (range > 0.0f) {
+			DrawVolume(LIGHT_POINT, i, pLights[i].GetPosition(), range);
+		}
+	}
+
+	if (spotLightCount > MAX_SPOT_LIGHTS) spotLightCount = MAX_SPOT_LIGHTS;
+	for (unsigned int i = 0; i < spotLightCount; i++) {
+		GLfloat range = sLights[i].GetRange();
+		if (range > 0.0f) {
+			DrawVolume(LIGHT_SPOT, i, sLights[i].GetPosition(), range);
+		}
+	}
+
+	glCullFace(GL_BACK);
+	GLState::Disable(GL_CULL_FACE);
+	GLState::Disable(GL_BLEND);
+	GLState::Disable(GL_DEPTH_CLAMP);
+	GLState::Enable(GL_DEPTH_TEST);
+}
+
+void DeferredRenderer::ClearDeferredRenderer() {
+	GpuMemory::DeleteBuffer(volumeEBO);
+	GpuMemory::DeleteBuffer(volumeVBO);
+	if (volumeVAO != 0) {
+		GLState::ForgetVertexArray(volumeVAO);
+		glDeleteVertexArrays(1, &volumeVAO);
+		volumeVAO = 0;
+	}
+	volumeIndexCount = 0;
+
+	geometryShader.ClearShader();
+	lightShader.ClearShader();
+}
+
+DeferredRenderer::~DeferredRenderer() {
+	ClearDeferredRenderer();
+}
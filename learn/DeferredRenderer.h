@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "CascadedShadowMap.h"
+#include "ShadowAtlas.h"
+#include "DrawBatch.h"
+#include "Shader.h"
+
+// Deferred shading path. The scene is rasterised once into the G-buffer, then
+// every light is drawn as a screen-space volume (a full-screen triangle for the
+// directional light, a sphere for point and spot lights) that only shades the
+// pixels it covers, so lighting cost follows screen coverage, not overdraw.
+//
+// The G-buffer itself is transient and comes from the frame graph: albedo,
+// world-space normal, material parameters (specular intensity, shininess)
+// and depth.
+class DeferredRenderer {
+public:
+	enum GBufferAttachment {
+		GBUFFER_ALBEDO,
+		GBUFFER_NORMAL,
+		GBUFFER_MATERIAL,
+		GBUFFER_DEPTH,
+		GBUFFER_ATTACHMENT_COUNT
+	};
+	static GLenum GetGBufferFormat(int attachment);
+
+	DeferredRenderer();
+
+	bool CreateDeferredRenderer();
+
+	// Draws into the bound G-buffer.
+	void RenderGeometry(DrawBatch& batch);
+	// Draws into the bound target, with the G-buffer attachments bound to
+	// GBUFFER_TEXTURE_UNIT onwards in attachment order.
+	void RenderLighting(const glm::mat4& viewProjection, glm::vec3 eyePosition,
+		DirectionalLight* dLight,
+		PointLight* pLights, unsigned int pointLightCount,
+		SpotLight* sLights, unsigned int spotLightCount,
+		CascadedShadowMap* shadows, ShadowAtlas* lightShadows);
+
+	void ClearDeferredRenderer();
+
+	~DeferredRenderer();
+
+private:
+	Shader geometryShader;
+	Shader lightShader;
+
+	GLuint volumeVAO, volumeVBO, volumeEBO;
+	GLsizei volumeIndexCount;
+
+	GLuint uniformLightType, uniformLightIndex, uniformVolume,
+		uniformViewProjection, uniformInverseViewProjection, uniformEyePosition,
+		uniformCascadeMatrices, uniformCascadeCount, uniformAtlasShadows;
+
+	void CreateVolumeMesh();
+	void DrawVolume(int lightType, int lightIndex, glm::vec3 center, GLfloat radius);
+};
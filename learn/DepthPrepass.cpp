@@ -0,0 +1,119 @@
+#include "DepthPrepass.h"
+#include "GLState.h"
+
+static const char* depthVertexShader = "depthVertex.glsl";
+static const char* depthFragmentShader = "depthFragment.glsl";
+static const char* overdrawFragmentShader = "overdrawFragment.glsl";
+
+DepthPrepass::DepthPrepass() {
+	enabled = false;
+	required = false;
+	frame = 0;
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		depthQueries[i] = 0;
+		shadingQueries[i] = 0;
+		depthPending[i] = false;
+		shadingPending[i] = false;
+	}
+	last.depthFragments = 0;
+	last.shadedFragments = 0;
+}
+
+bool DepthPrepass::CreateDepthPrepass() {
+	depthShader.CreateFromFiles(depthVertexShader, depthFragmentShader);
+	overdrawShader.CreateFromFiles(depthVertexShader, overdrawFragmentShader);
+	glCreateQueries(GL_SAMPLES_PASSED, QUERY_FRAMES, depthQueries);
+	glCreateQueries(GL_SAMPLES_PASSED, QUERY_FRAMES, shadingQueries);
+	return true;
+}
+
+bool DepthPrepass::ReadQuery(GLuint query, bool& pending, GLuint64& result) {
+	if (!pending) {
+		return false;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+	pending = false;
+	return true;
+}
+
+void DepthPrepass::RenderDepth(DrawBatch& batch) {
+	frame = (frame + 1) % QUERY_FRAMES;
+
+	// The oldest queries are reused this frame; collect them first.
+	ReadQuery(depthQueries[frame], depthPending[frame], last.depthFragments);
+	ReadQuery(shadingQueries[frame], shadingPending[frame], last.shadedFragments);
+
+	if (!IsActive()) {
+		last.depthFragments = 0;
+		return;
+	}
+
+	GLState::Enable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	depthShader.UseShader();
+	glBeginQuery(GL_SAMPLES_PASSED, depthQueries[frame]);
+	batch.RenderPositions();
+	glEndQuery(GL_SAMPLES_PASSED);
+	depthPending[frame] = true;
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void DepthPrepass::BeginShading() {
+	if (IsActive()) {
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	glBeginQuery(GL_SAMPLES_PASSED, shadingQueries[frame]);
+}
+
+void DepthPrepass::EndShading() {
+	glEndQuery(GL_SAMPLES_PASSED);
+	shadingPending[frame] = true;
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+void DepthPrepass::RenderOverdraw(DrawBatch& batch) {
+	GLState::Disable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	GLState::Enable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	overdrawShader.UseShader();
+	batch.RenderPositions();
+
+	GLState::Disable(GL_BLEND);
+	GLState::Enable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+}
+
+void DepthPrepass::ClearDepthPrepass() {
+	if (depthQueries[0] != 0) {
+		glDeleteQueries(QUERY_FRAMES, depthQueries);
+		glDeleteQueries(QUERY_FRAMES, shadingQueries);
+	}
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		depthQueries[i] = 0;
+		shadingQueries[i] = 0;
+		depthPending[i] = false;
+		shadingPending[i] = false;
+	}
+	depthShader.ClearShader();
+	overdrawShader.ClearShader();
+}
+
+DepthPrepass::~DepthPrepass() {
+	ClearDepthPrepass();
+}
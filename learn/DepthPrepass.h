@@ -0,0 +1,64 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "DrawBatch.h"
+#include "Shader.h"
+
+// Optional depth-only pass ahead of forward shading. With it enabled the
+// shading pass runs with GL_EQUAL and no depth writes, so the multi-light
+// fragment shader only runs once per visible pixel.
+//
+// Both passes are wrapped in GL_SAMPLES_PASSED queries (read back a few frames
+// late so they never stall) to show how much shading overdraw it removes.
+//
+// RenderOverdraw() shows the same overdraw as a picture: every fragment of the
+// batch, hidden or not, adds a fixed colour, so brighter pixels were
+// rasterised more times.
+class DepthPrepass {
+public:
+	struct OverdrawStats {
+		GLuint64 depthFragments;
+		GLuint64 shadedFragments;
+	};
+
+	DepthPrepass();
+
+	bool CreateDepthPrepass();
+
+	void SetEnabled(bool enable) { enabled = enable; }
+	bool IsEnabled() const { return enabled; }
+	// Passes that read the scene depth before shading (tiled light culling)
+	// force the pre-pass on regardless of the user setting.
+	void SetRequired(bool require) { required = require; }
+	bool IsActive() const { return enabled || required; }
+
+	void RenderDepth(DrawBatch& batch);
+	void BeginShading();
+	void EndShading();
+	// Draws into the bound framebuffer, which should be cleared to black.
+	void RenderOverdraw(DrawBatch& batch);
+
+	OverdrawStats GetLastStats() const { return last; }
+
+	void ClearDepthPrepass();
+
+	~DepthPrepass();
+
+private:
+	static const int QUERY_FRAMES = 3;
+
+	Shader depthShader;
+	Shader overdrawShader;
+	bool enabled;
+	bool required;
+
+	GLuint depthQueries[QUERY_FRAMES];
+	GLuint shadingQueries[QUERY_FRAMES];
+	bool depthPending[QUERY_FRAMES];
+	bool shadingPending[QUERY_FRAMES];
+	int frame;
+
+	OverdrawStats last;
+
+	static bool ReadQuery(GLuint query, bool& pending, GLuint64& result);
+};
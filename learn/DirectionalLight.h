@@ -15,6 +15,8 @@ public:
 		GLuint diffuseIntensityLocation, GLuint directionLocation);
 
 
+	glm::vec3 GetDirection() const { return direction; }
+
 	~DirectionalLight();
 
 private:
@@ -0,0 +1,281 @@
+#include "DrawBatch.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "CpuProfiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+static const unsigned int FLOATS_PER_VERTEX = 8;
+
+DrawBatch::DrawBatch() {
+	VAO = 0;
+	VBO = 0;
+	EBO = 0;
+	positionVAO = 0;
+	positionVBO = 0;
+	geometryDirty = false;
+	jobSystem = nullptr;
+	ringBuffer = 0;
+	commandOffset = 0;
+	drawOffset = 0;
+	uploadedCount = 0;
+}
+
+unsigned int DrawBatch::AddMesh(GLfloat* meshVertices, unsigned int* meshIndices, unsigned int numOfVertices, unsigned int numOfIndices) {
+	MeshRange range;
+	range.firstIndex = static_cast<GLuint>(indices.size());
+	range.indexCount = numOfIndices;
+	range.baseVertex = static_cast<GLint>(vertices.size() / FLOATS_PER_VERTEX);
+
+	// Sphere around the centre of the mesh's bounding box.
+	glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+	for (unsigned int i = 0; i + 2 < numOfVertices; i += FLOATS_PER_VERTEX) {
+		glm::vec3 position(meshVertices[i], meshVertices[i + 1], meshVertices[i + 2]);
+		boxMin = glm::min(boxMin, position);
+		boxMax = glm::max(boxMax, position);
+	}
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	GLfloat radius = 0.0f;
+	for (unsigned int i = 0; i + 2 < numOfVertices; i += FLOATS_PER_VERTEX) {
+		glm::vec3 position(meshVertices[i], meshVertices[i + 1], meshVertices[i + 2]);
+		radius = glm::max(radius, glm::length(position - center));
+	}
+	range.bounds = glm::vec4(center, radius);
+
+	// sqrt of the UV to object-space area ratio is the UV change per unit.
+	range.uvDensity = 0.0f;
+	for (unsigned int i = 0; i + 2 < numOfIndices; i += 3) {
+		const GLfloat* corners[3];
+		for (int c = 0; c < 3; c++) {
+			corners[c] = meshVertices + meshIndices[i + c] * FLOATS_PER_VERTEX;
+		}
+		glm::vec3 edgeA = glm::vec3(corners[1][0], corners[1][1], corners[1][2]) - glm::vec3(corners[0][0], corners[0][1], corners[0][2]);
+		glm::vec3 edgeB = glm::vec3(corners[2][0], corners[2][1], corners[2][2]) - glm::vec3(corners[0][0], corners[0][1], corners[0][2]);
+		glm::vec2 uvA = glm::vec2(corners[1][3], corners[1][4]) - glm::vec2(corners[0][3], corners[0][4]);
+		glm::vec2 uvB = glm::vec2(corners[2][3], corners[2][4]) - glm::vec2(corners[0][3], corners[0][4]);
+		GLfloat area = glm::length(glm::cross(edgeA, edgeB));
+		GLfloat uvArea = fabsf(uvA.x * uvB.y - uvA.y * uvB.x);
+		if (area > 1e-8f) {
+			range.uvDensity = glm::max(range.uvDensity, sqrtf(uvArea / area));
+		}
+	}
+	meshes.push_back(range);
+
+	vertices.insert(vertices.end(), meshVertices, meshVertices + numOfVertices);
+	indices.insert(indices.end(), meshIndices, meshIndices + numOfIndices);
+	geometryDirty = true;
+
+	return static_cast<unsigned int>(meshes.size() - 1);
+}
+
+void DrawBatch::UploadGeometry() {
+	ClearGeometry();
+
+	EBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "batch indices", sizeof(GLuint) * indices.size(), indices.data(), 0);
+	VBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "batch vertices", sizeof(GLfloat) * vertices.size(), vertices.data(), 0);
+
+	glCreateVertexArrays(1, &VAO);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(GLfloat) * FLOATS_PER_VERTEX);
+	glVertexArrayElementBuffer(VAO, EBO);
+
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribFormat(VAO, 1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3);
+	glVertexArrayAttribFormat(VAO, 2, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5);
+	for (GLuint attrib = 0; attrib < 3; attrib++) {
+		glVertexArrayAttribBinding(VAO, attrib, 0);
+		glEnableVertexArrayAttrib(VAO, attrib);
+	}
+
+	// Depth-only passes fetch 12 bytes per vertex instead of 32.
+	std::vector<GLfloat> positions;
+	positions.reserve(vertices.size() / FLOATS_PER_VERTEX * 3);
+	for (size_t i = 0; i < vertices.size(); i += FLOATS_PER_VERTEX) {
+		positions.push_back(vertices[i]);
+		positions.push_back(vertices[i + 1]);
+		positions.push_back(vertices[i + 2]);
+	}
+
+	positionVBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "batch positions",
+		sizeof(GLfloat) * positions.size(), positions.data(), 0);
+
+	glCreateVertexArrays(1, &positionVAO);
+	glVertexArrayVertexBuffer(positionVAO, 0, positionVBO, 0, sizeof(GLfloat) * 3);
+	glVertexArrayElementBuffer(positionVAO, EBO);
+	glVertexArrayAttribFormat(positionVAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(positionVAO, 0, 0);
+	glEnableVertexArrayAttrib(positionVAO, 0);
+
+	geometryDirty = false;
+}
+
+void DrawBatch::Begin() {
+	commands.clear();
+	models.clear();
+	drawMeshes.clear();
+	drawVisible.clear();
+	materials.clear();
+	uploadedCount = 0;
+}
+
+void DrawBatch::Submit(unsigned int mesh, const glm::mat4& model, unsigned int material, bool visible) {
+	const MeshRange& range = meshes[mesh];
+
+	DrawElementsIndirectCommand command;
+	command.count = range.indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = range.firstIndex;
+	command.baseVertex = range.baseVertex;
+	command.baseInstance = 0;
+	commands.push_back(command);
+
+	models.push_back(model);
+	drawMeshes.push_back(mesh);
+	drawVisible.push_back(visible);
+	materials.push_back(material);
+}
+
+bool DrawBatch::Upload(RingBuffer& ring, const glm::mat4& viewProjection) {
+	PROFILE_ZONE("DrawBatch::Upload");
+	uploadedCount = 0;
+	if (commands.empty()) {
+		return true;
+	}
+
+	GLsizeiptr commandBytes = sizeof(DrawElementsIndirectCommand) * commands.size();
+	GLsizeiptr drawBytes = sizeof(DrawData) * commands.size();
+
+	void* commandTarget = ring.Allocate(commandBytes, sizeof(GLuint), &commandOffset);
+	void* drawTarget = ring.Allocate(drawBytes, ring.GetStorageAlignment(), &drawOffset);
+	if (!commandTarget || !drawTarget) {
+		printf("Draw batch of %u draws doesn't fit the frame ring, skipping it this frame\n", GetDrawCount());
+		return false;
+	}
+
+	DrawElementsIndirectCommand* commandData = static_cast<DrawElementsIndirectCommand*>(commandTarget);
+	for (size_t i = 0; i < commands.size(); i++) {
+		commandData[i] = commands[i];
+		if (!drawVisible[i]) {
+			commandData[i].instanceCount = 0;
+		}
+	}
+
+	// MVP and normal matrices are computed here once per object, straight
+	// into the ring, instead of once per vertex in the shader.
+	DrawData* drawData = static_cast<DrawData*>(drawTarget);
+	auto writeDrawData = [&](size_t begin, size_t end) {
+		ComputeDrawTransforms(viewProjection, models.data() + begin, end - begin, &drawData[begin].transform, sizeof(DrawData));
+		for (size_t i = begin; i < end; i++) {
+			drawData[i].materialIndex = materials[i];
+		}
+	};
+	if (jobSystem) {
+		jobSystem->ParallelFor(models.size(), TRANSFORMS_PER_JOB, writeDrawData);
+	}
+	else {
+		writeDrawData(0, models.size());
+	}
+
+	ringBuffer = ring.GetBufferID();
+	uploadedCount = static_cast<GLsizei>(commands.size());
+	return true;
+}
+
+void DrawBatch::Render() {
+	Draw(VAO, commandOffset);
+}
+
+void DrawBatch::RenderPositions() {
+	Draw(positionVAO, commandOffset);
+}
+
+void DrawBatch::GetDrawBounds(std::vector<glm::vec4>& bounds) const {
+	bounds.resize(models.size());
+	for (size_t i = 0; i < models.size(); i++) {
+		const glm::mat4& model = models[i];
+		glm::vec4 local = meshes[drawMeshes[i]].bounds;
+
+		GLfloat scale = glm::max(glm::length(glm::vec3(model[0])),
+			glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		bounds[i] = glm::vec4(glm::vec3(model * glm::vec4(glm::vec3(local), 1.0f)), local.w * scale);
+	}
+}
+
+bool DrawBatch::UploadCommandSubset(RingBuffer& ring, const std::vector<bool>& visible, GLintptr* subsetOffset) {
+	if (uploadedCount == 0) {
+		return false;
+	}
+
+	DrawElementsIndirectCommand* target = static_cast<DrawElementsIndirectCommand*>(
+		ring.Allocate(sizeof(DrawElementsIndirectCommand) * uploadedCount, sizeof(GLuint), subsetOffset));
+	if (!target) {
+		return false;
+	}
+
+	for (GLsizei i = 0; i < uploadedCount; i++) {
+		target[i] = commands[i];
+		if (!visible[i]) {
+			target[i].instanceCount = 0;
+		}
+	}
+	return true;
+}
+
+void DrawBatch::RenderPositions(GLintptr subsetOffset) {
+	Draw(positionVAO, subsetOffset);
+}
+
+void DrawBatch::Draw(GLuint vertexArray, GLintptr commands) {
+	if (uploadedCount == 0) {
+		return;
+	}
+	if (geometryDirty) {
+		UploadGeometry();
+	}
+
+	GLState::BindVertexArray(vertexArray);
+	GLState::BindBuffer(GL_DRAW_INDIRECT_BUFFER, ringBuffer);
+	GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, ringBuffer,
+		drawOffset, sizeof(DrawData) * uploadedCount);
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(commands), uploadedCount, 0);
+}
+
+void DrawBatch::ClearGeometry() {
+	GpuMemory::DeleteBuffer(EBO);
+	GpuMemory::DeleteBuffer(VBO);
+	if (VAO != 0) {
+		GLState::ForgetVertexArray(VAO);
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+	GpuMemory::DeleteBuffer(positionVBO);
+	if (positionVAO != 0) {
+		GLState::ForgetVertexArray(positionVAO);
+		glDeleteVertexArrays(1, &positionVAO);
+		positionVAO = 0;
+	}
+}
+
+void DrawBatch::ClearBatch() {
+	ClearGeometry();
+
+	ringBuffer = 0;
+	uploadedCount = 0;
+
+	vertices.clear();
+	indices.clear();
+	meshes.clear();
+	commands.clear();
+	models.clear();
+	drawMeshes.clear();
+	drawVisible.clear();
+	materials.clear();
+	geometryDirty = false;
+}
+
+DrawBatch::~DrawBatch() {
+	ClearBatch();
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "RingBuffer.h"
+#include "TransformMath.h"
+#include "JobSystem.h"
+
+// Owns one shared vertex/index buffer for a set of meshes and turns a frame's
+// worth of submitted draws into a single glMultiDrawElementsIndirect call.
+// Commands and per-draw data are written into the frame's ring buffer; the
+// per-draw data is read in the shaders through gl_DrawID.
+class DrawBatch {
+public:
+	DrawBatch();
+
+	unsigned int AddMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
+	// Spreads Upload()'s per-draw transforms over the job system's threads.
+	void SetJobSystem(JobSystem* jobs) { jobSystem = jobs; }
+
+	void Begin();
+	// Draws that aren't visible to the camera are only drawn by passes that
+	// render their own subset (shadow casters).
+	void Submit(unsigned int mesh, const glm::mat4& model, unsigned int material, bool visible = true);
+	bool Upload(RingBuffer& ring, const glm::mat4& viewProjection);
+	void Render();
+	// Same draws, fed from a tightly packed positions-only stream.
+	void RenderPositions();
+
+	// World-space bounding sphere (xyz centre, w radius) of every submitted draw.
+	void GetDrawBounds(std::vector<glm::vec4>& bounds) const;
+	// Copies this frame's commands into the ring with the draws whose entry in
+	// `visible` is false skipped, for passes that cull the batch themselves.
+	// Draw indices are unchanged, so the uploaded draw data still applies.
+	bool UploadCommandSubset(RingBuffer& ring, const std::vector<bool>& visible, GLintptr* subsetOffset);
+	void RenderPositions(GLintptr subsetOffset);
+
+	unsigned int GetDrawCount() const { return static_cast<unsigned int>(commands.size()); }
+	// Object-space bounding sphere; meshes are immutable once added, so this
+	// may be read from any thread.
+	glm::vec4 GetMeshBounds(unsigned int mesh) const { return meshes[mesh].bounds; }
+	// Largest texture-coordinate distance per object-space unit over the
+	// mesh's triangles, for working out which mip levels a draw samples.
+	GLfloat GetMeshUvDensity(unsigned int mesh) const { return meshes[mesh].uvDensity; }
+
+	void ClearBatch();
+
+	~DrawBatch();
+
+private:
+	struct MeshRange {
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+		glm::vec4 bounds;
+		GLfloat uvDensity;
+	};
+
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Mirrors DrawData in the shaders (std430).
+	struct DrawData {
+		DrawTransform transform;
+		GLuint materialIndex;
+		GLuint pad[3];
+	};
+	static_assert(sizeof(DrawData) == 192, "DrawData must match the std430 layout");
+
+	// Draws per transform job; fewer isn't worth handing to another thread.
+	static const size_t TRANSFORMS_PER_JOB = 256;
+
+	GLuint VAO, VBO, EBO;
+	GLuint positionVAO, positionVBO;
+	bool geometryDirty;
+	JobSystem* jobSystem;
+
+	// Where this frame's commands and draw data landed in the ring.
+	GLuint ringBuffer;
+	GLintptr commandOffset, drawOffset;
+	GLsizei uploadedCount;
+
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	std::vector<MeshRange> meshes;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<glm::mat4> models;
+	std::vector<unsigned int> drawMeshes;
+	std::vector<bool> drawVisible;
+	std::vector<GLuint> materials;
+
+	void UploadGeometry();
+	void ClearGeometry();
+	void Draw(GLuint vertexArray, GLintptr commands);
+};
@@ -0,0 +1,210 @@
+#include "EntityWorld.h"
+
+#include <atomic>
+#include <stdio.h>
+
+EntityWorld::ComponentInfo EntityWorld::componentInfos[EntityWorld::MAX_COMPONENT_TYPES];
+
+static std::atomic<unsigned int> componentTypeCount(0);
+
+static size_t AlignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+unsigned int EntityWorld::RegisterComponent(size_t size, size_t alignment, MoveFunction move, DestroyFunction destroy) {
+	unsigned int id = componentTypeCount.fetch_add(1);
+	if (id >= MAX_COMPONENT_TYPES) {
+		printf("More than %u component types registered, the entity world can't tell them apart\n", MAX_COMPONENT_TYPES);
+		id = MAX_COMPONENT_TYPES - 1;
+	}
+	componentInfos[id].size = size;
+	componentInfos[id].alignment = alignment;
+	componentInfos[id].move = move;
+	componentInfos[id].destroy = destroy;
+	return id;
+}
+
+EntityWorld::EntityWorld() {
+	entityCount = 0;
+}
+
+unsigned int EntityWorld::FindArchetype(ComponentMask mask) {
+	for (size_t i = 0; i < archetypes.size(); i++) {
+		if (archetypes[i]->mask == mask) {
+			return static_cast<unsigned int>(i);
+		}
+	}
+
+	Archetype* archetype = new Archetype();
+	archetype->mask = mask;
+	size_t rowBytes = sizeof(Entity);
+	for (unsigned int id = 0; id < MAX_COMPONENT_TYPES; id++) {
+		archetype->offsets[id] = 0;
+		if (mask & (1u << id)) {
+			archetype->components.push_back(id);
+			rowBytes += componentInfos[id].size;
+		}
+	}
+
+	// Start from the unpadded estimate and back off until the aligned arrays
+	// fit. A row too big for a chunk gets a chunk of its own size.
+	unsigned int capacity = static_cast<unsigned int>(CHUNK_BYTES / rowBytes);
+	capacity = capacity > 0 ? capacity : 1;
+	size_t bytes = 0;
+	while (true) {
+		bytes = sizeof(Entity) * capacity;
+		for (size_t i = 0; i < archetype->components.size(); i++) {
+			unsigned int id = archetype->components[i];
+			bytes = AlignUp(bytes, componentInfos[id].alignment);
+			archetype->offsets[id] = bytes;
+			bytes += componentInfos[id].size * capacity;
+		}
+		if (bytes <= CHUNK_BYTES || capacity == 1) {
+			break;
+		}
+		capacity--;
+	}
+	archetype->capacity = capacity;
+	archetype->chunkBytes = bytes > CHUNK_BYTES ? bytes : static_cast<size_t>(CHUNK_BYTES);
+
+	archetypes.push_back(archetype);
+	return static_cast<unsigned int>(archetypes.size() - 1);
+}
+
+void EntityWorld::AllocateRow(unsigned int archetypeIndex, Entity entity, unsigned int& chunk, unsigned int& row) {
+	Archetype& archetype = *archetypes[archetypeIndex];
+	if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+		Chunk fresh;
+		fresh.allocation = new unsigned char[archetype.chunkBytes + CHUNK_ALIGNMENT];
+		fresh.memory = reinterpret_cast<unsigned char*>(
+			AlignUp(reinterpret_cast<uintptr_t>(fresh.allocation), CHUNK_ALIGNMENT));
+		fresh.count = 0;
+		archetype.chunks.push_back(fresh);
+	}
+
+	chunk = static_cast<unsigned int>(archetype.chunks.size() - 1);
+	row = archetype.chunks.back().count++;
+	EntitiesOf(archetype.chunks.back())[row] = entity;
+}
+
+Entity EntityWorld::CreateEntity() {
+	Entity entity;
+	if (!freeIndices.empty()) {
+		entity.index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else {
+		entity.index = static_cast<unsigned int>(records.size());
+		EntityRecord record = { 0, 0, 0, 0, false };
+		records.push_back(record);
+	}
+
+	EntityRecord& record = records[entity.index];
+	entity.generation = record.generation;
+	record.archetype = FindArchetype(0);
+	record.alive = true;
+	AllocateRow(record.archetype, entity, record.chunk, record.row);
+	entityCount++;
+	return entity;
+}
+
+bool EntityWorld::IsAlive(Entity entity) const {
+	return entity.index < records.size()
+		&& records[entity.index].alive
+		&& records[entity.index].generation == entity.generation;
+}
+
+void EntityWorld::MoveEntity(Entity entity, unsigned int target) {
+	EntityRecord& record = records[entity.index];
+	unsigned int sourceIndex = record.archetype;
+	unsigned int sourceChunk = record.chunk;
+	unsigned int sourceRow = record.row;
+
+	unsigned int chunk, row;
+	AllocateRow(target, entity, chunk, row);
+
+	const Archetype& from = *archetypes[sourceIndex];
+	const Archetype& to = *archetypes[target];
+	for (size_t i = 0; i < from.components.size(); i++) {
+		unsigned int id = from.components[i];
+		void* source = ComponentAt(from, sourceChunk, sourceRow, id);
+		if (to.mask & (1u << id)) {
+			componentInfos[id].move(ComponentAt(to, chunk, row, id), source);
+		}
+		componentInfos[id].destroy(source);
+	}
+
+	record.archetype = target;
+	record.chunk = chunk;
+	record.row = row;
+	RemoveRow(sourceIndex, sourceChunk, sourceRow, false);
+}
+
+void EntityWorld::RemoveRow(unsigned int archetypeIndex, unsigned int chunk, unsigned int row, bool destroyComponents) {
+	Archetype& archetype = *archetypes[archetypeIndex];
+	if (destroyComponents) {
+		for (size_t i = 0; i < archetype.components.size(); i++) {
+			unsigned int id = archetype.components[i];
+			componentInfos[id].destroy(ComponentAt(archetype, chunk, row, id));
+		}
+	}
+
+	// Fill the hole with the archetype's last entity so every chunk but the
+	// last stays full.
+	unsigned int lastChunk = static_cast<unsigned int>(archetype.chunks.size() - 1);
+	unsigned int lastRow = archetype.chunks[lastChunk].count - 1;
+	if (chunk != lastChunk || row != lastRow) {
+		Entity moved = EntitiesOf(archetype.chunks[lastChunk])[lastRow];
+		EntitiesOf(archetype.chunks[chunk])[row] = moved;
+		for (size_t i = 0; i < archetype.components.size(); i++) {
+			unsigned int id = archetype.components[i];
+			void* source = ComponentAt(archetype, lastChunk, lastRow, id);
+			componentInfos[id].move(ComponentAt(archetype, chunk, row, id), source);
+			componentInfos[id].destroy(source);
+		}
+		records[moved.index].chunk = chunk;
+		records[moved.index].row = row;
+	}
+
+	if (--archetype.chunks[lastChunk].count == 0) {
+		delete[] archetype.chunks[lastChunk].allocation;
+		archetype.chunks.pop_back();
+	}
+}
+
+void EntityWorld::DestroyEntity(Entity entity) {
+	if (!IsAlive(entity)) {
+		return;
+	}
+
+	EntityRecord& record = records[entity.index];
+	RemoveRow(record.archetype, record.chunk, record.row, true);
+	record.alive = false;
+	record.generation++;
+	freeIndices.push_back(entity.index);
+	entityCount--;
+}
+
+void EntityWorld::ClearEntityWorld() {
+	for (size_t a = 0; a < archetypes.size(); a++) {
+		Archetype* archetype = archetypes[a];
+		for (unsigned int c = 0; c < archetype->chunks.size(); c++) {
+			for (unsigned int row = 0; row < archetype->chunks[c].count; row++) {
+				for (size_t i = 0; i < archetype->components.size(); i++) {
+					unsigned int id = archetype->components[i];
+					componentInfos[id].destroy(ComponentAt(*archetype, c, row, id));
+				}
+			}
+			delete[] archetype->chunks[c].allocation;
+		}
+		delete archetype;
+	}
+	archetypes.clear();
+	records.clear();
+	freeIndices.clear();
+	entityCount = 0;
+}
+
+EntityWorld::~EntityWorld() {
+	ClearEntityWorld();
+}
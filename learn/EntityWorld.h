@@ -0,0 +1,259 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "JobSystem.h"
+
+struct Entity {
+	unsigned int index;
+	unsigned int generation;
+};
+
+const Entity NO_ENTITY = { 0xFFFFFFFFu, 0 };
+
+// Archetype/chunk entity-component store. Entities with exactly the same set
+// of component types share an archetype, and an archetype keeps its entities
+// in fixed-size chunks with one tightly packed array per component type. A
+// query walks the chunks of every archetype that has the requested types, so
+// iterating many entities streams through memory instead of chasing pointers.
+//
+// Adding or removing a component moves the entity to another archetype, and
+// destroying one fills the hole with the archetype's last entity, so rows
+// (and pointers into chunks) are only stable until the next structural change.
+class EntityWorld {
+public:
+	typedef uint32_t ComponentMask;
+
+	static const size_t CHUNK_BYTES = 16 * 1024;
+	static const size_t CHUNK_ALIGNMENT = 64;
+	static const unsigned int MAX_COMPONENT_TYPES = 32;
+
+	EntityWorld();
+
+	Entity CreateEntity();
+	void DestroyEntity(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	// Adds or overwrites the entity's T; null if the entity is dead.
+	template<typename T>
+	T* AddComponent(Entity entity, const T& value);
+	template<typename T>
+	void RemoveComponent(Entity entity);
+	// Null if the entity is dead or doesn't have a T.
+	template<typename T>
+	T* GetComponent(Entity entity);
+
+	// body(count, entities, Ts* arrays...) for every chunk holding all of Ts.
+	template<typename... Ts, typename Body>
+	void ForEachChunk(const Body& body);
+	// body(entity, Ts&...) for every entity holding all of Ts.
+	template<typename... Ts, typename Body>
+	void ForEach(const Body& body);
+	// Same as ForEachChunk but chunks are spread over the job system, and
+	// body gets the chunk's position in the query (0 .. CountChunks() - 1)
+	// first so it can write per-chunk results without locking.
+	template<typename... Ts, typename Body>
+	void ParallelForEachChunk(JobSystem& jobs, const Body& body);
+	template<typename... Ts>
+	size_t CountChunks();
+
+	unsigned int GetEntityCount() const { return entityCount; }
+	unsigned int GetArchetypeCount() const { return static_cast<unsigned int>(archetypes.size()); }
+
+	void ClearEntityWorld();
+
+	~EntityWorld();
+
+	template<typename T>
+	static unsigned int ComponentID() {
+		static const unsigned int id = RegisterComponent(sizeof(T), alignof(T), &MoveConstruct<T>, &Destroy<T>);
+		return id;
+	}
+	template<typename... Ts>
+	static ComponentMask MaskOf() {
+		ComponentMask bits[] = { 0u, (1u << ComponentID<Ts>())... };
+		ComponentMask mask = 0;
+		for (size_t i = 0; i < sizeof(bits) / sizeof(bits[0]); i++) {
+			mask |= bits[i];
+		}
+		return mask;
+	}
+
+private:
+	typedef void (*MoveFunction)(void* destination, void* source);
+	typedef void (*DestroyFunction)(void* component);
+
+	struct ComponentInfo {
+		size_t size;
+		size_t alignment;
+		MoveFunction move;
+		DestroyFunction destroy;
+	};
+
+	struct Chunk {
+		unsigned char* allocation;
+		unsigned char* memory;
+		unsigned int count;
+	};
+
+	struct Archetype {
+		ComponentMask mask;
+		std::vector<unsigned int> components;
+		// Where each component's array starts in a chunk; the entity array
+		// always sits at the front.
+		size_t offsets[MAX_COMPONENT_TYPES];
+		unsigned int capacity;
+		// CHUNK_BYTES, unless a single entity's components don't fit in that.
+		size_t chunkBytes;
+		std::vector<Chunk> chunks;
+	};
+
+	struct EntityRecord {
+		unsigned int generation;
+		unsigned int archetype;
+		unsigned int chunk;
+		unsigned int row;
+		bool alive;
+	};
+
+	static ComponentInfo componentInfos[MAX_COMPONENT_TYPES];
+	static unsigned int RegisterComponent(size_t size, size_t alignment, MoveFunction move, DestroyFunction destroy);
+
+	template<typename T>
+	static void MoveConstruct(void* destination, void* source) {
+		new (destination) T(std::move(*static_cast<T*>(source)));
+	}
+	template<typename T>
+	static void Destroy(void* component) {
+		static_cast<T*>(component)->~T();
+	}
+
+	std::vector<Archetype*> archetypes;
+	std::vector<EntityRecord> records;
+	std::vector<unsigned int> freeIndices;
+	unsigned int entityCount;
+
+	unsigned int FindArchetype(ComponentMask mask);
+	void AllocateRow(unsigned int archetype, Entity entity, unsigned int& chunk, unsigned int& row);
+	// Moves the entity's row into another archetype, carrying over the
+	// components both share and destroying the rest.
+	void MoveEntity(Entity entity, unsigned int target);
+	void RemoveRow(unsigned int archetype, unsigned int chunk, unsigned int row, bool destroyComponents);
+	static void* ComponentAt(const Archetype& archetype, unsigned int chunk, unsigned int row, unsigned int component) {
+		return archetype.chunks[chunk].memory + archetype.offsets[component] + componentInfos[component].size * row;
+	}
+
+	static Entity* EntitiesOf(const Chunk& chunk) { return reinterpret_cast<Entity*>(chunk.memory); }
+
+	template<typename T>
+	static T* ArrayOf(const Archetype& archetype, Chunk& chunk) {
+		return reinterpret_cast<T*>(chunk.memory + archetype.offsets[ComponentID<T>()]);
+	}
+};
+
+template<typename T>
+T* EntityWorld::AddComponent(Entity entity, const T& value) {
+	if (!IsAlive(entity)) {
+		return nullptr;
+	}
+	unsigned int id = ComponentID<T>();
+	EntityRecord& record = records[entity.index];
+	Archetype* current = archetypes[record.archetype];
+	if (!(current->mask & (1u << id))) {
+		MoveEntity(entity, FindArchetype(current->mask | (1u << id)));
+		T* slot = static_cast<T*>(ComponentAt(*archetypes[record.archetype], record.chunk, record.row, id));
+		return new (slot) T(value);
+	}
+
+	T* slot = static_cast<T*>(ComponentAt(*current, record.chunk, record.row, id));
+	*slot = value;
+	return slot;
+}
+
+template<typename T>
+void EntityWorld::RemoveComponent(Entity entity) {
+	if (!IsAlive(entity)) {
+		return;
+	}
+	unsigned int id = ComponentID<T>();
+	ComponentMask mask = archetypes[records[entity.index].archetype]->mask;
+	if (mask & (1u << id)) {
+		MoveEntity(entity, FindArchetype(mask & ~(1u << id)));
+	}
+}
+
+template<typename T>
+T* EntityWorld::GetComponent(Entity entity) {
+	if (!IsAlive(entity)) {
+		return nullptr;
+	}
+	unsigned int id = ComponentID<T>();
+	const EntityRecord& record = records[entity.index];
+	const Archetype& archetype = *archetypes[record.archetype];
+	if (!(archetype.mask & (1u << id))) {
+		return nullptr;
+	}
+	return static_cast<T*>(ComponentAt(archetype, record.chunk, record.row, id));
+}
+
+template<typename... Ts, typename Body>
+void EntityWorld::ForEachChunk(const Body& body) {
+	ComponentMask query = MaskOf<Ts...>();
+	for (size_t a = 0; a < archetypes.size(); a++) {
+		Archetype& archetype = *archetypes[a];
+		if ((archetype.mask & query) != query) {
+			continue;
+		}
+		for (size_t c = 0; c < archetype.chunks.size(); c++) {
+			Chunk& chunk = archetype.chunks[c];
+			body(chunk.count, EntitiesOf(chunk), ArrayOf<Ts>(archetype, chunk)...);
+		}
+	}
+}
+
+template<typename... Ts, typename Body>
+void EntityWorld::ForEach(const Body& body) {
+	ForEachChunk<Ts...>([&body](unsigned int count, const Entity* entities, Ts*... arrays) {
+		for (unsigned int i = 0; i < count; i++) {
+			body(entities[i], arrays[i]...);
+		}
+	});
+}
+
+template<typename... Ts, typename Body>
+void EntityWorld::ParallelForEachChunk(JobSystem& jobs, const Body& body) {
+	ComponentMask query = MaskOf<Ts...>();
+	std::vector<std::pair<Archetype*, Chunk*>> matches;
+	for (size_t a = 0; a < archetypes.size(); a++) {
+		Archetype& archetype = *archetypes[a];
+		if ((archetype.mask & query) != query) {
+			continue;
+		}
+		for (size_t c = 0; c < archetype.chunks.size(); c++) {
+			matches.push_back(std::make_pair(&archetype, &archetype.chunks[c]));
+		}
+	}
+
+	jobs.ParallelFor(matches.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			Archetype& archetype = *matches[i].first;
+			Chunk& chunk = *matches[i].second;
+			body(i, chunk.count, EntitiesOf(chunk), ArrayOf<Ts>(archetype, chunk)...);
+		}
+	});
+}
+
+template<typename... Ts>
+size_t EntityWorld::CountChunks() {
+	ComponentMask query = MaskOf<Ts...>();
+	size_t count = 0;
+	for (size_t a = 0; a < archetypes.size(); a++) {
+		if ((archetypes[a]->mask & query) == query) {
+			count += archetypes[a]->chunks.size();
+		}
+	}
+	return count;
+}
@@ -0,0 +1,429 @@
+#include "FrameGraph.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "GLState.h"
+#include "GpuMemory.h"
+
+FrameGraph::FrameGraph() {
+	compiled = false;
+	frame = 0;
+	memset(&stats, 0, sizeof(stats));
+	profiler = nullptr;
+	statistics = nullptr;
+}
+
+void FrameGraph::Begin() {
+	resources.clear();
+	passes.clear();
+	order.clear();
+	compiled = false;
+	frame++;
+}
+
+FrameGraphResource FrameGraph::CreateTexture(const char* name, GLsizei width, GLsizei height, GLenum format) {
+	Resource resource;
+	resource.name = name;
+	resource.imported = false;
+	resource.output = false;
+	resource.width = width;
+	resource.height = height;
+	resource.format = format;
+	resource.physical = -1;
+	resource.firstUse = -1;
+	resource.lastUse = -1;
+	resources.push_back(resource);
+	return static_cast<FrameGraphResource>(resources.size() - 1);
+}
+
+FrameGraphResource FrameGraph::ImportResource(const char* name) {
+	FrameGraphResource handle = CreateTexture(name, 0, 0, GL_NONE);
+	resources[handle].imported = true;
+	return handle;
+}
+
+void FrameGraph::MarkOutput(FrameGraphResource resource) {
+	resources[resource].output = true;
+}
+
+unsigned int FrameGraph::AddPass(const char* name, std::function<void()> execute) {
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.kept = false;
+	passes.push_back(pass);
+	return static_cast<unsigned int>(passes.size() - 1);
+}
+
+void FrameGraph::Read(unsigned int pass, FrameGraphResource resource) {
+	passes[pass].reads.push_back(resource);
+	resources[resource].readers.push_back(pass);
+}
+
+void FrameGraph::Write(unsigned int pass, FrameGraphResource resource) {
+	passes[pass].writes.push_back(resource);
+	resources[resource].writers.push_back(pass);
+}
+
+void FrameGraph::CullPasses() {
+	// Walk back from the passes that write outputs: whatever a kept pass
+	// reads needs all of its writers, and a kept pass writing a resource
+	// builds on the writers declared before it.
+	std::vector<unsigned int> stack;
+	for (unsigned int p = 0; p < passes.size(); p++) {
+		for (FrameGraphResource r : passes[p].writes) {
+			if (resources[r].output && !passes[p].kept) {
+				passes[p].kept = true;
+				stack.push_back(p);
+			}
+		}
+	}
+
+	while (!stack.empty()) {
+		unsigned int p = stack.back();
+		stack.pop_back();
+
+		for (FrameGraphResource r : passes[p].reads) {
+			for (unsigned int writer : resources[r].writers) {
+				if (!passes[writer].kept) {
+					passes[writer].kept = true;
+					stack.push_back(writer);
+				}
+			}
+		}
+		for (FrameGraphResource r : passes[p].writes) {
+			for (unsigned int writer : resources[r].writers) {
+				if (writer < p && !passes[writer].kept) {
+					passes[writer].kept = true;
+					stack.push_back(writer);
+				}
+			}
+		}
+	}
+}
+
+bool FrameGraph::SortPasses() {
+	// Writers of a resource run in declaration order; pure readers run after
+	// all of its writers. Ties go to the pass declared first.
+	size_t count = passes.size();
+	std::vector<std::vector<unsigned int>> edges(count);
+	std::vector<unsigned int> incoming(count, 0);
+
+	for (const Resource& resource : resources) {
+		unsigned int previous = UINT32_MAX;
+		for (unsigned int writer : resource.writers) {
+			if (!passes[writer].kept) {
+				continue;
+			}
+			if (previous != UINT32_MAX && previous != writer) {
+				edges[previous].push_back(writer);
+				incoming[writer]++;
+			}
+			previous = writer;
+		}
+		for (unsigned int reader : resource.readers) {
+			if (!passes[reader].kept) {
+				continue;
+			}
+			bool writesToo = false;
+			for (unsigned int writer : resource.writers) {
+				writesToo |= writer == reader;
+			}
+			if (writesToo) {
+				continue;
+			}
+			for (unsigned int writer : resource.writers) {
+				if (passes[writer].kept) {
+					edges[writer].push_back(reader);
+					incoming[reader]++;
+				}
+			}
+		}
+	}
+
+	std::vector<bool> scheduled(count, false);
+	for (;;) {
+		int next = -1;
+		for (unsigned int p = 0; p < count; p++) {
+			if (passes[p].kept && !scheduled[p] && incoming[p] == 0) {
+				next = p;
+				break;
+			}
+		}
+		if (next < 0) {
+			break;
+		}
+		scheduled[next] = true;
+		order.push_back(next);
+		for (unsigned int to : edges[next]) {
+			incoming[to]--;
+		}
+	}
+
+	for (unsigned int p = 0; p < count; p++) {
+		if (passes[p].kept && !scheduled[p]) {
+			printf("Frame graph has a dependency cycle through pass \"%s\"\n", passes[p].name.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrameGraph::AssignTextures() {
+	for (int i = 0; i < (int)order.size(); i++) {
+		const Pass& pass = passes[order[i]];
+		for (const std::vector<FrameGraphResource>* list : { &pass.reads, &pass.writes }) {
+			for (FrameGraphResource r : *list) {
+				Resource& resource = resources[r];
+				if (resource.firstUse < 0) {
+					resource.firstUse = i;
+				}
+				resource.lastUse = i;
+			}
+		}
+	}
+
+	// Place transients in order of first use; a pooled texture is free once
+	// the last user of whatever it held this frame has run.
+	std::vector<FrameGraphResource> transients;
+	for (int r = 0; r < (int)resources.size(); r++) {
+		if (!resources[r].imported && resources[r].firstUse >= 0) {
+			transients.push_back(r);
+		}
+	}
+	for (size_t i = 1; i < transients.size(); i++) {
+		FrameGraphResource r = transients[i];
+		size_t j = i;
+		while (j > 0 && resources[transients[j - 1]].firstUse > resources[r].firstUse) {
+			transients[j] = transients[j - 1];
+			j--;
+		}
+		transients[j] = r;
+	}
+
+	for (FrameGraphResource r : transients) {
+		Resource& resource = resources[r];
+		stats.declaredBytes += GpuMemory::BytesPerTexel(resource.format) * resource.width * resource.height;
+
+		int match = -1;
+		for (size_t t = 0; t < pool.size(); t++) {
+			const PhysicalTexture& texture = pool[t];
+			bool free = texture.lastFrame != frame || texture.busyUntil < resource.firstUse;
+			if (free && texture.width == resource.width && texture.height == resource.height
+				&& texture.format == resource.format) {
+				match = static_cast<int>(t);
+				break;
+			}
+		}
+
+		if (match < 0) {
+			PhysicalTexture texture;
+			texture.texture = GpuMemory::CreateTexture(GPU_MEMORY_RENDER_TARGET, "frame graph transient", GL_TEXTURE_2D,
+				1, resource.format, resource.width, resource.height, 1);
+			glTextureParameteri(texture.texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(texture.texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureParameteri(texture.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(texture.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			texture.width = resource.width;
+			texture.height = resource.height;
+			texture.format = resource.format;
+			texture.bytes = GpuMemory::BytesPerTexel(resource.format) * resource.width * resource.height;
+			texture.lastFrame = 0;
+			texture.busyUntil = -1;
+			pool.push_back(texture);
+			match = static_cast<int>(pool.size() - 1);
+		}
+
+		PhysicalTexture& texture = pool[match];
+		if (texture.lastFrame != frame) {
+			stats.allocatedBytes += texture.bytes;
+		}
+		texture.lastFrame = frame;
+		texture.busyUntil = resource.lastUse;
+		resource.physical = match;
+	}
+
+	for (size_t t = pool.size(); t-- > 0;) {
+		if (frame - pool[t].lastFrame > POOL_RETAIN_FRAMES) {
+			ReleaseTexture(t);
+		}
+	}
+	for (const PhysicalTexture& texture : pool) {
+		stats.pooledBytes += texture.bytes;
+	}
+}
+
+void FrameGraph::ReleaseTexture(size_t index) {
+	GLuint texture = pool[index].texture;
+
+	for (size_t f = framebuffers.size(); f-- > 0;) {
+		bool uses = false;
+		for (int a = 0; a <= MAX_COLOR_ATTACHMENTS; a++) {
+			uses |= framebuffers[f].attachments[a] == texture;
+		}
+		if (uses) {
+			GLState::ForgetFramebuffer(framebuffers[f].framebuffer);
+			glDeleteFramebuffers(1, &framebuffers[f].framebuffer);
+			framebuffers.erase(framebuffers.begin() + f);
+		}
+	}
+
+	GpuMemory::DeleteTexture(texture);
+	pool.erase(pool.begin() + index);
+
+	// Later entries moved down one slot.
+	for (Resource& resource : resources) {
+		if (resource.physical > (int)index) {
+			resource.physical--;
+		}
+	}
+}
+
+GLsizeiptr FrameGraph::ReleaseUnusedTextures(GLsizeiptr bytes) {
+	GLsizeiptr freed = 0;
+	for (size_t t = pool.size(); t-- > 0 && freed < bytes;) {
+		if (pool[t].lastFrame != frame) {
+			freed += pool[t].bytes;
+			ReleaseTexture(t);
+		}
+	}
+	return freed;
+}
+
+bool FrameGraph::Compile() {
+	memset(&stats, 0, sizeof(stats));
+	stats.passCount = static_cast<unsigned int>(passes.size());
+
+	CullPasses();
+	if (!SortPasses()) {
+		order.clear();
+		return false;
+	}
+	AssignTextures();
+
+	stats.passesCulled = stats.passCount - static_cast<unsigned int>(order.size());
+	compiled = true;
+	return true;
+}
+
+void FrameGraph::Execute() {
+	if (!compiled) {
+		return;
+	}
+	for (unsigned int p : order) {
+		unsigned int scope = profiler ? profiler->BeginScope(passes[p].name.c_str()) : GpuProfiler::NO_SCOPE;
+		if (statistics) {
+			statistics->BeginPass(passes[p].name.c_str());
+		}
+		passes[p].execute();
+		if (statistics) {
+			statistics->EndPass();
+		}
+		if (profiler) {
+			profiler->EndScope(scope);
+		}
+	}
+}
+
+GLuint FrameGraph::GetTexture(FrameGraphResource resource) const {
+	if (resource == NO_RESOURCE || resources[resource].physical < 0) {
+		return 0;
+	}
+	return pool[resources[resource].physical].texture;
+}
+
+void FrameGraph::BindTexture(GLuint unit, FrameGraphResource resource) {
+	GLState::BindTexture(unit, GL_TEXTURE_2D, GetTexture(resource));
+}
+
+GLuint FrameGraph::GetFramebuffer(const FrameGraphResource* colors, int colorCount, FrameGraphResource depth) {
+	GLuint attachments[MAX_COLOR_ATTACHMENTS + 1] = { 0 };
+	for (int i = 0; i < colorCount && i < MAX_COLOR_ATTACHMENTS; i++) {
+		attachments[i] = GetTexture(colors[i]);
+	}
+	attachments[MAX_COLOR_ATTACHMENTS] = GetTexture(depth);
+
+	for (const CachedFramebuffer& cached : framebuffers) {
+		if (memcmp(cached.attachments, attachments, sizeof(attachments)) == 0) {
+			return cached.framebuffer;
+		}
+	}
+
+	CachedFramebuffer cached;
+	memcpy(cached.attachments, attachments, sizeof(attachments));
+	glCreateFramebuffers(1, &cached.framebuffer);
+
+	GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+	int drawBufferCount = 0;
+	for (int i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+		if (attachments[i] != 0) {
+			glNamedFramebufferTexture(cached.framebuffer, GL_COLOR_ATTACHMENT0 + i, attachments[i], 0);
+			drawBuffers[drawBufferCount++] = GL_COLOR_ATTACHMENT0 + i;
+		}
+	}
+	if (drawBufferCount > 0) {
+		glNamedFramebufferDrawBuffers(cached.framebuffer, drawBufferCount, drawBuffers);
+	}
+	else {
+		glNamedFramebufferDrawBuffer(cached.framebuffer, GL_NONE);
+	}
+	if (attachments[MAX_COLOR_ATTACHMENTS] != 0) {
+		GLenum attachment = resources[depth].format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		glNamedFramebufferTexture(cached.framebuffer, attachment, attachments[MAX_COLOR_ATTACHMENTS], 0);
+	}
+
+	GLenum status = glCheckNamedFramebufferStatus(cached.framebuffer, GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Frame graph framebuffer is incomplete: 0x%x\n", status);
+	}
+
+	framebuffers.push_back(cached);
+	return cached.framebuffer;
+}
+
+void FrameGraph::BindRenderTarget(const FrameGraphResource* colors, int colorCount, FrameGraphResource depth) {
+	GLState::BindFramebuffer(GetFramebuffer(colors, colorCount, depth));
+
+	FrameGraphResource sized = colorCount > 0 ? colors[0] : depth;
+	glViewport(0, 0, resources[sized].width, resources[sized].height);
+}
+
+void FrameGraph::PrintSchedule() const {
+	printf("Frame graph: %u passes, %u culled\n", stats.passCount, stats.passesCulled);
+	for (unsigned int p : order) {
+		printf("| %s\n", passes[p].name.c_str());
+	}
+	for (const Pass& pass : passes) {
+		if (!pass.kept) {
+			printf("| (culled) %s\n", pass.name.c_str());
+		}
+	}
+	for (const Resource& resource : resources) {
+		if (!resource.imported && resource.physical >= 0) {
+			printf("| %s -> texture %u, passes %d-%d\n", resource.name.c_str(),
+				pool[resource.physical].texture, resource.firstUse, resource.lastUse);
+		}
+	}
+}
+
+void FrameGraph::ClearFrameGraph() {
+	for (const CachedFramebuffer& cached : framebuffers) {
+		GLState::ForgetFramebuffer(cached.framebuffer);
+		glDeleteFramebuffers(1, &cached.framebuffer);
+	}
+	framebuffers.clear();
+
+	for (PhysicalTexture& texture : pool) {
+		GpuMemory::DeleteTexture(texture.texture);
+	}
+	pool.clear();
+
+	resources.clear();
+	passes.clear();
+	order.clear();
+	compiled = false;
+}
+
+FrameGraph::~FrameGraph() {
+	ClearFrameGraph();
+}
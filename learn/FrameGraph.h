@@ -0,0 +1,128 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GpuProfiler.h"
+#include "PipelineStatistics.h"
+
+// Index of a resource declared to the frame graph this frame, or NO_RESOURCE.
+typedef int FrameGraphResource;
+const FrameGraphResource NO_RESOURCE = -1;
+
+// Rebuilt every frame: passes declare what they read and write, then
+// Compile() drops passes that don't contribute to an output, orders the rest
+// by their dependencies and places transient textures in physical ones.
+//
+// Transients whose lifetimes don't overlap share a physical texture when
+// their size and format match. The pool outlives the frame, so render paths
+// that are switched between (forward, tiled, deferred) reuse each other's
+// textures instead of each keeping their own.
+class FrameGraph {
+public:
+	struct MemoryStats {
+		GLsizeiptr declaredBytes;   // transients as declared this frame
+		GLsizeiptr allocatedBytes;  // physical textures they landed in
+		GLsizeiptr pooledBytes;     // everything the pool holds
+		unsigned int passCount;
+		unsigned int passesCulled;
+	};
+
+	FrameGraph();
+
+	void Begin();
+
+	FrameGraphResource CreateTexture(const char* name, GLsizei width, GLsizei height, GLenum format);
+	// Resources owned outside the graph: the default framebuffer, caches kept
+	// across frames, buffers.
+	FrameGraphResource ImportResource(const char* name);
+	// Passes writing an output are never culled.
+	void MarkOutput(FrameGraphResource resource);
+
+	unsigned int AddPass(const char* name, std::function<void()> execute);
+	void Read(unsigned int pass, FrameGraphResource resource);
+	void Write(unsigned int pass, FrameGraphResource resource);
+
+	bool Compile();
+	// With a profiler set, every pass runs inside a scope named after it.
+	void SetProfiler(GpuProfiler* gpuProfiler) { profiler = gpuProfiler; }
+	// Likewise every pass gets its own pipeline statistics.
+	void SetPipelineStatistics(PipelineStatistics* pipelineStatistics) { statistics = pipelineStatistics; }
+	void Execute();
+
+	// Only valid while the graph executes.
+	GLuint GetTexture(FrameGraphResource resource) const;
+	void BindTexture(GLuint unit, FrameGraphResource resource);
+	GLuint GetFramebuffer(const FrameGraphResource* colors, int colorCount, FrameGraphResource depth);
+	void BindRenderTarget(const FrameGraphResource* colors, int colorCount, FrameGraphResource depth);
+
+	// Eviction callback for GpuMemory: frees pooled textures the current
+	// frame isn't using until at least bytes are freed. Returns bytes freed.
+	GLsizeiptr ReleaseUnusedTextures(GLsizeiptr bytes);
+
+	MemoryStats GetLastStats() const { return stats; }
+	void PrintSchedule() const;
+
+	void ClearFrameGraph();
+
+	~FrameGraph();
+
+	static const int MAX_COLOR_ATTACHMENTS = 4;
+	// Pooled textures unused for this many frames are released.
+	static const unsigned int POOL_RETAIN_FRAMES = 120;
+
+private:
+	struct Resource {
+		std::string name;
+		bool imported;
+		bool output;
+		GLsizei width, height;
+		GLenum format;
+		int physical;
+		int firstUse, lastUse;
+		std::vector<unsigned int> writers;
+		std::vector<unsigned int> readers;
+	};
+
+	struct Pass {
+		std::string name;
+		std::function<void()> execute;
+		std::vector<FrameGraphResource> reads;
+		std::vector<FrameGraphResource> writes;
+		bool kept;
+	};
+
+	struct PhysicalTexture {
+		GLuint texture;
+		GLsizei width, height;
+		GLenum format;
+		GLsizeiptr bytes;
+		unsigned int lastFrame;
+		int busyUntil;
+	};
+
+	struct CachedFramebuffer {
+		GLuint framebuffer;
+		GLuint attachments[MAX_COLOR_ATTACHMENTS + 1];
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<unsigned int> order;
+	bool compiled;
+
+	std::vector<PhysicalTexture> pool;
+	std::vector<CachedFramebuffer> framebuffers;
+	unsigned int frame;
+
+	MemoryStats stats;
+	GpuProfiler* profiler;
+	PipelineStatistics* statistics;
+
+	void CullPasses();
+	bool SortPasses();
+	void AssignTextures();
+	void ReleaseTexture(size_t index);
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "CommonValues.h"
+#include "Light.h"
+#include "DirectionalLight.h"
+#include "PointLight.h"
+#include "SpotLight.h"
+
+enum RenderMode {
+	RENDER_FORWARD,
+	RENDER_DEFERRED,
+	RENDER_TILED,
+	// Every fragment adds a fixed colour, no depth test: brightness is overdraw.
+	RENDER_OVERDRAW
+};
+
+// One recorded draw: everything DrawBatch::Submit needs, nothing that touches GL.
+struct DrawPacket {
+	glm::mat4 model;
+	unsigned int mesh;
+	unsigned int material;
+	// False when the draw is outside the camera frustum; it is still
+	// submitted so shadow passes see it as a caster.
+	bool visible;
+};
+
+// Everything the render thread needs to draw one frame. The simulation thread
+// fills one while the render thread replays the previous one, so nothing in
+// here may point back into simulation state.
+struct FramePacket {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 eyePosition;
+	// Framebuffer size when the frame was recorded; the render thread
+	// resizes its screen-sized resources when it changes.
+	GLint bufferWidth, bufferHeight;
+
+	DirectionalLight mainLight;
+	// The first MAX_POINT_LIGHTS / MAX_SPOT_LIGHTS lights, for the uniform
+	// lighting path and the shadow atlas.
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLights[MAX_SPOT_LIGHTS];
+	unsigned int pointLightCount;
+	unsigned int spotLightCount;
+	// Every point and spot light, ready for the tiled light buffer.
+	std::vector<LightData> lights;
+
+	RenderMode renderMode;
+	bool depthPrepass;
+	bool lightHeatmap;
+	bool shadows;
+	bool lightShadows;
+	bool printSchedule;
+	bool writeTrace;
+
+	std::vector<DrawPacket> draws;
+	unsigned int drawsCulled;
+};
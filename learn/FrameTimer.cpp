@@ -0,0 +1,152 @@
+#include "FrameTimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "CpuProfiler.h"
+
+// Past this many samples the sleep estimate behaves like a moving average,
+// so it follows changes in the system timer resolution.
+static const unsigned int MAX_SLEEP_SAMPLES = 64;
+
+static double Seconds(std::chrono::steady_clock::duration duration) {
+	return std::chrono::duration<double>(duration).count();
+}
+
+FrameTimer::FrameTimer() {
+	origin = Clock::now();
+	lastFrame = origin;
+	nextFrame = origin;
+	started = false;
+	period = Clock::duration::zero();
+	pacing = PACING_UNCAPPED;
+	nextSample = 0;
+	sampleCount = 0;
+	keepingAll = false;
+	// Start by assuming a sleep costs about a scheduler tick.
+	sleepMean = 0.002;
+	sleepM2 = 0.0;
+	sleepSamples = 1;
+}
+
+void FrameTimer::SetFrameCap(double framesPerSecond, FramePacing framePacing) {
+	if (framesPerSecond <= 0.0 || framePacing == PACING_UNCAPPED) {
+		period = Clock::duration::zero();
+		pacing = PACING_UNCAPPED;
+		return;
+	}
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+	pacing = framePacing;
+	nextFrame = Clock::now() + period;
+}
+
+void FrameTimer::WaitUntil(Clock::time_point deadline) {
+	PROFILE_ZONE("FrameTimer wait");
+	if (pacing == PACING_SLEEP) {
+		std::this_thread::sleep_until(deadline);
+		return;
+	}
+
+	while (true) {
+		Clock::time_point now = Clock::now();
+		double remaining = Seconds(deadline - now);
+		double estimate = sleepMean + std::sqrt(sleepM2 / sleepSamples);
+		if (remaining <= estimate) {
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		double slept = Seconds(Clock::now() - now);
+
+		// Welford's update, capped so old samples age out.
+		sleepSamples = sleepSamples < MAX_SLEEP_SAMPLES ? sleepSamples + 1 : MAX_SLEEP_SAMPLES;
+		double delta = slept - sleepMean;
+		sleepMean += delta / sleepSamples;
+		sleepM2 += delta * (slept - sleepMean);
+		if (sleepSamples == MAX_SLEEP_SAMPLES) {
+			sleepM2 *= static_cast<double>(MAX_SLEEP_SAMPLES - 1) / MAX_SLEEP_SAMPLES;
+		}
+	}
+
+	while (Clock::now() < deadline) {
+	}
+}
+
+double FrameTimer::BeginFrame() {
+	if (started && pacing != PACING_UNCAPPED) {
+		WaitUntil(nextFrame);
+	}
+
+	Clock::time_point now = Clock::now();
+	double delta = 0.0;
+	if (started) {
+		delta = Seconds(now - lastFrame);
+		frameTimes[nextSample] = delta;
+		nextSample = (nextSample + 1) % HISTORY_FRAMES;
+		sampleCount = sampleCount < HISTORY_FRAMES ? sampleCount + 1 : HISTORY_FRAMES;
+		if (keepingAll) {
+			allFrameTimes.push_back(delta);
+		}
+	}
+	else {
+		nextFrame = now;
+	}
+	started = true;
+	lastFrame = now;
+
+	if (pacing != PACING_UNCAPPED) {
+		nextFrame += period;
+		// More than a frame behind: start over from now instead of rushing
+		// through frames to catch up.
+		if (nextFrame < now) {
+			nextFrame = now + period;
+		}
+	}
+	return delta;
+}
+
+double FrameTimer::GetTime() const {
+	return Seconds(Clock::now() - origin);
+}
+
+void FrameTimer::KeepAllFrames(size_t expectedFrames) {
+	keepingAll = true;
+	allFrameTimes.clear();
+	allFrameTimes.reserve(expectedFrames);
+}
+
+FrameTimer::FrameTimeStats FrameTimer::GetStats() const {
+	return ComputeStats(frameTimes, sampleCount);
+}
+
+FrameTimer::FrameTimeStats FrameTimer::GetAllFramesStats() const {
+	return ComputeStats(allFrameTimes.data(), allFrameTimes.size());
+}
+
+FrameTimer::FrameTimeStats FrameTimer::ComputeStats(const double* times, size_t count) {
+	FrameTimeStats stats = { static_cast<unsigned int>(count), 0.0, 0.0, 0.0, 0.0, 0.0 };
+	if (count == 0) {
+		return stats;
+	}
+
+	std::vector<double> sorted(times, times + count);
+	double total = 0.0;
+	for (double time : sorted) {
+		total += time;
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	// Nearest-rank percentiles.
+	auto percentile = [&sorted](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+		return sorted[rank > 0 ? rank - 1 : 0] * 1000.0;
+	};
+	stats.meanMs = total / count * 1000.0;
+	stats.p50Ms = percentile(0.50);
+	stats.p95Ms = percentile(0.95);
+	stats.p99Ms = percentile(0.99);
+	stats.maxMs = sorted.back() * 1000.0;
+	return stats;
+}
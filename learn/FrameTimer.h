@@ -0,0 +1,77 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+enum FramePacing {
+	PACING_UNCAPPED,
+	// Sleep out the rest of the frame. Cheap, but the OS scheduler decides
+	// when the thread wakes up, which can be a millisecond or more late.
+	PACING_SLEEP,
+	// Sleep while the remaining time comfortably exceeds how long a sleep
+	// actually takes here, then spin up to the deadline.
+	PACING_SLEEP_SPIN
+};
+
+// Double-precision frame clock with an optional frame cap. BeginFrame() waits
+// for the next frame's deadline (deadlines advance by the frame period, so a
+// late frame doesn't push every later one back), then returns the time since
+// the previous frame and adds it to a rolling window of the last
+// HISTORY_FRAMES frame times.
+//
+// Percentiles of that window show hitches the mean frame rate hides. Runs
+// that need statistics over every frame (replays) call KeepAllFrames() first.
+class FrameTimer {
+public:
+	struct FrameTimeStats {
+		unsigned int frames;
+		double meanMs;
+		double p50Ms;
+		double p95Ms;
+		double p99Ms;
+		double maxMs;
+	};
+
+	static const unsigned int HISTORY_FRAMES = 1024;
+
+	FrameTimer();
+
+	// framesPerSecond <= 0 or PACING_UNCAPPED removes the cap.
+	void SetFrameCap(double framesPerSecond, FramePacing framePacing);
+
+	// Seconds since the previous BeginFrame() (0 on the first call).
+	double BeginFrame();
+	// Seconds since the timer was created, from a monotonic clock.
+	double GetTime() const;
+
+	// Also keeps every frame time from now on, however many there are.
+	// expectedFrames is reserved up front, so frames don't allocate.
+	void KeepAllFrames(size_t expectedFrames);
+
+	// Over the rolling window.
+	FrameTimeStats GetStats() const;
+	// Over every frame since KeepAllFrames().
+	FrameTimeStats GetAllFramesStats() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::time_point origin;
+	Clock::time_point lastFrame;
+	Clock::time_point nextFrame;
+	bool started;
+
+	Clock::duration period;
+	FramePacing pacing;
+
+	double frameTimes[HISTORY_FRAMES];
+	unsigned int nextSample, sampleCount;
+	bool keepingAll;
+	std::vector<double> allFrameTimes;
+
+	// Running mean and variance of how long a 1 ms sleep really takes.
+	double sleepMean, sleepM2;
+	unsigned int sleepSamples;
+
+	void WaitUntil(Clock::time_point deadline);
+	static FrameTimeStats ComputeStats(const double* times, size_t count);
+};
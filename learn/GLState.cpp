@@ -0,0 +1,261 @@
+#include "GLState.h"
+
+// Zero matches the state of a freshly created context.
+GLuint GLState::program = 0;
+GLuint GLState::framebuffer = 0;
+GLuint GLState::vertexArray = 0;
+GLuint GLState::buffers[GLState::BUFFER_TARGET_COUNT];
+GLState::BufferRange GLState::indexedBuffers[2][GLState::MAX_INDEXED_BINDINGS];
+GLuint GLState::activeUnit = 0;
+GLuint GLState::textures[GLState::MAX_TEXTURE_UNITS][GLState::TEXTURE_TARGET_COUNT];
+GLint GLState::caps[GLState::CAP_COUNT];
+
+GLState::FrameStats GLState::current = { 0, 0 };
+GLState::FrameStats GLState::last = { 0, 0 };
+
+static const int ELEMENT_ARRAY_SLOT = 1;
+
+int GLState::BufferSlot(GLenum target) {
+	switch (target) {
+	case GL_ARRAY_BUFFER:          return 0;
+	case GL_ELEMENT_ARRAY_BUFFER:  return ELEMENT_ARRAY_SLOT;
+	case GL_UNIFORM_BUFFER:        return 2;
+	case GL_SHADER_STORAGE_BUFFER: return 3;
+	case GL_DRAW_INDIRECT_BUFFER:  return 4;
+	case GL_COPY_READ_BUFFER:      return 5;
+	case GL_COPY_WRITE_BUFFER:     return 6;
+	case GL_PIXEL_UNPACK_BUFFER:   return 7;
+	case GL_PIXEL_PACK_BUFFER:     return 8;
+	default:                       return -1;
+	}
+}
+
+int GLState::IndexedSlot(GLenum target) {
+	switch (target) {
+	case GL_UNIFORM_BUFFER:        return 0;
+	case GL_SHADER_STORAGE_BUFFER: return 1;
+	default:                       return -1;
+	}
+}
+
+int GLState::TextureSlot(GLenum target) {
+	switch (target) {
+	case GL_TEXTURE_2D:       return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_CUBE_MAP: return 2;
+	case GL_TEXTURE_3D:       return 3;
+	default:                  return -1;
+	}
+}
+
+int GLState::CapSlot(GLenum cap) {
+	switch (cap) {
+	case GL_DEPTH_TEST:          return 0;
+	case GL_CULL_FACE:           return 1;
+	case GL_BLEND:               return 2;
+	case GL_STENCIL_TEST:        return 3;
+	case GL_SCISSOR_TEST:        return 4;
+	case GL_POLYGON_OFFSET_FILL: return 5;
+	case GL_DEPTH_CLAMP:         return 6;
+	case GL_FRAMEBUFFER_SRGB:    return 7;
+	default:                     return -1;
+	}
+}
+
+bool GLState::Changed(GLuint& cached, GLuint value) {
+	if (cached == value) {
+		current.elided++;
+		return false;
+	}
+	cached = value;
+	current.issued++;
+	return true;
+}
+
+void GLState::UseProgram(GLuint newProgram) {
+	if (Changed(program, newProgram)) {
+		glUseProgram(newProgram);
+	}
+}
+
+void GLState::BindFramebuffer(GLuint newFramebuffer) {
+	if (Changed(framebuffer, newFramebuffer)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, newFramebuffer);
+	}
+}
+
+void GLState::BindVertexArray(GLuint vao) {
+	if (Changed(vertexArray, vao)) {
+		glBindVertexArray(vao);
+		// The element buffer binding lives inside the VAO.
+		buffers[ELEMENT_ARRAY_SLOT] = UNKNOWN;
+	}
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer) {
+	int slot = BufferSlot(target);
+	if (slot < 0) {
+		current.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (Changed(buffers[slot], buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+	// A size of 0 marks "whole buffer" in the shadow copy.
+	BindBufferRange(target, index, buffer, 0, 0);
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	int slot = IndexedSlot(target);
+	if (slot >= 0 && index < MAX_INDEXED_BINDINGS) {
+		BufferRange& bound = indexedBuffers[slot][index];
+		if (bound.buffer == buffer && bound.offset == offset && bound.size == size) {
+			current.elided++;
+			return;
+		}
+		bound.buffer = buffer;
+		bound.offset = offset;
+		bound.size = size;
+	}
+
+	current.issued++;
+	if (size == 0) {
+		glBindBufferBase(target, index, buffer);
+	}
+	else {
+		glBindBufferRange(target, index, buffer, offset, size);
+	}
+	// Indexed binds also replace the generic binding point.
+	int generic = BufferSlot(target);
+	if (generic >= 0) {
+		buffers[generic] = buffer;
+	}
+}
+
+void GLState::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+	int slot = TextureSlot(target);
+	if (unit >= MAX_TEXTURE_UNITS || slot < 0) {
+		current.issued += 2;
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		return;
+	}
+	if (textures[unit][slot] == texture) {
+		current.elided += 2;
+		return;
+	}
+	if (Changed(activeUnit, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	if (Changed(textures[unit][slot], texture)) {
+		glBindTexture(target, texture);
+	}
+}
+
+void GLState::SetCap(GLenum cap, GLint enabled) {
+	int slot = CapSlot(cap);
+	if (slot >= 0 && caps[slot] == enabled) {
+		current.elided++;
+		return;
+	}
+	if (slot >= 0) {
+		caps[slot] = enabled;
+	}
+	current.issued++;
+	if (enabled) {
+		glEnable(cap);
+	}
+	else {
+		glDisable(cap);
+	}
+}
+
+void GLState::Enable(GLenum cap) {
+	SetCap(cap, 1);
+}
+
+void GLState::Disable(GLenum cap) {
+	SetCap(cap, 0);
+}
+
+void GLState::ForgetProgram(GLuint oldProgram) {
+	if (program == oldProgram) {
+		program = UNKNOWN;
+	}
+}
+
+void GLState::ForgetFramebuffer(GLuint oldFramebuffer) {
+	if (framebuffer == oldFramebuffer) {
+		framebuffer = UNKNOWN;
+	}
+}
+
+void GLState::ForgetVertexArray(GLuint vao) {
+	if (vertexArray == vao) {
+		vertexArray = UNKNOWN;
+		buffers[ELEMENT_ARRAY_SLOT] = UNKNOWN;
+	}
+}
+
+void GLState::ForgetBuffer(GLuint buffer) {
+	for (int i = 0; i < BUFFER_TARGET_COUNT; i++) {
+		if (buffers[i] == buffer) {
+			buffers[i] = UNKNOWN;
+		}
+	}
+	for (int slot = 0; slot < 2; slot++) {
+		for (int i = 0; i < MAX_INDEXED_BINDINGS; i++) {
+			if (indexedBuffers[slot][i].buffer == buffer) {
+				indexedBuffers[slot][i].buffer = UNKNOWN;
+			}
+		}
+	}
+}
+
+void GLState::ForgetTexture(GLuint texture) {
+	for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+		for (int i = 0; i < TEXTURE_TARGET_COUNT; i++) {
+			if (textures[unit][i] == texture) {
+				textures[unit][i] = UNKNOWN;
+			}
+		}
+	}
+}
+
+void GLState::Invalidate() {
+	program = UNKNOWN;
+	framebuffer = UNKNOWN;
+	vertexArray = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (int i = 0; i < BUFFER_TARGET_COUNT; i++) {
+		buffers[i] = UNKNOWN;
+	}
+	for (int slot = 0; slot < 2; slot++) {
+		for (int i = 0; i < MAX_INDEXED_BINDINGS; i++) {
+			indexedBuffers[slot][i].buffer = UNKNOWN;
+		}
+	}
+	for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+		for (int i = 0; i < TEXTURE_TARGET_COUNT; i++) {
+			textures[unit][i] = UNKNOWN;
+		}
+	}
+	for (int i = 0; i < CAP_COUNT; i++) {
+		caps[i] = -1;
+	}
+}
+
+void GLState::BeginFrame() {
+	last = current;
+	current.issued = 0;
+	current.elided = 0;
+}
+
+GLState::FrameStats GLState::GetLastFrameStats() {
+	return last;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <glad/glad.h>
+
+// Shadow copy of the GL bindings we touch every frame. Every bind goes through
+// here so calls that would not change anything never reach the driver.
+class GLState {
+public:
+	struct FrameStats {
+		unsigned int issued;
+		unsigned int elided;
+	};
+
+	static void UseProgram(GLuint program);
+	static void BindFramebuffer(GLuint framebuffer);
+	static void BindVertexArray(GLuint vao);
+	static void BindBuffer(GLenum target, GLuint buffer);
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void Enable(GLenum cap);
+	static void Disable(GLenum cap);
+
+	// Deleted names get unbound by GL and may be handed out again, so the
+	// shadow copy has to drop them too.
+	static void ForgetProgram(GLuint program);
+	static void ForgetFramebuffer(GLuint framebuffer);
+	static void ForgetVertexArray(GLuint vao);
+	static void ForgetBuffer(GLuint buffer);
+	static void ForgetTexture(GLuint texture);
+	static void Invalidate();
+
+	static void BeginFrame();
+	static FrameStats GetLastFrameStats();
+
+	static const int MAX_TEXTURE_UNITS = 16;
+	static const int MAX_INDEXED_BINDINGS = 16;
+
+private:
+	static const int BUFFER_TARGET_COUNT = 9;
+	static const int TEXTURE_TARGET_COUNT = 4;
+	static const int CAP_COUNT = 8;
+	static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+	static GLuint program;
+	static GLuint framebuffer;
+	static GLuint vertexArray;
+	static GLuint buffers[BUFFER_TARGET_COUNT];
+
+	// Indexed uniform (0) and shader storage (1) binding points.
+	struct BufferRange {
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+	static BufferRange indexedBuffers[2][MAX_INDEXED_BINDINGS];
+	static GLuint activeUnit;
+	static GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+	static GLint caps[CAP_COUNT];
+
+	static FrameStats current;
+	static FrameStats last;
+
+	static int BufferSlot(GLenum target);
+	static int IndexedSlot(GLenum target);
+	static int TextureSlot(GLenum target);
+	static int CapSlot(GLenum cap);
+	static void SetCap(GLenum cap, GLint enabled);
+	static bool Changed(GLuint& cached, GLuint value);
+};
@@ -0,0 +1,208 @@
+#include "GpuMemory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "GLState.h"
+
+std::recursive_mutex GpuMemory::lock;
+std::unordered_map<GLuint, GpuMemory::Allocation> GpuMemory::buffers;
+std::unordered_map<GLuint, GpuMemory::Allocation> GpuMemory::textures;
+std::vector<GpuMemory::Evictor> GpuMemory::evictors;
+unsigned int GpuMemory::nextEvictorId = 1;
+GpuMemory::Stats GpuMemory::stats = {};
+
+static const char* CATEGORY_NAMES[GPU_MEMORY_CATEGORY_COUNT] = {
+	"geometry", "textures", "render targets", "shadows", "dynamic"
+};
+
+static const double MEGABYTE = 1024.0 * 1024.0;
+
+const char* GpuMemory::GetCategoryName(GpuMemoryCategory category) {
+	return CATEGORY_NAMES[category];
+}
+
+GLsizeiptr GpuMemory::BytesPerTexel(GLenum format) {
+	switch (format) {
+	case GL_RGBA32F:             return 16;
+	case GL_RGBA16F:             return 8;
+	case GL_RGBA8:
+	case GL_RG16F:
+	case GL_R32F:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:    return 4;
+	case GL_DEPTH_COMPONENT16:   return 2;
+	default:                     return 4;
+	}
+}
+
+GLsizeiptr GpuMemory::TextureBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLsizei levels) {
+	GLsizeiptr bytes = 0;
+	for (GLsizei level = 0; level < levels; level++) {
+		GLsizeiptr levelWidth = width >> level > 0 ? width >> level : 1;
+		GLsizeiptr levelHeight = height >> level > 0 ? height >> level : 1;
+		bytes += levelWidth * levelHeight * BytesPerTexel(internalFormat);
+	}
+	return bytes * (depth > 0 ? depth : 1);
+}
+
+void GpuMemory::Reserve(const char* label, GLsizeiptr bytes) {
+	if (stats.budgetBytes == 0 || stats.totalBytes + bytes <= stats.budgetBytes) {
+		return;
+	}
+
+	// Copied: a callback may remove itself.
+	std::vector<Evictor> callbacks = evictors;
+	for (const Evictor& evictor : callbacks) {
+		GLsizeiptr needed = stats.totalBytes + bytes - stats.budgetBytes;
+		if (needed <= 0) {
+			break;
+		}
+		if (evictor.callback(needed) > 0) {
+			stats.evictions++;
+		}
+	}
+
+	if (stats.totalBytes + bytes > stats.budgetBytes) {
+		stats.overBudgetAllocations++;
+		printf("%s (%.2f MB) takes GPU memory to %.2f MB, over the %.2f MB budget\n", label, bytes / MEGABYTE,
+			(stats.totalBytes + bytes) / MEGABYTE, stats.budgetBytes / MEGABYTE);
+	}
+}
+
+void GpuMemory::Track(std::unordered_map<GLuint, Allocation>& allocations, GLuint name,
+	GpuMemoryCategory category, const char* label, GLsizeiptr bytes) {
+	Allocation allocation = { category, bytes, label ? label : "unnamed" };
+	allocations[name] = allocation;
+
+	CategoryStats& categoryStats = stats.categories[category];
+	categoryStats.bytes += bytes;
+	categoryStats.allocations++;
+	if (categoryStats.bytes > categoryStats.peakBytes) {
+		categoryStats.peakBytes = categoryStats.bytes;
+	}
+	stats.totalBytes += bytes;
+	if (stats.totalBytes > stats.peakBytes) {
+		stats.peakBytes = stats.totalBytes;
+	}
+}
+
+bool GpuMemory::Untrack(std::unordered_map<GLuint, Allocation>& allocations, GLuint name) {
+	std::unordered_map<GLuint, Allocation>::iterator found = allocations.find(name);
+	if (found == allocations.end()) {
+		return false;
+	}
+
+	CategoryStats& categoryStats = stats.categories[found->second.category];
+	categoryStats.bytes -= found->second.bytes;
+	categoryStats.allocations--;
+	stats.totalBytes -= found->second.bytes;
+	allocations.erase(found);
+	return true;
+}
+
+GLuint GpuMemory::CreateBuffer(GpuMemoryCategory category, const char* label,
+	GLsizeiptr size, const void* data, GLbitfield flags) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	Reserve(label, size);
+
+	GLuint buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, data, flags);
+	Track(buffers, buffer, category, label, size);
+	return buffer;
+}
+
+GLuint GpuMemory::CreateTexture(GpuMemoryCategory category, const char* label, GLenum target,
+	GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth) {
+	bool layered = target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D;
+	GLsizeiptr bytes = TextureBytes(internalFormat, width, height, layered ? depth : 1, levels);
+
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	Reserve(label, bytes);
+
+	GLuint texture = 0;
+	glCreateTextures(target, 1, &texture);
+	if (layered) {
+		glTextureStorage3D(texture, levels, internalFormat, width, height, depth);
+	}
+	else {
+		glTextureStorage2D(texture, levels, internalFormat, width, height);
+	}
+	Track(textures, texture, category, label, bytes);
+	return texture;
+}
+
+void GpuMemory::DeleteBuffer(GLuint& buffer) {
+	if (buffer == 0) {
+		return;
+	}
+
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	if (!Untrack(buffers, buffer)) {
+		printf("Deleting buffer %u, which isn't a live tracked allocation\n", buffer);
+	}
+	GLState::ForgetBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void GpuMemory::DeleteTexture(GLuint& texture) {
+	if (texture == 0) {
+		return;
+	}
+
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	if (!Untrack(textures, texture)) {
+		printf("Deleting texture %u, which isn't a live tracked allocation\n", texture);
+	}
+	GLState::ForgetTexture(texture);
+	glDeleteTextures(1, &texture);
+	texture = 0;
+}
+
+void GpuMemory::SetBudget(GLsizeiptr bytes) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	stats.budgetBytes = bytes > 0 ? bytes : 0;
+}
+
+unsigned int GpuMemory::AddEvictionCallback(EvictionCallback callback) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	Evictor evictor = { nextEvictorId++, callback };
+	evictors.push_back(evictor);
+	return evictor.id;
+}
+
+void GpuMemory::RemoveEvictionCallback(unsigned int id) {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	for (size_t i = 0; i < evictors.size(); i++) {
+		if (evictors[i].id == id) {
+			evictors.erase(evictors.begin() + i);
+			return;
+		}
+	}
+}
+
+GpuMemory::Stats GpuMemory::GetStats() {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	return stats;
+}
+
+unsigned int GpuMemory::ReportLeaks() {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	unsigned int leaks = static_cast<unsigned int>(buffers.size() + textures.size());
+	if (leaks == 0) {
+		return 0;
+	}
+
+	printf("%u GPU allocations (%.2f MB) were never freed:\n", leaks, stats.totalBytes / MEGABYTE);
+	for (const std::pair<const GLuint, Allocation>& buffer : buffers) {
+		printf("| buffer %u: %s, %s, %lld bytes\n", buffer.first, buffer.second.label.c_str(),
+			CATEGORY_NAMES[buffer.second.category], static_cast<long long>(buffer.second.bytes));
+	}
+	for (const std::pair<const GLuint, Allocation>& texture : textures) {
+		printf("| texture %u: %s, %s, %lld bytes\n", texture.first, texture.second.label.c_str(),
+			CATEGORY_NAMES[texture.second.category], static_cast<long long>(texture.second.bytes));
+	}
+	return leaks;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+enum GpuMemoryCategory {
+	GPU_MEMORY_GEOMETRY,       // vertex and index buffers
+	GPU_MEMORY_TEXTURE,        // material textures
+	GPU_MEMORY_RENDER_TARGET,  // frame graph transients
+	GPU_MEMORY_SHADOW,         // shadow maps and their per-light data
+	GPU_MEMORY_DYNAMIC,        // per-frame ring, material records, light lists
+	GPU_MEMORY_CATEGORY_COUNT
+};
+
+// Every buffer and texture the renderer allocates goes through here, so GPU
+// memory use is known by category, current and peak. Sizes are what the
+// storage calls ask for; drivers pad and may keep extra copies, so the real
+// footprint is somewhat higher.
+//
+// With a budget set, an allocation that would go over it first runs the
+// eviction callbacks (caches that can drop things) in the order they were
+// added. If that doesn't free enough the allocation still goes ahead, since
+// rendering can't do without it, and is counted as over budget.
+//
+// Allocations still alive at shutdown are reported as leaks, and deleting a
+// name that isn't tracked (a double delete through a copied handle) is
+// reported straight away.
+class GpuMemory {
+public:
+	struct CategoryStats {
+		GLsizeiptr bytes;
+		GLsizeiptr peakBytes;
+		unsigned int allocations;
+	};
+
+	struct Stats {
+		GLsizeiptr totalBytes;
+		GLsizeiptr peakBytes;
+		GLsizeiptr budgetBytes;
+		unsigned int evictions;
+		unsigned int overBudgetAllocations;
+		CategoryStats categories[GPU_MEMORY_CATEGORY_COUNT];
+	};
+
+	// Asked to free at least bytesNeeded; returns how much it did free.
+	typedef std::function<GLsizeiptr(GLsizeiptr bytesNeeded)> EvictionCallback;
+
+	// glCreateBuffers + glNamedBufferStorage.
+	static GLuint CreateBuffer(GpuMemoryCategory category, const char* label,
+		GLsizeiptr size, const void* data, GLbitfield flags);
+	// glCreateTextures + glTextureStorage2D / 3D. depth is the layer count for
+	// array targets and ignored for GL_TEXTURE_2D.
+	static GLuint CreateTexture(GpuMemoryCategory category, const char* label, GLenum target,
+		GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth);
+	// Both also drop the name from GLState and zero it.
+	static void DeleteBuffer(GLuint& buffer);
+	static void DeleteTexture(GLuint& texture);
+
+	static GLsizeiptr BytesPerTexel(GLenum format);
+	static GLsizeiptr TextureBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLsizei levels);
+
+	// 0 turns the budget off.
+	static void SetBudget(GLsizeiptr bytes);
+	static unsigned int AddEvictionCallback(EvictionCallback callback);
+	static void RemoveEvictionCallback(unsigned int id);
+
+	static Stats GetStats();
+	static const char* GetCategoryName(GpuMemoryCategory category);
+
+	// Prints every allocation still alive and returns how many there are.
+	// Call once everything has been cleared.
+	static unsigned int ReportLeaks();
+
+private:
+	struct Allocation {
+		GpuMemoryCategory category;
+		GLsizeiptr bytes;
+		std::string label;
+	};
+
+	struct Evictor {
+		unsigned int id;
+		EvictionCallback callback;
+	};
+
+	// Recursive: eviction callbacks delete through this class while an
+	// allocation holds the lock.
+	static std::recursive_mutex lock;
+	static std::unordered_map<GLuint, Allocation> buffers;
+	static std::unordered_map<GLuint, Allocation> textures;
+	static std::vector<Evictor> evictors;
+	static unsigned int nextEvictorId;
+	static Stats stats;
+
+	static void Reserve(const char* label, GLsizeiptr bytes);
+	static void Track(std::unordered_map<GLuint, Allocation>& allocations, GLuint name,
+		GpuMemoryCategory category, const char* label, GLsizeiptr bytes);
+	static bool Untrack(std::unordered_map<GLuint, Allocation>& allocations, GLuint name);
+};
@@ -0,0 +1,203 @@
+#include "GpuProfiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+GpuProfiler::GpuProfiler() {
+	created = false;
+	inFrame = false;
+	frameNumber = 0;
+	current = 0;
+	droppedFrames = 0;
+	historyNext = 0;
+	historyCount = 0;
+	for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+		memset(queryFrames[i].queries, 0, sizeof(queryFrames[i].queries));
+		queryFrames[i].lastQuery = 0;
+		queryFrames[i].pending = false;
+		queryFrames[i].record.count = 0;
+	}
+}
+
+bool GpuProfiler::CreateGpuProfiler() {
+	GLint counterBits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+	if (counterBits == 0) {
+		printf("GL_TIMESTAMP queries aren't supported, GPU profiling is off\n");
+		return false;
+	}
+
+	for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+		glCreateQueries(GL_TIMESTAMP, MAX_SCOPES * 2, queryFrames[i].queries);
+	}
+	history.resize(HISTORY_FRAMES);
+	created = true;
+	return true;
+}
+
+unsigned int GpuProfiler::InternName(const char* name) {
+	for (size_t i = 0; i < names.size(); i++) {
+		if (names[i] == name) {
+			return static_cast<unsigned int>(i);
+		}
+	}
+	names.push_back(name);
+	return static_cast<unsigned int>(names.size() - 1);
+}
+
+void GpuProfiler::Resolve(QueryFrame& frame) {
+	frame.pending = false;
+	FrameRecord& record = frame.record;
+	if (record.count == 0) {
+		return;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		droppedFrames++;
+		return;
+	}
+
+	unsigned int resolved = 0;
+	for (unsigned int i = 0; i < record.count; i++) {
+		Sample& sample = record.samples[i];
+		if (!sample.ended) {
+			continue;
+		}
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &sample.gpuBegin);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &sample.gpuEnd);
+		record.samples[resolved++] = sample;
+	}
+	record.count = resolved;
+
+	history[historyNext] = record;
+	historyNext = (historyNext + 1) % HISTORY_FRAMES;
+	historyCount = historyCount < HISTORY_FRAMES ? historyCount + 1 : HISTORY_FRAMES;
+}
+
+void GpuProfiler::BeginFrame() {
+	if (!created) {
+		return;
+	}
+
+	current = (current + 1) % QUERY_FRAMES;
+	QueryFrame& frame = queryFrames[current];
+	// The oldest queries are reused this frame; collect them first.
+	if (frame.pending) {
+		Resolve(frame);
+	}
+
+	frame.record.frameNumber = frameNumber++;
+	frame.record.count = 0;
+	frame.record.cpuStartUs = ChromeTrace::NowUs();
+	glGetInteger64v(GL_TIMESTAMP, &frame.record.gpuStart);
+	inFrame = true;
+}
+
+unsigned int GpuProfiler::BeginScope(const char* name) {
+	FrameRecord& record = queryFrames[current].record;
+	if (!inFrame || record.count == MAX_SCOPES) {
+		return NO_SCOPE;
+	}
+
+	unsigned int scope = record.count++;
+	Sample& sample = record.samples[scope];
+	sample.name = InternName(name);
+	sample.cpuBeginUs = ChromeTrace::NowUs();
+	sample.cpuEndUs = sample.cpuBeginUs;
+	sample.ended = false;
+	glQueryCounter(queryFrames[current].queries[scope * 2], GL_TIMESTAMP);
+	queryFrames[current].lastQuery = scope * 2;
+	return scope;
+}
+
+void GpuProfiler::EndScope(unsigned int scope) {
+	if (!inFrame || scope == NO_SCOPE) {
+		return;
+	}
+
+	glQueryCounter(queryFrames[current].queries[scope * 2 + 1], GL_TIMESTAMP);
+	queryFrames[current].lastQuery = scope * 2 + 1;
+	Sample& sample = queryFrames[current].record.samples[scope];
+	sample.cpuEndUs = ChromeTrace::NowUs();
+	sample.ended = true;
+}
+
+void GpuProfiler::EndFrame() {
+	if (!inFrame) {
+		return;
+	}
+	queryFrames[current].pending = true;
+	inFrame = false;
+}
+
+std::vector<GpuProfiler::ScopeTiming> GpuProfiler::GetAverages(unsigned int frames) const {
+	std::vector<ScopeTiming> timings(names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		timings[i].name = names[i];
+		timings[i].cpuMs = 0.0;
+		timings[i].gpuMs = 0.0;
+	}
+
+	frames = frames < historyCount ? frames : historyCount;
+	if (frames == 0) {
+		return timings;
+	}
+
+	for (unsigned int f = 0; f < frames; f++) {
+		const FrameRecord& record = history[(historyNext + HISTORY_FRAMES - 1 - f) % HISTORY_FRAMES];
+		for (unsigned int i = 0; i < record.count; i++) {
+			const Sample& sample = record.samples[i];
+			timings[sample.name].cpuMs += (sample.cpuEndUs - sample.cpuBeginUs) / 1000.0;
+			timings[sample.name].gpuMs += (sample.gpuEnd - sample.gpuBegin) / 1000000.0;
+		}
+	}
+	for (size_t i = 0; i < timings.size(); i++) {
+		timings[i].cpuMs /= frames;
+		timings[i].gpuMs /= frames;
+	}
+	return timings;
+}
+
+void GpuProfiler::AddToTrace(ChromeTrace& trace) const {
+	trace.NameProcess(TRACE_PID, "Frame graph");
+	trace.NameThread(TRACE_PID, 1, "render thread");
+	trace.NameThread(TRACE_PID, 2, "GPU");
+
+	unsigned int first = (historyNext + HISTORY_FRAMES - historyCount) % HISTORY_FRAMES;
+	for (unsigned int f = 0; f < historyCount; f++) {
+		const FrameRecord& record = history[(first + f) % HISTORY_FRAMES];
+		for (unsigned int i = 0; i < record.count; i++) {
+			const Sample& sample = record.samples[i];
+			double gpuBeginUs = record.cpuStartUs + (static_cast<GLint64>(sample.gpuBegin) - record.gpuStart) / 1000.0;
+			double gpuDurationUs = (sample.gpuEnd - sample.gpuBegin) / 1000.0;
+
+			const char* name = names[sample.name].c_str();
+			trace.AddZone(TRACE_PID, 1, name, sample.cpuBeginUs, sample.cpuEndUs - sample.cpuBeginUs, record.frameNumber);
+			trace.AddZone(TRACE_PID, 2, name, gpuBeginUs, gpuDurationUs, record.frameNumber);
+		}
+	}
+}
+
+void GpuProfiler::ClearGpuProfiler() {
+	for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+		if (queryFrames[i].queries[0] != 0) {
+			glDeleteQueries(MAX_SCOPES * 2, queryFrames[i].queries);
+		}
+		memset(queryFrames[i].queries, 0, sizeof(queryFrames[i].queries));
+		queryFrames[i].lastQuery = 0;
+		queryFrames[i].pending = false;
+		queryFrames[i].record.count = 0;
+	}
+	history.clear();
+	historyNext = 0;
+	historyCount = 0;
+	names.clear();
+	created = false;
+	inFrame = false;
+}
+
+GpuProfiler::~GpuProfiler() {
+	ClearGpuProfiler();
+}
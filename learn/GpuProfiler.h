@@ -0,0 +1,98 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "ChromeTrace.h"
+
+// Per-frame CPU and GPU timings of named scopes (the frame graph opens one
+// per pass). Each scope takes a CPU timestamp and a GL_TIMESTAMP query at
+// both ends; timestamps rather than GL_TIME_ELAPSED so scopes may nest.
+//
+// The queries of a frame are read back QUERY_FRAMES frames later, when the
+// GPU has normally finished with them. A frame whose results still aren't in
+// is dropped rather than waited on, so profiling never stalls the pipeline.
+// Resolved frames go into a ring of the last HISTORY_FRAMES frames, which can
+// be averaged or added to a Chrome trace next to the CPU profiler's zones.
+//
+// Render thread only.
+class GpuProfiler {
+public:
+	struct ScopeTiming {
+		std::string name;
+		double cpuMs;
+		double gpuMs;
+	};
+
+	static const unsigned int MAX_SCOPES = 64;
+	static const unsigned int QUERY_FRAMES = 3;
+	static const unsigned int HISTORY_FRAMES = 240;
+	static const unsigned int NO_SCOPE = 0xFFFFFFFFu;
+	// Scopes and their GPU execution are two tracks of this process.
+	static const unsigned int TRACE_PID = 2;
+
+	GpuProfiler();
+
+	bool CreateGpuProfiler();
+
+	void BeginFrame();
+	// Returns NO_SCOPE once the frame has MAX_SCOPES scopes; EndScope ignores it.
+	unsigned int BeginScope(const char* name);
+	void EndScope(unsigned int scope);
+	void EndFrame();
+
+	// Mean time per frame of every scope name over the last frames resolved
+	// frames, in the order the names were first seen.
+	std::vector<ScopeTiming> GetAverages(unsigned int frames) const;
+	unsigned int GetResolvedFrameCount() const { return historyCount; }
+	unsigned int GetDroppedFrameCount() const { return droppedFrames; }
+
+	void AddToTrace(ChromeTrace& trace) const;
+
+	void ClearGpuProfiler();
+
+	~GpuProfiler();
+
+private:
+	struct Sample {
+		unsigned int name;
+		double cpuBeginUs, cpuEndUs;
+		GLuint64 gpuBegin, gpuEnd;
+		// Scopes never ended have no end query this frame and aren't resolved.
+		bool ended;
+	};
+
+	struct FrameRecord {
+		unsigned int frameNumber;
+		// CPU time and GPU clock sampled together at BeginFrame(), used to
+		// place GPU timestamps on the CPU timeline.
+		double cpuStartUs;
+		GLint64 gpuStart;
+		unsigned int count;
+		Sample samples[MAX_SCOPES];
+	};
+
+	struct QueryFrame {
+		GLuint queries[MAX_SCOPES * 2];
+		// The query issued last completes last; only it is polled.
+		unsigned int lastQuery;
+		bool pending;
+		FrameRecord record;
+	};
+
+	bool created;
+	bool inFrame;
+	unsigned int frameNumber;
+	unsigned int current;
+	unsigned int droppedFrames;
+	QueryFrame queryFrames[QUERY_FRAMES];
+
+	std::vector<FrameRecord> history;
+	unsigned int historyNext, historyCount;
+
+	std::vector<std::string> names;
+
+	unsigned int InternName(const char* name);
+	void Resolve(QueryFrame& frame);
+};
@@ -0,0 +1,82 @@
+#include "JobBenchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+#include "JobSystem.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t SPAWN_JOBS = 200000;
+// Stays under the deque capacity so every job is really queued.
+static const size_t SPAWN_BATCH = 1024;
+static const size_t SCALING_ELEMENTS = 1 << 22;
+static const size_t SCALING_MIN_BATCH = 4096;
+static const int REPEATS = 5;
+
+static double ElapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void EmptyJob(void*, size_t, size_t) {
+}
+
+// Nanoseconds to queue, run and retire one empty job.
+static double MeasureSpawn(JobSystem& jobs) {
+	Clock::time_point start = Clock::now();
+	for (size_t spawned = 0; spawned < SPAWN_JOBS; spawned += SPAWN_BATCH) {
+		JobCounter counter;
+		for (size_t i = 0; i < SPAWN_BATCH; i++) {
+			jobs.Run(&EmptyJob, nullptr, 0, 0, &counter);
+		}
+		jobs.Wait(counter);
+	}
+	return ElapsedMs(start) * 1.0e6 / SPAWN_JOBS;
+}
+
+// Best of REPEATS runs of a ParallelFor heavy enough to be compute bound.
+static double MeasureScaling(JobSystem& jobs, std::vector<float>& data) {
+	double best = 0.0;
+	for (int repeat = 0; repeat < REPEATS; repeat++) {
+		Clock::time_point start = Clock::now();
+		jobs.ParallelFor(data.size(), SCALING_MIN_BATCH, [&data](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				float x = static_cast<float>(i);
+				data[i] = sqrtf(x) * sinf(x) + cosf(x * 0.5f);
+			}
+		});
+		double ms = ElapsedMs(start);
+		best = repeat == 0 || ms < best ? ms : best;
+	}
+	return best;
+}
+
+void RunJobBenchmark() {
+	unsigned int cores = std::thread::hardware_concurrency();
+	cores = cores > 0 ? cores : 1;
+	std::vector<float> data(SCALING_ELEMENTS);
+
+	printf("Job system benchmark, %u hardware threads\n", cores);
+	printf("%8s %16s %14s %10s\n", "threads", "ns per job", "parallel ms", "speedup");
+
+	double serialMs = 0.0;
+	for (unsigned int threads = 1; threads <= cores; threads = threads < cores && threads * 2 > cores ? cores : threads * 2) {
+		JobSystem jobs;
+		jobs.CreateJobSystem(threads - 1);
+
+		double spawnNs = MeasureSpawn(jobs);
+		double parallelMs = MeasureScaling(jobs, data);
+		if (threads == 1) {
+			serialMs = parallelMs;
+		}
+		printf("%8u %16.1f %14.2f %9.2fx\n", threads, spawnNs, parallelMs, serialMs / parallelMs);
+
+		jobs.ClearJobSystem();
+		if (threads == cores) {
+			break;
+		}
+	}
+}
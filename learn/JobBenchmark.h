@@ -0,0 +1,6 @@
+#pragma once
+
+// Measures the job system on its own, without a window: the cost of spawning
+// and finishing empty jobs, and how a compute-bound ParallelFor scales as
+// worker threads are added. Run the program with --job-benchmark.
+void RunJobBenchmark();
@@ -0,0 +1,282 @@
+#include "JobSystem.h"
+
+#include <stdint.h>
+#include <chrono>
+#include <stdio.h>
+
+#include "CpuProfiler.h"
+
+// Chase-Lev deque with a fixed capacity. Only the owning thread calls Push and
+// Pop; any thread may Steal. Jobs are copied in and out by value, and a full
+// deque makes Push fail so the caller runs the job itself.
+class JobSystem::JobQueue {
+public:
+	JobQueue() : top(0), bottom(0) {}
+
+	bool Push(const Job& job) {
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY) {
+			return false;
+		}
+		jobs[b & MASK] = job;
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool Pop(Job& job) {
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		job = jobs[b & MASK];
+		if (t == b) {
+			// Last job: race the thieves for it.
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	bool Steal(Job& job) {
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b) {
+			return false;
+		}
+
+		job = jobs[t & MASK];
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+private:
+	static const int64_t CAPACITY = 4096;
+	static const int64_t MASK = CAPACITY - 1;
+
+	std::atomic<int64_t> top;
+	std::atomic<int64_t> bottom;
+	Job jobs[CAPACITY];
+};
+
+// Idle workers spin this many times before sleeping. A sleeping worker is
+// woken by new jobs, or after SLEEP_TIMEOUT in case a wake-up was missed.
+static const int IDLE_SPINS = 64;
+static const std::chrono::milliseconds SLEEP_TIMEOUT(1);
+
+static std::atomic<unsigned int> nextSystemID(1);
+
+// Each thread caches which queue it owns in the system it last used.
+static thread_local unsigned int threadSystemID = 0;
+static thread_local void* threadQueue = nullptr;
+
+JobSystem::JobSystem() :
+	systemID(0),
+	workerCount(0),
+	externalQueues(0),
+	stopping(false),
+	waitingCount(0),
+	sleepers(0)
+{
+}
+
+bool JobSystem::CreateJobSystem(unsigned int workerThreads) {
+	if (!queues.empty()) {
+		printf("Job system already created\n");
+		return false;
+	}
+
+	systemID = nextSystemID.fetch_add(1);
+	workerCount = workerThreads;
+	externalQueues = 0;
+	stopping = false;
+
+	for (unsigned int i = 0; i < 1 + workerCount + MAX_EXTERNAL_THREADS; i++) {
+		queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+	}
+	waiting.reserve(MAX_WAITING_JOBS);
+
+	threadSystemID = systemID;
+	threadQueue = queues[0].get();
+
+	for (unsigned int i = 1; i <= workerCount; i++) {
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+	return true;
+}
+
+JobSystem::JobQueue* JobSystem::GetQueue() {
+	if (queues.empty()) {
+		return nullptr;
+	}
+	if (threadSystemID == systemID) {
+		return static_cast<JobQueue*>(threadQueue);
+	}
+
+	unsigned int slot = externalQueues.fetch_add(1);
+	threadSystemID = systemID;
+	threadQueue = slot < MAX_EXTERNAL_THREADS ? queues[1 + workerCount + slot].get() : nullptr;
+	return static_cast<JobQueue*>(threadQueue);
+}
+
+void JobSystem::Run(JobFunction function, void* data, size_t begin, size_t end,
+	JobCounter* counter, const JobCounter* dependency) {
+	if (counter) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job job = { function, data, begin, end, counter, dependency };
+	if (dependency && !dependency->IsDone() && !queues.empty()) {
+		{
+			std::lock_guard<std::mutex> lock(waitingMutex);
+			if (waiting.size() < MAX_WAITING_JOBS) {
+				waiting.push_back(job);
+				waitingCount.fetch_add(1, std::memory_order_release);
+				return;
+			}
+		}
+		// The waiting list is full; growing it would allocate, so this
+		// thread helps finish the dependency and then queues the job as usual.
+		Wait(*dependency);
+	}
+
+	JobQueue* queue = GetQueue();
+	if (!queue || !queue->Push(job)) {
+		// No queue for this thread, or it's full: run the job right here.
+		if (dependency) {
+			Wait(*dependency);
+		}
+		Execute(job);
+		return;
+	}
+
+	if (sleepers.load(std::memory_order_relaxed) > 0) {
+		wake.notify_one();
+	}
+}
+
+void JobSystem::Wait(const JobCounter& counter) {
+	JobQueue* own = GetQueue();
+	unsigned int seed = 0;
+	while (!counter.IsDone()) {
+		if (!RunOne(own, seed++)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::RunOne(JobQueue* own, unsigned int seed) {
+	if (waitingCount.load(std::memory_order_acquire) > 0) {
+		ReleaseReadyJobs(own);
+	}
+
+	Job job;
+	if (!FindJob(own, seed, job)) {
+		return false;
+	}
+	Execute(job);
+	return true;
+}
+
+bool JobSystem::FindJob(JobQueue* own, unsigned int seed, Job& job) {
+	if (own && own->Pop(job)) {
+		return true;
+	}
+
+	size_t count = queues.size();
+	for (size_t i = 0; i < count; i++) {
+		JobQueue* victim = queues[(seed + i) % count].get();
+		if (victim != own && victim->Steal(job)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::ReleaseReadyJobs(JobQueue* own) {
+	// On the stack rather than a vector, so releasing never allocates. Jobs
+	// past RELEASE_BATCH stay waiting for the next call.
+	const size_t RELEASE_BATCH = 64;
+	Job ready[RELEASE_BATCH];
+	size_t readyCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(waitingMutex);
+		for (size_t i = 0; i < waiting.size() && readyCount < RELEASE_BATCH;) {
+			if (waiting[i].dependency->IsDone()) {
+				ready[readyCount++] = waiting[i];
+				waiting[i] = waiting.back();
+				waiting.pop_back();
+			}
+			else {
+				i++;
+			}
+		}
+		waitingCount.store(static_cast<int>(waiting.size()), std::memory_order_release);
+	}
+
+	for (size_t i = 0; i < readyCount; i++) {
+		if (!own || !own->Push(ready[i])) {
+			Execute(ready[i]);
+		}
+	}
+}
+
+void JobSystem::Execute(const Job& job) {
+	PROFILE_ZONE("job");
+	job.function(job.data, job.begin, job.end);
+	if (job.counter) {
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int index) {
+	PROFILE_THREAD("job worker");
+	threadSystemID = systemID;
+	threadQueue = queues[index].get();
+	JobQueue* own = queues[index].get();
+
+	unsigned int seed = index;
+	int idle = 0;
+	while (!stopping.load(std::memory_order_relaxed)) {
+		if (RunOne(own, seed++)) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepers.fetch_add(1, std::memory_order_relaxed);
+		wake.wait_for(lock, SLEEP_TIMEOUT);
+		sleepers.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
+
+void JobSystem::ClearJobSystem() {
+	stopping = true;
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+	queues.clear();
+	waiting.clear();
+	waitingCount = 0;
+	workerCount = 0;
+	systemID = 0;
+	stopping = false;
+}
+
+JobSystem::~JobSystem() {
+	ClearJobSystem();
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+// Counts unfinished jobs. Run() increments it when a job is queued and the job
+// decrements it when it returns, so zero means "all done".
+struct JobCounter {
+	std::atomic<int> pending;
+
+	JobCounter() : pending(0) {}
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// A job is a plain function over a range of some shared data. Keeping it this
+// small (no allocation, no std::function) is what keeps spawning cheap.
+typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+// Fixed-size work-stealing scheduler. Every thread that queues jobs gets its
+// own deque: the owner pushes and pops at the bottom, idle threads steal from
+// the top of someone else's. Threads that wait on a counter run jobs while
+// they wait instead of blocking.
+class JobSystem {
+public:
+	JobSystem();
+
+	// The calling thread becomes queue 0; workerThreads threads are started.
+	// Other threads get a queue the first time they queue a job.
+	bool CreateJobSystem(unsigned int workerThreads);
+
+	// Worker threads plus the creating thread.
+	unsigned int GetThreadCount() const { return workerCount + 1; }
+
+	// Queues function(data, begin, end). counter may be null. A job with a
+	// dependency isn't started until that counter reaches zero. Never
+	// allocates: when the thread's deque or the waiting list is full, the
+	// job runs on the calling thread instead.
+	void Run(JobFunction function, void* data, size_t begin, size_t end,
+		JobCounter* counter, const JobCounter* dependency = nullptr);
+	// Runs queued jobs on the calling thread until counter reaches zero.
+	void Wait(const JobCounter& counter);
+
+	// Splits [0, count) into batches of at least minBatch and calls
+	// body(begin, end) for each, on any thread, returning once all are done.
+	template<typename Body>
+	void ParallelFor(size_t count, size_t minBatch, const Body& body);
+
+	void ClearJobSystem();
+
+	~JobSystem();
+
+	// More batches than threads so a thread that finishes early has
+	// something left to steal.
+	static const unsigned int BATCHES_PER_THREAD = 4;
+
+private:
+	struct Job {
+		JobFunction function;
+		void* data;
+		size_t begin, end;
+		JobCounter* counter;
+		const JobCounter* dependency;
+	};
+	class JobQueue;
+
+	// Threads that aren't workers and didn't create the system.
+	static const unsigned int MAX_EXTERNAL_THREADS = 4;
+	// Jobs waiting on a dependency at once; reserved when the system is
+	// created.
+	static const size_t MAX_WAITING_JOBS = 1024;
+
+	// Identifies this system in the threads' cached queue lookup, so a
+	// recreated system never hands out a queue from the previous one.
+	unsigned int systemID;
+	unsigned int workerCount;
+	std::vector<std::unique_ptr<JobQueue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<unsigned int> externalQueues;
+	std::atomic<bool> stopping;
+
+	// Jobs whose dependency wasn't done when they were queued.
+	std::mutex waitingMutex;
+	std::vector<Job> waiting;
+	std::atomic<int> waitingCount;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> sleepers;
+
+	JobQueue* GetQueue();
+	bool RunOne(JobQueue* own, unsigned int seed);
+	bool FindJob(JobQueue* own, unsigned int seed, Job& job);
+	void ReleaseReadyJobs(JobQueue* own);
+	void Execute(const Job& job);
+	void WorkerLoop(unsigned int index);
+
+	template<typename Body>
+	static void InvokeBody(void* data, size_t begin, size_t end) {
+		(*static_cast<const Body*>(data))(begin, end);
+	}
+};
+
+template<typename Body>
+void JobSystem::ParallelFor(size_t count, size_t minBatch, const Body& body) {
+	if (count == 0) {
+		return;
+	}
+	minBatch = minBatch > 0 ? minBatch : 1;
+	size_t batches = count / minBatch;
+	size_t maxBatches = static_cast<size_t>(GetThreadCount()) * BATCHES_PER_THREAD;
+	batches = batches < maxBatches ? batches : maxBatches;
+	if (batches <= 1 || workerCount == 0) {
+		body(0, count);
+		return;
+	}
+
+	// The body lives on this stack frame, which is fine: nothing returns
+	// before every batch has finished.
+	JobCounter counter;
+	for (size_t i = 1; i < batches; i++) {
+		Run(&InvokeBody<Body>, const_cast<Body*>(&body), count * i / batches, count * (i + 1) / batches, &counter);
+	}
+	body(0, count / batches);
+	Wait(counter);
+}
@@ -2,6 +2,21 @@
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
+// One point or spot light as the shaders' light storage buffer sees it (std430).
+struct LightData {
+	glm::vec4 positionRange;  // xyz position, w range
+	glm::vec4 colorAmbient;   // rgb color, a ambient intensity
+	glm::vec4 directionEdge;  // xyz spot direction, w cosine of the spot edge
+	glm::vec4 attenuation;    // constant, linear, exponent, diffuse intensity
+	GLuint type;              // LIGHT_DATA_POINT or LIGHT_DATA_SPOT
+	GLuint shadowIndex;       // slot in the shadow atlas' light table, or NO_SHADOW
+	GLuint pad[2];
+};
+
+const GLuint LIGHT_DATA_POINT = 0;
+const GLuint LIGHT_DATA_SPOT = 1;
+const GLuint NO_SHADOW = 0xFFFFFFFFu;
+
 class Light {
 public:
 	Light();
@@ -1,9 +1,13 @@
+#pragma once
 #include <glad/glad.h>
 class Material {
 public:
 	Material();
 	Material(GLfloat sIntensity, GLfloat shine);
 	void UseMaterial(GLuint specularIntensityLocation, GLuint shininessLocation);
+
+	GLfloat GetSpecularIntensity() const { return specularIntensity; }
+	GLfloat GetShininess() const { return shininess; }
 	~Material();
 
 private:
@@ -0,0 +1,72 @@
+#include "MaterialRegistry.h"
+#include <stdio.h>
+#include "CommonValues.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+MaterialRegistry::MaterialRegistry() {
+	materialBuffer = 0;
+	capacity = 0;
+	dirty = false;
+}
+
+MaterialRegistry::MaterialData MaterialRegistry::MakeRecord(const Material& material, TextureHandle texture) {
+	if (material.GetSpecularIntensity() > MAX_SPECULAR_INTENSITY) {
+		printf("Specular intensity %.2f is above %.2f, light ranges will clip its highlights\n",
+			material.GetSpecularIntensity(), MAX_SPECULAR_INTENSITY);
+	}
+
+	MaterialData record;
+	record.specularIntensity = material.GetSpecularIntensity();
+	record.shininess = material.GetShininess();
+	record.textureArray = texture.array;
+	record.textureLayer = texture.layer;
+	return record;
+}
+
+unsigned int MaterialRegistry::AddMaterial(const Material& material, TextureHandle texture) {
+	records.push_back(MakeRecord(material, texture));
+	dirty = true;
+	return static_cast<unsigned int>(records.size() - 1);
+}
+
+void MaterialRegistry::SetMaterial(unsigned int index, const Material& material, TextureHandle texture) {
+	records[index] = MakeRecord(material, texture);
+	dirty = true;
+}
+
+TextureHandle MaterialRegistry::GetTexture(unsigned int index) const {
+	TextureHandle texture = { records[index].textureArray, records[index].textureLayer };
+	return texture;
+}
+
+void MaterialRegistry::UseMaterials() {
+	if (records.empty()) {
+		return;
+	}
+
+	if (dirty) {
+		GLsizeiptr size = sizeof(MaterialData) * records.size();
+		if (materialBuffer == 0 || size > capacity) {
+			GpuMemory::DeleteBuffer(materialBuffer);
+			capacity = size > capacity * 2 ? size : capacity * 2;
+			materialBuffer = GpuMemory::CreateBuffer(GPU_MEMORY_DYNAMIC, "material records",
+				capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+		glNamedBufferSubData(materialBuffer, 0, size, records.data());
+		dirty = false;
+	}
+
+	GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_DATA_BINDING, materialBuffer);
+}
+
+void MaterialRegistry::ClearMaterials() {
+	GpuMemory::DeleteBuffer(materialBuffer);
+	capacity = 0;
+	records.clear();
+	dirty = false;
+}
+
+MaterialRegistry::~MaterialRegistry() {
+	ClearMaterials();
+}
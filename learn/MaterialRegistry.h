@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "Material.h"
+#include "TextureLibrary.h"
+
+// Every material the scene uses, kept in one shader storage buffer that draws
+// index into. The buffer is only rewritten when a record actually changed.
+class MaterialRegistry {
+public:
+	MaterialRegistry();
+
+	unsigned int AddMaterial(const Material& material, TextureHandle texture);
+	void SetMaterial(unsigned int index, const Material& material, TextureHandle texture);
+
+	void UseMaterials();
+	void ClearMaterials();
+
+	unsigned int GetMaterialCount() const { return static_cast<unsigned int>(records.size()); }
+	TextureHandle GetTexture(unsigned int index) const;
+
+	~MaterialRegistry();
+
+private:
+	// Mirrors MaterialData in the shaders (std430).
+	struct MaterialData {
+		GLfloat specularIntensity;
+		GLfloat shininess;
+		GLuint textureArray;
+		GLuint textureLayer;
+	};
+
+	GLuint materialBuffer;
+	GLsizeiptr capacity;
+	bool dirty;
+	std::vector<MaterialData> records;
+
+	static MaterialData MakeRecord(const Material& material, TextureHandle texture);
+};
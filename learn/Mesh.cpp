@@ -1,4 +1,7 @@
 #include "Mesh.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "CpuProfiler.h"
 
 Mesh::Mesh()
 {
@@ -8,59 +11,72 @@ Mesh::Mesh()
 	indexCount = 0;
 }
 
-void Mesh::CreateMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices)
+Mesh::Mesh(Mesh&& other)
 {
-	indexCount = numOfIndices;
-
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
+	VAO = other.VAO;
+	VBO = other.VBO;
+	EBO = other.EBO;
+	indexCount = other.indexCount;
+	other.VAO = 0;
+	other.VBO = 0;
+	other.EBO = 0;
+	other.indexCount = 0;
+}
 
-	glGenBuffers(1, &EBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
+Mesh& Mesh::operator=(Mesh&& other)
+{
+	if (this != &other) {
+		ClearMesh();
+		VAO = other.VAO;
+		VBO = other.VBO;
+		EBO = other.EBO;
+		indexCount = other.indexCount;
+		other.VAO = 0;
+		other.VBO = 0;
+		other.EBO = 0;
+		other.indexCount = 0;
+	}
+	return *this;
+}
 
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+void Mesh::CreateMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices)
+{
+	ClearMesh();
+	indexCount = numOfIndices;
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, 0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 5));
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	// Immutable storage created through DSA: nothing gets bound, so meshes can be
+	// built at any point without disturbing whatever the renderer has bound.
+	EBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "mesh indices", sizeof(indices[0]) * numOfIndices, indices, 0);
+	VBO = GpuMemory::CreateBuffer(GPU_MEMORY_GEOMETRY, "mesh vertices", sizeof(vertices[0]) * numOfVertices, vertices, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glCreateVertexArrays(1, &VAO);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(vertices[0]) * 8);
+	glVertexArrayElementBuffer(VAO, EBO);
 
-	glBindVertexArray(0);
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribFormat(VAO, 1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 3);
+	glVertexArrayAttribFormat(VAO, 2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 5);
+	for (GLuint attrib = 0; attrib < 3; attrib++) {
+		glVertexArrayAttribBinding(VAO, attrib, 0);
+		glEnableVertexArrayAttrib(VAO, attrib);
+	}
 }
 
 void Mesh::RenderMesh()
 {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	PROFILE_ZONE("Mesh::RenderMesh");
+	GLState::BindVertexArray(VAO);
 	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
 
 void Mesh::ClearMesh()
 {
-	if (EBO != 0)
-	{
-		glDeleteBuffers(1, &EBO);
-		EBO = 0;
-	}
-
-	if (VBO != 0)
-	{
-		glDeleteBuffers(1, &VBO);
-		VBO = 0;
-	}
+	GpuMemory::DeleteBuffer(EBO);
+	GpuMemory::DeleteBuffer(VBO);
 
 	if (VAO != 0)
 	{
+		GLState::ForgetVertexArray(VAO);
 		glDeleteVertexArrays(1, &VAO);
 		VAO = 0;
 	}
@@ -4,6 +4,12 @@ class Mesh
 public:
 	Mesh();
 
+	// Owns its GL buffers, so a copy would delete them a second time: move only.
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh(Mesh&& other);
+	Mesh& operator=(Mesh&& other);
+
 	void CreateMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
 	void RenderMesh();
 	void ClearMesh();
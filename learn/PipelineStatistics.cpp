@@ -0,0 +1,199 @@
+#include "PipelineStatistics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const GLenum COUNTER_TARGETS[PipelineStatistics::COUNTER_COUNT] = {
+	GL_VERTICES_SUBMITTED,
+	GL_PRIMITIVES_SUBMITTED,
+	GL_VERTEX_SHADER_INVOCATIONS,
+	GL_CLIPPING_INPUT_PRIMITIVES,
+	GL_CLIPPING_OUTPUT_PRIMITIVES,
+	GL_FRAGMENT_SHADER_INVOCATIONS,
+	GL_COMPUTE_SHADER_INVOCATIONS
+};
+
+static const char* COUNTER_NAMES[PipelineStatistics::COUNTER_COUNT] = {
+	"vertices",
+	"primitives",
+	"vertex invocations",
+	"clipping in",
+	"clipping out",
+	"fragment invocations",
+	"compute invocations"
+};
+
+PipelineStatistics::PipelineStatistics() {
+	created = false;
+	inFrame = false;
+	passOpen = false;
+	current = 0;
+	droppedFrames = 0;
+	for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+		memset(queryFrames[i].queries, 0, sizeof(queryFrames[i].queries));
+		queryFrames[i].count = 0;
+		queryFrames[i].pending = false;
+	}
+	recent.frames = 0;
+	run.frames = 0;
+}
+
+bool PipelineStatistics::CreatePipelineStatistics() {
+	// Drivers without the extension reject the target and leave this at 0.
+	GLint counterBits = 0;
+	glGetQueryiv(GL_VERTICES_SUBMITTED, GL_QUERY_COUNTER_BITS, &counterBits);
+	if (counterBits == 0) {
+		printf("Pipeline statistics queries aren't supported, pass statistics are off\n");
+		return false;
+	}
+
+	for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+		// Laid out pass by pass: query [pass * COUNTER_COUNT + c] is counter c.
+		for (unsigned int p = 0; p < MAX_PASSES; p++) {
+			for (unsigned int c = 0; c < COUNTER_COUNT; c++) {
+				glCreateQueries(COUNTER_TARGETS[c], 1, &queryFrames[i].queries[p * COUNTER_COUNT + c]);
+			}
+		}
+	}
+	created = true;
+	return true;
+}
+
+const char* PipelineStatistics::GetCounterName(Counter counter) {
+	return COUNTER_NAMES[counter];
+}
+
+unsigned int PipelineStatistics::InternName(const char* name) {
+	for (size_t i = 0; i < names.size(); i++) {
+		if (names[i] == name) {
+			return static_cast<unsigned int>(i);
+		}
+	}
+	names.push_back(name);
+	recent.sums.resize(names.size() * COUNTER_COUNT, 0);
+	run.sums.resize(names.size() * COUNTER_COUNT, 0);
+	return static_cast<unsigned int>(names.size() - 1);
+}
+
+void PipelineStatistics::Resolve(QueryFrame& frame) {
+	frame.pending = false;
+	if (frame.count > 0) {
+		// The last query ended is the last to complete.
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.count * COUNTER_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			droppedFrames++;
+			return;
+		}
+	}
+
+	for (unsigned int p = 0; p < frame.count; p++) {
+		unsigned int name = frame.passNames[p];
+		for (unsigned int c = 0; c < COUNTER_COUNT; c++) {
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(frame.queries[p * COUNTER_COUNT + c], GL_QUERY_RESULT, &result);
+			recent.sums[name * COUNTER_COUNT + c] += result;
+			run.sums[name * COUNTER_COUNT + c] += result;
+		}
+	}
+	recent.frames++;
+	run.frames++;
+}
+
+void PipelineStatistics::BeginFrame() {
+	if (!created) {
+		return;
+	}
+
+	current = (current + 1) % QUERY_FRAMES;
+	QueryFrame& frame = queryFrames[current];
+	// The oldest queries are reused this frame; collect them first.
+	if (frame.pending) {
+		Resolve(frame);
+	}
+	frame.count = 0;
+	inFrame = true;
+}
+
+void PipelineStatistics::BeginPass(const char* name) {
+	QueryFrame& frame = queryFrames[current];
+	if (!inFrame || passOpen || frame.count == MAX_PASSES) {
+		return;
+	}
+
+	unsigned int pass = frame.count++;
+	frame.passNames[pass] = InternName(name);
+	for (unsigned int c = 0; c < COUNTER_COUNT; c++) {
+		glBeginQuery(COUNTER_TARGETS[c], frame.queries[pass * COUNTER_COUNT + c]);
+	}
+	passOpen = true;
+}
+
+void PipelineStatistics::EndPass() {
+	if (!passOpen) {
+		return;
+	}
+	for (unsigned int c = 0; c < COUNTER_COUNT; c++) {
+		glEndQuery(COUNTER_TARGETS[c]);
+	}
+	passOpen = false;
+}
+
+void PipelineStatistics::EndFrame() {
+	if (!inFrame) {
+		return;
+	}
+	EndPass();
+	queryFrames[current].pending = true;
+	inFrame = false;
+}
+
+std::vector<PipelineStatistics::PassStatistics> PipelineStatistics::Average(const Totals& totals) const {
+	std::vector<PassStatistics> averages(names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		averages[i].name = names[i];
+		for (unsigned int c = 0; c < COUNTER_COUNT; c++) {
+			averages[i].counters[c] = totals.frames > 0
+				? static_cast<double>(totals.sums[i * COUNTER_COUNT + c]) / totals.frames : 0.0;
+		}
+	}
+	return averages;
+}
+
+std::vector<PipelineStatistics::PassStatistics> PipelineStatistics::TakeAverages() {
+	std::vector<PassStatistics> averages = Average(recent);
+	for (size_t i = 0; i < recent.sums.size(); i++) {
+		recent.sums[i] = 0;
+	}
+	recent.frames = 0;
+	return averages;
+}
+
+std::vector<PipelineStatistics::PassStatistics> PipelineStatistics::GetRunAverages() const {
+	return Average(run);
+}
+
+void PipelineStatistics::ClearPipelineStatistics() {
+	if (created) {
+		for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+			glDeleteQueries(MAX_PASSES * COUNTER_COUNT, queryFrames[i].queries);
+		}
+	}
+	for (unsigned int i = 0; i < QUERY_FRAMES; i++) {
+		memset(queryFrames[i].queries, 0, sizeof(queryFrames[i].queries));
+		queryFrames[i].count = 0;
+		queryFrames[i].pending = false;
+	}
+	created = false;
+	inFrame = false;
+	passOpen = false;
+	names.clear();
+	recent.sums.clear();
+	recent.frames = 0;
+	run.sums.clear();
+	run.frames = 0;
+}
+
+PipelineStatistics::~PipelineStatistics() {
+	ClearPipelineStatistics();
+}
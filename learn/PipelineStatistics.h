@@ -0,0 +1,91 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Per-pass pipeline statistics queries (ARB_pipeline_statistics_query, core
+// in GL 4.6): how many vertices and primitives each pass feeds the GPU, how
+// many survive clipping and how many vertex, fragment and compute shader
+// invocations they cost. Comparing fragment invocations to primitives tells a
+// fragment-bound pass from a vertex-bound one.
+//
+// Each counter is its own query target, so all of them run at once, but a
+// target can't be begun twice: passes must not nest. Results are read back
+// QUERY_FRAMES frames late like GpuProfiler's, and a frame that isn't in yet
+// is dropped rather than waited on.
+//
+// Render thread only.
+class PipelineStatistics {
+public:
+	enum Counter {
+		VERTICES_SUBMITTED,
+		PRIMITIVES_SUBMITTED,
+		VERTEX_SHADER_INVOCATIONS,
+		CLIPPING_INPUT_PRIMITIVES,
+		CLIPPING_OUTPUT_PRIMITIVES,
+		FRAGMENT_SHADER_INVOCATIONS,
+		COMPUTE_SHADER_INVOCATIONS,
+		COUNTER_COUNT
+	};
+
+	// Mean counts per frame over the frames averaged.
+	struct PassStatistics {
+		std::string name;
+		double counters[COUNTER_COUNT];
+	};
+
+	static const unsigned int MAX_PASSES = 32;
+	static const unsigned int QUERY_FRAMES = 3;
+
+	PipelineStatistics();
+
+	bool CreatePipelineStatistics();
+
+	void BeginFrame();
+	// Ignored while another pass is open or once the frame has MAX_PASSES.
+	void BeginPass(const char* name);
+	void EndPass();
+	void EndFrame();
+
+	// Averages since the previous TakeAverages() call, then starts over.
+	std::vector<PassStatistics> TakeAverages();
+	// Averages over every frame resolved since creation.
+	std::vector<PassStatistics> GetRunAverages() const;
+	unsigned int GetDroppedFrameCount() const { return droppedFrames; }
+
+	static const char* GetCounterName(Counter counter);
+
+	void ClearPipelineStatistics();
+
+	~PipelineStatistics();
+
+private:
+	struct QueryFrame {
+		GLuint queries[MAX_PASSES * COUNTER_COUNT];
+		unsigned int passNames[MAX_PASSES];
+		unsigned int count;
+		bool pending;
+	};
+
+	// Summed counters per pass name, COUNTER_COUNT per name.
+	struct Totals {
+		std::vector<GLuint64> sums;
+		unsigned int frames;
+	};
+
+	bool created;
+	bool inFrame;
+	bool passOpen;
+	unsigned int current;
+	unsigned int droppedFrames;
+	QueryFrame queryFrames[QUERY_FRAMES];
+
+	std::vector<std::string> names;
+	Totals recent;
+	Totals run;
+
+	unsigned int InternName(const char* name);
+	void Resolve(QueryFrame& frame);
+	std::vector<PassStatistics> Average(const Totals& totals) const;
+};
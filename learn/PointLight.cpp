@@ -1,4 +1,7 @@
 #include "PointLight.h"
+#include <float.h>
+
+#include "CommonValues.h"
 
 PointLight::PointLight() : Light() {
 	position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -39,6 +42,37 @@ void PointLight::UseLight(
 
 
 
+GLfloat PointLight::GetRange() const {
+	// Distance past which the attenuated light can no longer change an 8-bit
+	// channel: exponent*d^2 + linear*d + constant = 256 * brightest output.
+	// The specular term isn't scaled by diffuseIntensity but by the material,
+	// so the brightest output assumes the shiniest material allowed.
+	GLfloat brightest = glm::max(glm::max(color.x, color.y), color.z) * (ambientIntensity + diffuseIntensity + MAX_SPECULAR_INTENSITY);
+	GLfloat c = constant - 256.0f * brightest;
+	if (c >= 0.0f) {
+		return 0.0f;
+	}
+	if (exponent > 0.0f) {
+		return (-linear + sqrtf(linear * linear - 4.0f * exponent * c)) / (2.0f * exponent);
+	}
+	if (linear > 0.0f) {
+		return -c / linear;
+	}
+	return FLT_MAX;
+}
+
+void PointLight::GetLightData(LightData* data) const {
+	GLfloat range = GetRange();
+	// Unbounded lights still need a finite sphere for the culling tests.
+	data->positionRange = glm::vec4(position, range == FLT_MAX ? 1e30f : range);
+	data->colorAmbient = glm::vec4(color, ambientIntensity);
+	data->directionEdge = glm::vec4(0.0f, -1.0f, 0.0f, -1.0f);
+	data->attenuation = glm::vec4(constant, linear, exponent, diffuseIntensity);
+	data->type = LIGHT_DATA_POINT;
+	data->shadowIndex = NO_SHADOW;
+	data->pad[0] = data->pad[1] = 0;
+}
+
 PointLight::~PointLight() {
 
 }
\ No newline at end of file
@@ -17,7 +17,10 @@ public:
         GLuint positionLocation,
         GLuint constantLocation, GLuint linearLocation, GLuint exponentLocation
     );
-    
+
+    glm::vec3 GetPosition() const { return position; }
+    GLfloat GetRange() const;
+    void GetLightData(LightData* data) const;
 
     ~PointLight();
 protected:
@@ -0,0 +1,122 @@
+#include "RenderThread.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#include "CpuProfiler.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double ElapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+RenderThread::RenderThread() {
+	writeIndex = 0;
+	readIndex = 0;
+	queued = 0;
+	stopping = false;
+	window = nullptr;
+	stats = { 0, 0.0, 0.0 };
+}
+
+bool RenderThread::Start(GLFWwindow* targetWindow, std::function<void(FramePacket&)> callback) {
+	if (thread.joinable()) {
+		printf("Render thread already running\n");
+		return false;
+	}
+	if (!targetWindow || !callback) {
+		printf("Render thread needs a window and a render callback\n");
+		return false;
+	}
+
+	window = targetWindow;
+	renderFrame = callback;
+	writeIndex = 0;
+	readIndex = 0;
+	queued = 0;
+	stopping = false;
+
+	// A context can only be current on one thread at a time.
+	glfwMakeContextCurrent(nullptr);
+	thread = std::thread(&RenderThread::Run, this);
+	return true;
+}
+
+FramePacket& RenderThread::BeginPacket() {
+	Clock::time_point start = Clock::now();
+	std::unique_lock<std::mutex> lock(mutex);
+	packetFree.wait(lock, [this]() { return queued < PIPELINE_DEPTH; });
+	stats.simulationWaitMs += ElapsedMs(start);
+	return packets[writeIndex];
+}
+
+void RenderThread::SubmitPacket() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		writeIndex = (writeIndex + 1) % PIPELINE_DEPTH;
+		queued++;
+	}
+	packetReady.notify_one();
+}
+
+void RenderThread::Run() {
+	PROFILE_THREAD("render thread");
+	glfwMakeContextCurrent(window);
+
+	while (true) {
+		Clock::time_point start = Clock::now();
+		unsigned int index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			packetReady.wait(lock, [this]() { return queued > 0 || stopping; });
+			// Packets submitted before Stop() are still rendered.
+			if (queued == 0) {
+				break;
+			}
+			stats.renderWaitMs += ElapsedMs(start);
+			index = readIndex;
+		}
+
+		// The slot stays counted in queued until it has been replayed, so
+		// the simulation thread can't start overwriting it.
+		renderFrame(packets[index]);
+		glfwSwapBuffers(window);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			readIndex = (readIndex + 1) % PIPELINE_DEPTH;
+			queued--;
+			stats.frames++;
+		}
+		packetFree.notify_one();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::Stop() {
+	if (!thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	packetReady.notify_one();
+	thread.join();
+
+	glfwMakeContextCurrent(window);
+}
+
+RenderThread::PipelineStats RenderThread::TakeStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	PipelineStats taken = stats;
+	stats = { 0, 0.0, 0.0 };
+	return taken;
+}
+
+RenderThread::~RenderThread() {
+	Stop();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <GLFW/glfw3.h>
+
+#include "FramePacket.h"
+
+// Owns the GL context on a dedicated thread. The simulation thread fills a
+// FramePacket and submits it; the render thread replays it and swaps buffers,
+// so frame N+1 is simulated while frame N is being rendered.
+//
+// Packets live in a fixed set of slots and are reused, so their draw lists
+// keep their capacity from frame to frame.
+class RenderThread {
+public:
+	struct PipelineStats {
+		unsigned int frames;
+		double simulationWaitMs;  // simulation blocked on a free packet
+		double renderWaitMs;      // render thread idle waiting for a packet
+	};
+
+	RenderThread();
+
+	// Releases the context on the calling thread and makes it current on the
+	// render thread, which calls renderFrame for every submitted packet.
+	bool Start(GLFWwindow* window, std::function<void(FramePacket&)> renderFrame);
+
+	// Returns the packet to fill for the next frame, blocking while the
+	// render thread is still PIPELINE_DEPTH frames behind.
+	FramePacket& BeginPacket();
+	void SubmitPacket();
+
+	// Renders every packet already submitted, joins the render thread and
+	// makes the context current on the calling thread again so GL objects
+	// can be freed.
+	void Stop();
+
+	// Totals since the previous call.
+	PipelineStats TakeStats();
+
+	~RenderThread();
+
+	static const unsigned int PIPELINE_DEPTH = 2;
+
+private:
+	FramePacket packets[PIPELINE_DEPTH];
+	unsigned int writeIndex, readIndex;
+	unsigned int queued;
+	bool stopping;
+
+	std::mutex mutex;
+	std::condition_variable packetReady, packetFree;
+	std::thread thread;
+
+	GLFWwindow* window;
+	std::function<void(FramePacket&)> renderFrame;
+
+	PipelineStats stats;
+
+	void Run();
+};
@@ -0,0 +1,139 @@
+#include "RingBuffer.h"
+#include <stdio.h>
+#include "GLState.h"
+#include "GpuMemory.h"
+
+RingBuffer::RingBuffer() {
+	bufferID = 0;
+	mapped = nullptr;
+	sectionSize = 0;
+	sectionCount = 0;
+	section = 0;
+	head = 0;
+	requestedSize = 0;
+	overflowed = false;
+	stallCount = 0;
+	storageAlignment = 1;
+	for (unsigned int i = 0; i < MAX_SECTIONS; i++) {
+		fences[i] = nullptr;
+	}
+}
+
+bool RingBuffer::CreateRingBuffer(GLsizeiptr sectionBytes, unsigned int sections) {
+	ClearRingBuffer();
+
+	if (sections == 0 || sections > MAX_SECTIONS) {
+		printf("Ring buffer needs between 1 and %u sections, got %u\n", MAX_SECTIONS, sections);
+		return false;
+	}
+
+	sectionSize = sectionBytes;
+	sectionCount = sections;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	bufferID = GpuMemory::CreateBuffer(GPU_MEMORY_DYNAMIC, "frame ring", sectionSize * sectionCount, nullptr, flags);
+	mapped = static_cast<unsigned char*>(glMapNamedBufferRange(bufferID, 0, sectionSize * sectionCount, flags));
+	if (!mapped) {
+		printf("Failed to map ring buffer of %lld bytes\n", static_cast<long long>(sectionSize * sectionCount));
+		ClearRingBuffer();
+		return false;
+	}
+
+	// Queried once here rather than by every user binding a range as an SSBO.
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	storageAlignment = alignment > 0 ? alignment : 1;
+
+	section = 0;
+	head = 0;
+	return true;
+}
+
+void RingBuffer::WaitForSection(unsigned int index) {
+	if (!fences[index]) {
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fences[index], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		stallCount++;
+		do {
+			result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fences[index]);
+	fences[index] = nullptr;
+}
+
+void RingBuffer::BeginFrame() {
+	if (sectionCount == 0) {
+		return;
+	}
+	if (overflowed) {
+		Grow(requestedSize);
+	}
+	requestedSize = 0;
+	overflowed = false;
+
+	section = (section + 1) % sectionCount;
+	head = 0;
+	WaitForSection(section);
+}
+
+void* RingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset) {
+	requestedSize += size + alignment;
+
+	GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+	if (!mapped || start + size > sectionSize) {
+		overflowed = true;
+		return nullptr;
+	}
+
+	head = start + size;
+	*offset = section * sectionSize + start;
+	return mapped + *offset;
+}
+
+void RingBuffer::EndFrame() {
+	if (fences[section]) {
+		glDeleteSync(fences[section]);
+	}
+	fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool RingBuffer::Grow(GLsizeiptr sectionBytes) {
+	// Every section has been fenced by now, so draining them drains the GPU.
+	for (unsigned int i = 0; i < sectionCount; i++) {
+		WaitForSection(i);
+	}
+
+	GLsizeiptr newSize = sectionSize * 2 > sectionBytes ? sectionSize * 2 : sectionBytes;
+	printf("Growing ring buffer sections from %lld to %lld bytes\n",
+		static_cast<long long>(sectionSize), static_cast<long long>(newSize));
+	return CreateRingBuffer(newSize, sectionCount);
+}
+
+void RingBuffer::ClearRingBuffer() {
+	for (unsigned int i = 0; i < MAX_SECTIONS; i++) {
+		if (fences[i]) {
+			glDeleteSync(fences[i]);
+			fences[i] = nullptr;
+		}
+	}
+
+	if (bufferID != 0) {
+		glUnmapNamedBuffer(bufferID);
+		GpuMemory::DeleteBuffer(bufferID);
+	}
+
+	mapped = nullptr;
+	sectionSize = 0;
+	sectionCount = 0;
+	section = 0;
+	head = 0;
+}
+
+RingBuffer::~RingBuffer() {
+	ClearRingBuffer();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+
+// A persistently mapped, coherent buffer split into frame-sized sections. The
+// CPU writes the current frame's data straight into GPU-visible memory while
+// the GPU still reads the previous sections; a fence per section tells us when
+// a section may be reused.
+class RingBuffer {
+public:
+	RingBuffer();
+
+	bool CreateRingBuffer(GLsizeiptr sectionBytes, unsigned int sections);
+
+	void BeginFrame();
+	// Returns nullptr when the section is full. The request is remembered and
+	// the next BeginFrame() grows the ring so it fits from then on.
+	void* Allocate(GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset);
+	void EndFrame();
+
+	GLuint GetBufferID() const { return bufferID; }
+	GLsizeiptr GetSectionSize() const { return sectionSize; }
+	// GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, for Allocate()s bound as SSBOs.
+	GLsizeiptr GetStorageAlignment() const { return storageAlignment; }
+	unsigned int GetStallCount() const { return stallCount; }
+
+	void ClearRingBuffer();
+
+	~RingBuffer();
+
+	static const unsigned int MAX_SECTIONS = 4;
+
+private:
+	GLuint bufferID;
+	unsigned char* mapped;
+	GLsizeiptr sectionSize;
+	unsigned int sectionCount;
+	unsigned int section;
+	GLsizeiptr head;
+	GLsizeiptr requestedSize;
+	bool overflowed;
+	GLsync fences[MAX_SECTIONS];
+	unsigned int stallCount;
+	GLsizeiptr storageAlignment;
+
+	void WaitForSection(unsigned int index);
+	bool Grow(GLsizeiptr sectionBytes);
+};
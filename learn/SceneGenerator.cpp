@@ -0,0 +1,339 @@
+#include "SceneGenerator.h"
+
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Components.h"
+#include "CpuProfiler.h"
+
+static const float TWO_PI = 6.28318530718f;
+// Counts past this are typos rather than scaling tests.
+static const unsigned long MAX_SETTING_COUNT = 1000000;
+static const unsigned long MAX_TEXTURE_SIZE = 16384;
+
+// A whole decimal number no larger than max.
+static bool ParseCount(const std::string& key, const std::string& value, unsigned long max, unsigned int& number) {
+	char* end = nullptr;
+	errno = 0;
+	unsigned long parsed = strtoul(value.c_str(), &end, 10);
+	// strtoul skips leading spaces and negates a leading minus; neither is a count.
+	if (value.empty() || !isdigit(static_cast<unsigned char>(value[0])) || *end != '\0') {
+		printf("Scene generator setting %s=%s isn't a whole number\n", key.c_str(), value.c_str());
+		return false;
+	}
+	if (errno == ERANGE || parsed > max) {
+		printf("Scene generator setting %s=%s is out of range, the most is %lu\n", key.c_str(), value.c_str(), max);
+		return false;
+	}
+	number = static_cast<unsigned int>(parsed);
+	return true;
+}
+
+uint64_t SceneGenerator::Random::Next() {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+float SceneGenerator::Random::Uniform() {
+	return (Next() >> 40) * (1.0f / 16777216.0f);
+}
+
+float SceneGenerator::Random::Gaussian() {
+	// Box-Muller; 1 - Uniform() keeps the logarithm finite.
+	float u = 1.0f - Uniform();
+	float v = Uniform();
+	return sqrtf(-2.0f * logf(u)) * cosf(TWO_PI * v);
+}
+
+SceneGenerator::SceneGenerator() {
+	random.state = 0;
+	stats = Stats();
+}
+
+SceneGenerator::Config SceneGenerator::DefaultConfig() {
+	Config config;
+	config.seed = 1;
+	config.meshes = 10;
+	config.instances = 0;
+	config.materials = 4;
+	config.textures = 2;
+	config.textureSize = 256;
+	config.lights = 16;
+	config.animated = 0;
+	config.distribution = DISTRIBUTION_UNIFORM;
+	config.clusters = 8;
+	config.extent = 10.0f;
+	return config;
+}
+
+// Settings that are plain counts, parsed alike.
+static unsigned int SceneGenerator::Config::* FindCountSetting(const std::string& key) {
+	static const struct {
+		const char* key;
+		unsigned int SceneGenerator::Config::* field;
+	} countSettings[] = {
+		{ "meshes", &SceneGenerator::Config::meshes },
+		{ "instances", &SceneGenerator::Config::instances },
+		{ "materials", &SceneGenerator::Config::materials },
+		{ "textures", &SceneGenerator::Config::textures },
+		{ "lights", &SceneGenerator::Config::lights },
+		{ "animated", &SceneGenerator::Config::animated },
+		{ "clusters", &SceneGenerator::Config::clusters },
+	};
+	for (const auto& setting : countSettings) {
+		if (key == setting.key) {
+			return setting.field;
+		}
+	}
+	return nullptr;
+}
+
+bool SceneGenerator::ParseConfig(const char* text, Config& config) {
+	std::string remaining = text;
+	while (!remaining.empty()) {
+		size_t comma = remaining.find(',');
+		std::string item = remaining.substr(0, comma);
+		remaining = comma == std::string::npos ? "" : remaining.substr(comma + 1);
+
+		size_t equals = item.find('=');
+		if (equals == std::string::npos) {
+			printf("Scene generator setting \"%s\" isn't key=value\n", item.c_str());
+			return false;
+		}
+		std::string key = item.substr(0, equals);
+		std::string value = item.substr(equals + 1);
+		unsigned int number = 0;
+
+		if (key == "seed") {
+			if (!ParseCount(key, value, 0xFFFFFFFFul, number)) {
+				return false;
+			}
+			config.seed = number;
+		}
+		else if (key == "extent") {
+			char* end = nullptr;
+			float extent = strtof(value.c_str(), &end);
+			if (value.empty() || *end != '\0' || !(extent > 0.0f) || extent > 1.0e6f) {
+				printf("Scene generator setting extent=%s isn't a positive distance\n", value.c_str());
+				return false;
+			}
+			config.extent = extent;
+		}
+		else if (key == "textureSize") {
+			if (!ParseCount(key, value, MAX_TEXTURE_SIZE, number)) {
+				return false;
+			}
+			config.textureSize = static_cast<int>(number);
+		}
+		else if (unsigned int SceneGenerator::Config::* count = FindCountSetting(key)) {
+			if (!ParseCount(key, value, MAX_SETTING_COUNT, number)) {
+				return false;
+			}
+			config.*count = number;
+		}
+		else if (key == "distribution") {
+			if (value == "uniform") {
+				config.distribution = DISTRIBUTION_UNIFORM;
+			}
+			else if (value == "clustered") {
+				config.distribution = DISTRIBUTION_CLUSTERED;
+			}
+			else if (value == "grid") {
+				config.distribution = DISTRIBUTION_GRID;
+			}
+			else {
+				printf("Unknown scene distribution \"%s\"\n", value.c_str());
+				return false;
+			}
+		}
+		else {
+			printf("Unknown scene generator setting \"%s\"\n", key.c_str());
+			return false;
+		}
+	}
+
+	// Every instance needs a mesh and a material, every material a texture.
+	config.meshes = config.meshes > 0 ? config.meshes : 1;
+	config.materials = config.materials > 0 ? config.materials : 1;
+	config.textures = config.textures > 0 ? config.textures : 1;
+	config.textureSize = config.textureSize > 0 ? config.textureSize : 1;
+	config.clusters = config.clusters > 0 ? config.clusters : 1;
+	// Tiled culling takes no more than MAX_LIGHTS; past that they'd only be
+	// generated to be dropped.
+	if (config.lights > static_cast<unsigned int>(MAX_LIGHTS)) {
+		printf("%u lights exceed the culling limit of %d, generating %d\n", config.lights, MAX_LIGHTS, MAX_LIGHTS);
+		config.lights = MAX_LIGHTS;
+	}
+	return true;
+}
+
+void SceneGenerator::QueueTextures(const Config& config, TextureLibrary& textureLibrary) {
+	// All the same size, so they share one texture array.
+	textures.resize(config.textures);
+	for (unsigned int i = 0; i < config.textures; i++) {
+		textureLibrary.AddGeneratedTexture(config.textureSize, config.textureSize, config.seed * 1000 + i, &textures[i]);
+	}
+}
+
+glm::vec3 SceneGenerator::PlacePoint(const Config& config, unsigned int index, unsigned int count,
+	const std::vector<glm::vec2>& clusterCentres) {
+	float extent = config.extent;
+	switch (config.distribution) {
+	case DISTRIBUTION_CLUSTERED: {
+		const glm::vec2& centre = clusterCentres[static_cast<size_t>(random.Next() % clusterCentres.size())];
+		float spread = extent * 0.1f;
+		float x = glm::clamp(centre.x + random.Gaussian() * spread, -extent, extent);
+		float z = glm::clamp(centre.y + random.Gaussian() * spread, -extent, extent);
+		return glm::vec3(x, 0.0f, z);
+	}
+	case DISTRIBUTION_GRID: {
+		unsigned int side = static_cast<unsigned int>(ceil(sqrt(static_cast<double>(count))));
+		side = side > 0 ? side : 1;
+		float spacing = 2.0f * extent / side;
+		return glm::vec3(-extent + (index % side + 0.5f) * spacing, 0.0f, -extent + (index / side + 0.5f) * spacing);
+	}
+	default:
+		return glm::vec3((random.Uniform() * 2.0f - 1.0f) * extent, 0.0f, (random.Uniform() * 2.0f - 1.0f) * extent);
+	}
+}
+
+void SceneGenerator::Generate(const Config& config, DrawBatch& batch, MaterialRegistry& materialRegistry,
+	SceneGraph& sceneGraph, EntityWorld& entityWorld) {
+	PROFILE_ZONE("SceneGenerator::Generate");
+	if (textures.empty()) {
+		printf("Scene generator textures weren't queued, nothing generated\n");
+		return;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	random.state = config.seed;
+
+	std::vector<glm::vec2> clusterCentres(config.clusters);
+	for (size_t i = 0; i < clusterCentres.size(); i++) {
+		clusterCentres[i] = glm::vec2((random.Uniform() * 1.6f - 0.8f) * config.extent, (random.Uniform() * 1.6f - 0.8f) * config.extent);
+	}
+
+	// Meshes: the default pyramid with every corner jittered, normals
+	// averaged the same way calcAverageNormals does.
+	const unsigned int PYRAMID_INDICES[12] = { 0, 3, 1, 1, 3, 2, 2, 3, 0, 0, 1, 2 };
+	const glm::vec3 PYRAMID_CORNERS[4] = {
+		glm::vec3(-1.0f, -1.0f, -0.6f), glm::vec3(0.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, -0.6f), glm::vec3(0.0f, 1.0f, 0.0f)
+	};
+	const float PYRAMID_UVS[8] = { 0.0f, 0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 0.5f, 1.0f };
+	std::vector<unsigned int> meshes(config.meshes);
+	for (unsigned int m = 0; m < config.meshes; m++) {
+		glm::vec3 corners[4];
+		glm::vec3 normals[4];
+		for (int c = 0; c < 4; c++) {
+			glm::vec3 jitter(random.Uniform() - 0.5f, random.Uniform() - 0.5f, random.Uniform() - 0.5f);
+			corners[c] = PYRAMID_CORNERS[c] + jitter * 0.6f;
+			normals[c] = glm::vec3(0.0f);
+		}
+		for (int face = 0; face < 4; face++) {
+			const unsigned int* tri = PYRAMID_INDICES + face * 3;
+			glm::vec3 normal = glm::normalize(glm::cross(corners[tri[1]] - corners[tri[0]], corners[tri[2]] - corners[tri[0]]));
+			for (int v = 0; v < 3; v++) {
+				normals[tri[v]] += normal;
+			}
+		}
+
+		GLfloat vertices[32];
+		for (int c = 0; c < 4; c++) {
+			glm::vec3 normal = glm::normalize(normals[c]);
+			GLfloat vertex[8] = { corners[c].x, corners[c].y, corners[c].z, PYRAMID_UVS[c * 2], PYRAMID_UVS[c * 2 + 1], normal.x, normal.y, normal.z };
+			for (int f = 0; f < 8; f++) {
+				vertices[c * 8 + f] = vertex[f];
+			}
+		}
+		unsigned int indices[12];
+		for (int i = 0; i < 12; i++) {
+			indices[i] = PYRAMID_INDICES[i];
+		}
+		meshes[m] = batch.AddMesh(vertices, indices, 32, 12);
+	}
+
+	const GLfloat SHININESS[5] = { 4.0f, 8.0f, 16.0f, 32.0f, 64.0f };
+	std::vector<unsigned int> materials(config.materials);
+	for (unsigned int i = 0; i < config.materials; i++) {
+		Material material(0.2f + random.Uniform() * 3.8f, SHININESS[random.Next() % 5]);
+		materials[i] = materialRegistry.AddMaterial(material, textures[i % textures.size()]);
+	}
+
+	// Instances are sized so they cover about a quarter of the area whatever
+	// their count, and stand on the floor plane at y = -1.
+	unsigned int instanceCount = config.instances > 0 ? config.instances : config.meshes;
+	float scale = glm::clamp(0.5f * config.extent / sqrtf(static_cast<float>(instanceCount)), 0.02f, 1.0f);
+	unsigned int animatedCount = config.animated < instanceCount ? config.animated : instanceCount;
+	animatedNodes.clear();
+	animatedAxes.clear();
+	for (unsigned int i = 0; i < instanceCount; i++) {
+		float size = scale * (0.6f + random.Uniform() * 0.8f);
+		glm::vec3 position = PlacePoint(config, i, instanceCount, clusterCentres);
+		position.y = -1.0f + size;
+
+		TransformComponent transform = { glm::mat4(1.0f), sceneGraph.AddNode() };
+		sceneGraph.SetPosition(transform.node, position);
+		sceneGraph.SetRotation(transform.node, glm::vec3(0.0f, 1.0f, 0.0f), random.Uniform() * TWO_PI);
+		sceneGraph.SetScale(transform.node, glm::vec3(size));
+		if (i < animatedCount) {
+			animatedNodes.push_back(transform.node);
+			animatedAxes.push_back(glm::vec3(random.Uniform() - 0.5f, 1.0f, random.Uniform() - 0.5f));
+		}
+
+		MeshComponent mesh = { meshes[static_cast<size_t>(random.Next() % meshes.size())] };
+		MaterialComponent material = { materials[static_cast<size_t>(random.Next() % materials.size())] };
+		Entity entity = entityWorld.CreateEntity();
+		entityWorld.AddComponent(entity, transform);
+		entityWorld.AddComponent(entity, mesh);
+		entityWorld.AddComponent(entity, material);
+	}
+
+	for (unsigned int i = 0; i < config.lights; i++) {
+		glm::vec3 position = PlacePoint(config, i, config.lights, clusterCentres);
+		position.y = -0.8f + random.Uniform() * 1.5f;
+		float red = random.Uniform();
+		float green = random.Uniform();
+		float blue = random.Uniform();
+
+		PointLightComponent light;
+		light.light = PointLight(
+			red, green, blue,
+			+0.0f, +0.8f,
+			position.x, position.y, position.z,
+			+1.0f, +2.0f, +20.0f
+		);
+		entityWorld.AddComponent(entityWorld.CreateEntity(), light);
+	}
+
+	stats.meshes = config.meshes;
+	stats.instances = instanceCount;
+	stats.materials = config.materials;
+	stats.textures = config.textures;
+	stats.lights = config.lights;
+	stats.animated = animatedCount;
+	stats.generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SceneGenerator::Animate(SceneGraph& sceneGraph, float time) {
+	for (size_t i = 0; i < animatedNodes.size(); i++) {
+		// Offset per node so they don't all face the same way.
+		sceneGraph.SetRotation(animatedNodes[i], animatedAxes[i], time + static_cast<float>(i) * 0.37f);
+	}
+}
+
+void SceneGenerator::ClearSceneGenerator() {
+	textures.clear();
+	animatedNodes.clear();
+	animatedAxes.clear();
+	stats = Stats();
+}
+
+SceneGenerator::~SceneGenerator() {
+	ClearSceneGenerator();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "DrawBatch.h"
+#include "EntityWorld.h"
+#include "MaterialRegistry.h"
+#include "SceneGraph.h"
+#include "TextureLibrary.h"
+
+enum SpatialDistribution {
+	DISTRIBUTION_UNIFORM,
+	// Gaussian blobs around randomly placed centres.
+	DISTRIBUTION_CLUSTERED,
+	// Evenly spaced, the least overlap for a given count.
+	DISTRIBUTION_GRID
+};
+
+// Builds synthetic scenes of a chosen size for scaling tests: distinct meshes
+// (jittered pyramids), instances of them, materials, generated textures and
+// point lights, all placed by one distribution over a square area. The same
+// config and seed always give the same scene, whatever the compiler's
+// standard library, so measurements at different sizes can be plotted
+// against each other.
+//
+// Usage: QueueTextures() before TextureLibrary::Build(), then Generate().
+class SceneGenerator {
+public:
+	struct Config {
+		unsigned int seed;
+		unsigned int meshes;
+		// Drawn entities, each using one of the meshes; 0 means one per mesh.
+		unsigned int instances;
+		unsigned int materials;
+		unsigned int textures;
+		int textureSize;
+		unsigned int lights;
+		// Instances whose nodes spin every frame, to load the scene graph.
+		unsigned int animated;
+		SpatialDistribution distribution;
+		unsigned int clusters;
+		// Half the side of the square area, centred on the origin.
+		float extent;
+	};
+
+	struct Stats {
+		unsigned int meshes;
+		unsigned int instances;
+		unsigned int materials;
+		unsigned int textures;
+		unsigned int lights;
+		unsigned int animated;
+		double generateMs;
+	};
+
+	SceneGenerator();
+
+	// Parses "key=value,key=value,...", keys named as in Config (distribution
+	// takes uniform, clustered or grid). Unset keys keep their defaults.
+	// Counts must be whole numbers up to a million; lights are capped at
+	// MAX_LIGHTS.
+	static bool ParseConfig(const char* text, Config& config);
+	static Config DefaultConfig();
+
+	void QueueTextures(const Config& config, TextureLibrary& textureLibrary);
+	void Generate(const Config& config, DrawBatch& batch, MaterialRegistry& materialRegistry,
+		SceneGraph& sceneGraph, EntityWorld& entityWorld);
+
+	// Spins the animated instances to where they are at time seconds.
+	void Animate(SceneGraph& sceneGraph, float time);
+
+	Stats GetStats() const { return stats; }
+
+	void ClearSceneGenerator();
+
+	~SceneGenerator();
+
+private:
+	// Dependency-free PRNG (splitmix64) so sequences don't depend on the
+	// standard library's distributions.
+	struct Random {
+		uint64_t state;
+		uint64_t Next();
+		float Uniform();
+		float Gaussian();
+	};
+
+	Random random;
+	std::vector<TextureHandle> textures;
+	std::vector<SceneNode> animatedNodes;
+	std::vector<glm::vec3> animatedAxes;
+	Stats stats;
+
+	glm::vec3 PlacePoint(const Config& config, unsigned int index, unsigned int count,
+		const std::vector<glm::vec2>& clusterCentres);
+};
@@ -0,0 +1,208 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+#include "CpuProfiler.h"
+
+SceneGraph::SceneGraph() {
+	levelsDirty = false;
+	anyDirty = false;
+	lastUpdateCount = 0;
+}
+
+SceneNode SceneGraph::AddNode(SceneNode parent) {
+	SceneNode node = static_cast<SceneNode>(parents.size());
+	if (parent != NO_PARENT && parent >= node) {
+		printf("Scene node parent %u doesn't exist, adding node %u as a root\n", parent, node);
+		parent = NO_PARENT;
+	}
+
+	positionX.push_back(0.0f);
+	positionY.push_back(0.0f);
+	positionZ.push_back(0.0f);
+	rotationX.push_back(0.0f);
+	rotationY.push_back(0.0f);
+	rotationZ.push_back(0.0f);
+	rotationW.push_back(1.0f);
+	scaleX.push_back(1.0f);
+	scaleY.push_back(1.0f);
+	scaleZ.push_back(1.0f);
+
+	parents.push_back(parent);
+	depths.push_back(parent == NO_PARENT ? 0 : depths[parent] + 1);
+	localDirty.push_back(1);
+	worldDirty.push_back(1);
+	locals.push_back(glm::mat4(1.0f));
+	worlds.push_back(glm::mat4(1.0f));
+
+	levelsDirty = true;
+	anyDirty = true;
+	return node;
+}
+
+void SceneGraph::SetPosition(SceneNode node, const glm::vec3& position) {
+	positionX[node] = position.x;
+	positionY[node] = position.y;
+	positionZ[node] = position.z;
+	localDirty[node] = 1;
+	anyDirty = true;
+}
+
+void SceneGraph::SetRotation(SceneNode node, const glm::vec3& axis, float angle) {
+	glm::vec3 unit = glm::normalize(axis);
+	float s = sinf(angle * 0.5f);
+	rotationX[node] = unit.x * s;
+	rotationY[node] = unit.y * s;
+	rotationZ[node] = unit.z * s;
+	rotationW[node] = cosf(angle * 0.5f);
+	localDirty[node] = 1;
+	anyDirty = true;
+}
+
+void SceneGraph::SetScale(SceneNode node, const glm::vec3& scale) {
+	scaleX[node] = scale.x;
+	scaleY[node] = scale.y;
+	scaleZ[node] = scale.z;
+	localDirty[node] = 1;
+	anyDirty = true;
+}
+
+glm::vec3 SceneGraph::GetPosition(SceneNode node) const {
+	return glm::vec3(positionX[node], positionY[node], positionZ[node]);
+}
+
+void SceneGraph::BuildLevels() {
+	// Counting sort by depth; nodes keep index order inside a level.
+	unsigned int levelCount = 0;
+	for (size_t i = 0; i < depths.size(); i++) {
+		levelCount = depths[i] + 1 > levelCount ? depths[i] + 1 : levelCount;
+	}
+
+	levelStart.assign(levelCount + 1, 0);
+	for (size_t i = 0; i < depths.size(); i++) {
+		levelStart[depths[i] + 1]++;
+	}
+	for (unsigned int d = 0; d < levelCount; d++) {
+		levelStart[d + 1] += levelStart[d];
+	}
+
+	std::vector<size_t> next(levelStart.begin(), levelStart.end() - 1);
+	levelNodes.resize(depths.size());
+	for (size_t i = 0; i < depths.size(); i++) {
+		levelNodes[next[depths[i]]++] = static_cast<SceneNode>(i);
+	}
+	levelsDirty = false;
+}
+
+void SceneGraph::Update(JobSystem* jobs) {
+	PROFILE_ZONE("SceneGraph::Update");
+	if (!anyDirty) {
+		// Nothing moved: only the previous update's flags need resetting.
+		if (lastUpdateCount > 0) {
+			std::fill(worldDirty.begin(), worldDirty.end(), 0);
+		}
+		lastUpdateCount = 0;
+		return;
+	}
+	if (levelsDirty) {
+		BuildLevels();
+	}
+
+	// A world matrix is stale if its local transform changed or its parent's
+	// world did. Parents come first, so one pass settles the whole tree.
+	unsigned int updated = 0;
+	for (size_t i = 0; i < parents.size(); i++) {
+		unsigned char dirty = localDirty[i];
+		if (parents[i] != NO_PARENT) {
+			dirty |= worldDirty[parents[i]];
+		}
+		worldDirty[i] = dirty;
+		updated += dirty;
+	}
+
+	LocalTransformArrays arrays = {
+		positionX.data(), positionY.data(), positionZ.data(),
+		rotationX.data(), rotationY.data(), rotationZ.data(), rotationW.data(),
+		scaleX.data(), scaleY.data(), scaleZ.data()
+	};
+	auto computeLocals = [&](size_t begin, size_t end) {
+		// Runs of dirty nodes go through the four-wide path in one call.
+		size_t i = begin;
+		while (i < end) {
+			if (!localDirty[i]) {
+				i++;
+				continue;
+			}
+			size_t run = i;
+			while (run < end && localDirty[run]) {
+				run++;
+			}
+			ComputeLocalMatrices(arrays, i, run, locals.data());
+			for (size_t n = i; n < run; n++) {
+				localDirty[n] = 0;
+			}
+			i = run;
+		}
+	};
+	if (jobs) {
+		jobs->ParallelFor(parents.size(), NODES_PER_JOB, computeLocals);
+	}
+	else {
+		computeLocals(0, parents.size());
+	}
+
+	for (size_t level = 0; level + 1 < levelStart.size(); level++) {
+		size_t count = levelStart[level + 1] - levelStart[level];
+		auto updateLevel = [&](size_t begin, size_t end) {
+			UpdateLevel(level, begin, end);
+		};
+		if (jobs) {
+			jobs->ParallelFor(count, NODES_PER_JOB, updateLevel);
+		}
+		else {
+			updateLevel(0, count);
+		}
+	}
+
+	anyDirty = false;
+	lastUpdateCount = updated;
+}
+
+void SceneGraph::UpdateLevel(size_t level, size_t begin, size_t end) {
+	const SceneNode* nodes = levelNodes.data() + levelStart[level];
+	for (size_t i = begin; i < end; i++) {
+		SceneNode node = nodes[i];
+		if (!worldDirty[node]) {
+			continue;
+		}
+		if (parents[node] == NO_PARENT) {
+			worlds[node] = locals[node];
+		}
+		else {
+			MultiplyMatrix(worlds[parents[node]], locals[node], worlds[node]);
+		}
+	}
+}
+
+void SceneGraph::ClearSceneGraph() {
+	positionX.clear(); positionY.clear(); positionZ.clear();
+	rotationX.clear(); rotationY.clear(); rotationZ.clear(); rotationW.clear();
+	scaleX.clear(); scaleY.clear(); scaleZ.clear();
+	parents.clear();
+	depths.clear();
+	localDirty.clear();
+	worldDirty.clear();
+	locals.clear();
+	worlds.clear();
+	levelNodes.clear();
+	levelStart.clear();
+	levelsDirty = false;
+	anyDirty = false;
+	lastUpdateCount = 0;
+}
+
+SceneGraph::~SceneGraph() {
+	ClearSceneGraph();
+}
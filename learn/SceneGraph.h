@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "TransformMath.h"
+
+typedef unsigned int SceneNode;
+const SceneNode NO_PARENT = 0xFFFFFFFFu;
+
+// Transform hierarchy stored as flat arrays, one per component. A node's
+// parent always has a lower index, so one front-to-back pass sees parents
+// before children.
+//
+// Setting a node's local transform marks it dirty; Update() recomputes world
+// matrices only for dirty nodes and everything below them. Local matrices are
+// built four nodes at a time from the TRS arrays. World matrices are then
+// resolved one depth level at a time, since nodes on the same level don't
+// depend on each other and can be split across the job system's threads.
+class SceneGraph {
+public:
+	SceneGraph();
+
+	// parent must already exist (or be NO_PARENT).
+	SceneNode AddNode(SceneNode parent = NO_PARENT);
+
+	void SetPosition(SceneNode node, const glm::vec3& position);
+	// Rotation by angle radians around axis (needn't be normalised).
+	void SetRotation(SceneNode node, const glm::vec3& axis, float angle);
+	void SetScale(SceneNode node, const glm::vec3& scale);
+
+	glm::vec3 GetPosition(SceneNode node) const;
+	SceneNode GetParent(SceneNode node) const { return parents[node]; }
+
+	// jobs may be null to update on the calling thread.
+	void Update(JobSystem* jobs);
+
+	const glm::mat4& GetWorldMatrix(SceneNode node) const { return worlds[node]; }
+	const glm::mat4* GetWorldMatrices() const { return worlds.data(); }
+	// Whether the last Update() changed this node's world matrix.
+	bool WasUpdated(SceneNode node) const { return worldDirty[node] != 0; }
+
+	unsigned int GetNodeCount() const { return static_cast<unsigned int>(parents.size()); }
+	unsigned int GetLastUpdateCount() const { return lastUpdateCount; }
+
+	void ClearSceneGraph();
+
+	~SceneGraph();
+
+private:
+	// Nodes per job. Local matrices are cheap, so jobs need to be fairly
+	// large to be worth handing out.
+	static const size_t NODES_PER_JOB = 2048;
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	std::vector<SceneNode> parents;
+	std::vector<unsigned int> depths;
+	std::vector<unsigned char> localDirty;
+	std::vector<unsigned char> worldDirty;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+
+	// Node indices grouped by depth: level d is
+	// levelNodes[levelStart[d]] .. levelNodes[levelStart[d + 1] - 1].
+	std::vector<SceneNode> levelNodes;
+	std::vector<size_t> levelStart;
+	bool levelsDirty;
+
+	bool anyDirty;
+	unsigned int lastUpdateCount;
+
+	void BuildLevels();
+	void UpdateLevel(size_t level, size_t begin, size_t end);
+};
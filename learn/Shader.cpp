@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include "CpuProfiler.h"
 
 
 
@@ -25,6 +26,11 @@ void Shader::CreateFromFiles(const char* vertexLocation, const char* fragmentLoc
     CompileShader(vertexCode, fragmentCode);
 }
 
+void Shader::CreateComputeFromFile(const char* computeLocation) {
+    std::string computeString = ReadFile(computeLocation);
+    CompileComputeShader(computeString.c_str());
+}
+
 std::string Shader::ReadFile(const char* fileLocation) {
     std::string content;
     std::ifstream fileStream(fileLocation, std::ios::in);
@@ -34,9 +40,18 @@ std::string Shader::ReadFile(const char* fileLocation) {
         return "";
     }
 
+    // GLSL has no includes of its own: a line reading #include "file" is
+    // replaced by that file, so shaders can share code.
+    const std::string includeDirective = "#include \"";
     std::string line = "";
     while (!fileStream.eof()) {
         std::getline(fileStream, line);
+        if (line.compare(0, includeDirective.size(), includeDirective) == 0) {
+            size_t nameEnd = line.find('"', includeDirective.size());
+            std::string includeName = line.substr(includeDirective.size(), nameEnd - includeDirective.size());
+            content.append(ReadFile(includeName.c_str()));
+            continue;
+        }
         content.append(line + "\n");
     }
 
@@ -48,14 +63,11 @@ void Shader::CompileShader(const char* vertexCode, const char* fragmentCode) {
     GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
     GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-    std::string vertexShaderCode = ReadFile("vertexShader.glsl");
-    std::string fragmentShaderCode = ReadFile("fragmentShader.glsl");
-
-    std::cout << "Vertex shader length: " << vertexShaderCode.length() << std::endl;
-    std::cout << "Fragment shader length: " << fragmentShaderCode.length() << std::endl;
+    std::cout << "Vertex shader length: " << strlen(vertexCode) << std::endl;
+    std::cout << "Fragment shader length: " << strlen(fragmentCode) << std::endl;
 
-    const GLchar* vertexSource = vertexShaderCode.c_str();
-    const GLchar* fragmentSource = fragmentShaderCode.c_str();
+    const GLchar* vertexSource = vertexCode;
+    const GLchar* fragmentSource = fragmentCode;
 
 
     glShaderSource(vertexShaderID, 1, &vertexSource, 0);
@@ -75,7 +87,7 @@ void Shader::CompileShader(const char* vertexCode, const char* fragmentCode) {
     if (!logProgramError(programID))
         return;
 
-    glUseProgram(programID);
+    GLState::UseProgram(programID);
     shaderID = programID;
     uniformModel = glGetUniformLocation(programID, "model");
     uniformProjection = glGetUniformLocation(programID, "projection");
@@ -140,6 +152,27 @@ void Shader::CompileShader(const char* vertexCode, const char* fragmentCode) {
     }
 }
 
+void Shader::CompileComputeShader(const char* computeCode) {
+    GLuint computeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(computeShaderID, 1, &computeCode, 0);
+    glCompileShader(computeShaderID);
+
+    if (!logShaderError(computeShaderID)) {
+        glDeleteShader(computeShaderID);
+        return;
+    }
+
+    GLuint programID = glCreateProgram();
+    glAttachShader(programID, computeShaderID);
+    glLinkProgram(programID);
+    glDeleteShader(computeShaderID);
+
+    if (!logProgramError(programID))
+        return;
+
+    shaderID = programID;
+}
+
 GLuint Shader::GetProjectionLocation() {
     return uniformProjection;
 }
@@ -176,6 +209,10 @@ GLuint Shader::GetEyePositionLocation() {
     return uniformEyePosition;
 }
 
+GLuint Shader::GetUniformLocation(const char* name) {
+    return glGetUniformLocation(shaderID, name);
+}
+
 GLuint Shader::GetAmbientIntensityLocation() {
     return uniformDirectionalLight.uniformAmbientIntensity;
 }
@@ -190,6 +227,7 @@ void Shader::SetDirectionalLight(DirectionalLight* dLight) {
 }
 
 void Shader::SetPointLights(PointLight* pLight, unsigned int lightCount) {
+    PROFILE_ZONE("Shader::SetPointLights");
     if (lightCount > MAX_POINT_LIGHTS) lightCount = MAX_POINT_LIGHTS;
 
     glUniform1i(uniformPointLightCount, lightCount);
@@ -210,6 +248,7 @@ void Shader::SetPointLights(PointLight* pLight, unsigned int lightCount) {
 }
 
 void Shader::SetSpotLights(SpotLight* sLight, unsigned int lightCount) {
+    PROFILE_ZONE("Shader::SetSpotLights");
     if (lightCount > MAX_SPOT_LIGHTS) lightCount = MAX_SPOT_LIGHTS;
 
     glUniform1i(uniformSpotLightCount, lightCount);
@@ -233,11 +272,12 @@ void Shader::SetSpotLights(SpotLight* sLight, unsigned int lightCount) {
 
 
 void Shader::UseShader() {
-    glUseProgram(shaderID);
+    GLState::UseProgram(shaderID);
 }
 
 void Shader::ClearShader() {
     if (shaderID != 0) {
+        GLState::ForgetProgram(shaderID);
         glDeleteProgram(shaderID);
         shaderID = 0;
     }
@@ -1,3 +1,4 @@
+#pragma once
 #include <stdio.h>
 #include <string>
 #include <iostream>
@@ -9,6 +10,7 @@
 
 
 #include "CommonValues.h"
+#include "GLState.h"
 
 #include "DirectionalLight.h"
 #include "PointLight.h"
@@ -21,7 +23,9 @@ public:
 
 	void CreateFromString(const char* vertexCode, const char* fragmentCode);
 	void CreateFromFiles(const char* vertexLocation, const char* fragmentLocation);
+	void CreateComputeFromFile(const char* computeLocation);
 
+	// Expands #include "file" lines, so shared GLSL lives in one file.
 	std::string ReadFile(const char* fileLocation);
 
 	GLuint GetProjectionLocation();
@@ -34,6 +38,8 @@ public:
 	GLuint GetSpecularIntensityLocation();
 	GLuint GetShininessLocation();
 	GLuint GetEyePositionLocation();
+	GLuint GetUniformLocation(const char* name);
+	GLuint GetShaderID() const { return shaderID; }
 
 	void SetDirectionalLight(DirectionalLight* dLight);
 	void SetPointLights(PointLight* pLight, unsigned int lightCount);
@@ -89,6 +95,7 @@ private:
 	} uniformSpotLight[MAX_SPOT_LIGHTS];
 
 	void CompileShader(const char* vertexCode, const char* fragmentCode);
+	void CompileComputeShader(const char* computeCode);
 	void AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
 	static bool logStatus(GLuint objectID, PFNGLGETSHADERIVPROC objectPropertyGetterFunc, PFNGLGETSHADERINFOLOGPROC getInfoLogFunc, GLenum statusType);
 	bool logShaderError(GLuint shaderID);
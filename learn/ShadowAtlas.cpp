@@ -0,0 +1,497 @@
+#include "ShadowAtlas.h"
+#include <math.h>
+#include <string.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "GLState.h"
+#include "GpuMemory.h"
+
+static const char* shadowVertexShader = "shadowVertex.glsl";
+static const char* shadowFragmentShader = "depthFragment.glsl";
+
+static const GLfloat SHADOW_NEAR_PLANE = 0.05f;
+// Unbounded lights still only cast shadows this far.
+static const GLfloat MAX_SHADOW_RANGE = 50.0f;
+
+// Cube face directions and up vectors, in the order the shaders pick faces.
+static const glm::vec3 faceDirections[6] = {
+	glm::vec3(+1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+	glm::vec3(0.0f, +1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+	glm::vec3(0.0f, 0.0f, +1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+};
+static const glm::vec3 faceUps[6] = {
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+	glm::vec3(0.0f, 0.0f, +1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+};
+
+// Every other bit of a Z-order index, i.e. one of its coordinates.
+static GLuint CompactBits(GLuint v) {
+	v &= 0x55555555u;
+	v = (v | (v >> 1)) & 0x33333333u;
+	v = (v | (v >> 2)) & 0x0F0F0F0Fu;
+	v = (v | (v >> 4)) & 0x00FF00FFu;
+	v = (v | (v >> 8)) & 0x0000FFFFu;
+	return v;
+}
+
+static bool SameShadowCaster(const LightData& a, const LightData& b) {
+	return a.type == b.type && a.positionRange == b.positionRange && a.directionEdge == b.directionEdge;
+}
+
+ShadowAtlas::ShadowAtlas() {
+	uniformLightViewProjection = 0;
+	framebufferID = 0;
+	atlasID = 0;
+	shadowBuffer = 0;
+	atlasSize = 0;
+	shadowDataDirty = false;
+
+	for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+		lights[i] = ShadowedLight();
+		shadowData[i] = LightShadowData();
+	}
+
+	budgetMs = 1.0f;
+	msPerMegatexel = 0.25f;
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		timeQueries[i][0] = 0;
+		timeQueries[i][1] = 0;
+		queryTexels[i] = 0.0;
+		queryPending[i] = false;
+	}
+	frame = 0;
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+bool ShadowAtlas::CreateShadowAtlas(GLsizei size) {
+	ClearShadowAtlas();
+
+	if (size < MAX_TILE_SIZE || size % MIN_TILE_SIZE != 0) {
+		printf("Shadow atlas size %d must be a multiple of %d and at least %d\n", size, MIN_TILE_SIZE, MAX_TILE_SIZE);
+		return false;
+	}
+
+	shadowShader.CreateFromFiles(shadowVertexShader, shadowFragmentShader);
+	if (shadowShader.GetShaderID() == 0) {
+		return false;
+	}
+	uniformLightViewProjection = shadowShader.GetUniformLocation("lightViewProjection");
+
+	atlasSize = size;
+
+	atlasID = GpuMemory::CreateTexture(GPU_MEMORY_SHADOW, "shadow atlas", GL_TEXTURE_2D,
+		1, GL_DEPTH_COMPONENT32F, atlasSize, atlasSize, 1);
+	glTextureParameteri(atlasID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(atlasID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(atlasID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(atlasID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(atlasID, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(atlasID, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	const GLfloat farDepth = 1.0f;
+	glClearTexImage(atlasID, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+
+	glCreateFramebuffers(1, &framebufferID);
+	glNamedFramebufferDrawBuffer(framebufferID, GL_NONE);
+	glNamedFramebufferReadBuffer(framebufferID, GL_NONE);
+	glNamedFramebufferTexture(framebufferID, GL_DEPTH_ATTACHMENT, atlasID, 0);
+
+	GLenum status = glCheckNamedFramebufferStatus(framebufferID, GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Shadow atlas framebuffer is incomplete: 0x%x\n", status);
+		ClearShadowAtlas();
+		return false;
+	}
+
+	shadowBuffer = GpuMemory::CreateBuffer(GPU_MEMORY_SHADOW, "shadow atlas lights",
+		sizeof(shadowData), shadowData, GL_DYNAMIC_STORAGE_BIT);
+
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		glCreateQueries(GL_TIMESTAMP, 2, timeQueries[i]);
+	}
+
+	return true;
+}
+
+GLsizei ShadowAtlas::DesiredTileSize(GLfloat coverage) {
+	if (coverage <= 0.0f) {
+		return 0;
+	}
+	GLsizei size = MIN_TILE_SIZE;
+	while (size < MAX_TILE_SIZE && size < coverage * MAX_TILE_SIZE) {
+		size *= 2;
+	}
+	return size;
+}
+
+void ShadowAtlas::GatherLight(int slot, const LightData* data, const glm::mat4& view, GLfloat tanHalfY) {
+	ShadowedLight& light = lights[slot];
+
+	if (!data || data->positionRange.w <= 0.0f) {
+		light.coverage = 0.0f;
+		light.requestedSize = 0;
+		return;
+	}
+
+	light.current = *data;
+	light.faces = data->type == LIGHT_DATA_SPOT ? 1 : MAX_FACES;
+	if (light.tileSize > 0 && !SameShadowCaster(light.current, light.rendered)) {
+		light.dirty = true;
+	}
+
+	// Fraction of the screen height the light's range spans.
+	GLfloat range = glm::min(data->positionRange.w, MAX_SHADOW_RANGE);
+	glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(data->positionRange), 1.0f));
+	GLfloat distance = glm::length(center);
+	if (center.z - range > 0.0f) {
+		light.coverage = 0.0f;
+	}
+	else if (distance <= range) {
+		light.coverage = 1.0f;
+	}
+	else {
+		light.coverage = glm::min(1.0f, range / (distance * tanHalfY));
+	}
+
+	GLsizei desired = DesiredTileSize(light.coverage);
+	if (desired > light.requestedSize || desired * 4 <= light.requestedSize) {
+		light.requestedSize = desired;
+	}
+}
+
+void ShadowAtlas::MarkCasterChanges() {
+	if (casterBounds.size() != renderedCasterBounds.size()) {
+		for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+			lights[i].dirty = true;
+		}
+		renderedCasterBounds = casterBounds;
+		return;
+	}
+
+	for (size_t c = 0; c < casterBounds.size(); c++) {
+		if (casterBounds[c] == renderedCasterBounds[c]) {
+			continue;
+		}
+		// Both where the caster was and where it is now may need new shadows.
+		for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+			if (lights[i].tileSize == 0) {
+				continue;
+			}
+			glm::vec3 position = glm::vec3(lights[i].current.positionRange);
+			GLfloat range = glm::min(lights[i].current.positionRange.w, MAX_SHADOW_RANGE);
+			if (glm::length(glm::vec3(casterBounds[c]) - position) <= range + casterBounds[c].w
+				|| glm::length(glm::vec3(renderedCasterBounds[c]) - position) <= range + renderedCasterBounds[c].w) {
+				lights[i].dirty = true;
+			}
+		}
+		renderedCasterBounds[c] = casterBounds[c];
+	}
+}
+
+bool ShadowAtlas::Pack() {
+	const GLuint gridSize = atlasSize / MIN_TILE_SIZE;
+	const GLuint totalCells = gridSize * gridSize;
+
+	GLsizei sizes[MAX_SHADOWED_LIGHTS];
+	for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+		sizes[i] = lights[i].requestedSize;
+	}
+
+	// Shrink the largest, least covering tiles until everything fits; lights
+	// already at the minimum size lose their shadow.
+	for (;;) {
+		GLuint usedCells = 0;
+		for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+			GLuint side = sizes[i] / MIN_TILE_SIZE;
+			usedCells += lights[i].faces * side * side;
+		}
+		if (usedCells <= totalCells) {
+			break;
+		}
+
+		int victim = -1;
+		for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+			if (sizes[i] == 0) {
+				continue;
+			}
+			if (victim < 0 || sizes[i] > sizes[victim]
+				|| (sizes[i] == sizes[victim] && lights[i].coverage < lights[victim].coverage)) {
+				victim = i;
+			}
+		}
+		sizes[victim] = sizes[victim] > MIN_TILE_SIZE ? sizes[victim] / 2 : 0;
+	}
+
+	int order[MAX_SHADOWED_LIGHTS];
+	for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+		int j = i;
+		while (j > 0 && sizes[order[j - 1]] < sizes[i]) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	// Biggest first keeps the cursor aligned to every later tile's size.
+	bool changed = false;
+	GLuint cursor = 0;
+	for (int n = 0; n < MAX_SHADOWED_LIGHTS; n++) {
+		int i = order[n];
+		ShadowedLight& light = lights[i];
+
+		GLuint firstCell = cursor;
+		if (sizes[i] > 0) {
+			GLuint side = sizes[i] / MIN_TILE_SIZE;
+			cursor += light.faces * side * side;
+		}
+
+		if (sizes[i] != light.tileSize || (sizes[i] > 0 && firstCell != light.firstCell)) {
+			light.tileSize = sizes[i];
+			light.firstCell = firstCell;
+			light.dirty = sizes[i] > 0;
+			shadowData[i].faceCount = 0;
+			shadowDataDirty = true;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+void ShadowAtlas::ReadTimings() {
+	if (!queryPending[frame]) {
+		return;
+	}
+
+	GLint available = 0;
+	glGetQueryObjectiv(timeQueries[frame][1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return;
+	}
+
+	GLuint64 begin = 0, end = 0;
+	glGetQueryObjectui64v(timeQueries[frame][0], GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(timeQueries[frame][1], GL_QUERY_RESULT, &end);
+	queryPending[frame] = false;
+
+	stats.measuredMs = (GLfloat)((end - begin) / 1e6);
+	if (queryTexels[frame] > 0.0) {
+		GLfloat measured = (GLfloat)(stats.measuredMs / (queryTexels[frame] / 1e6));
+		msPerMegatexel = msPerMegatexel * 0.8f + measured * 0.2f;
+	}
+}
+
+bool ShadowAtlas::RenderLight(int slot, DrawBatch& batch, RingBuffer& ring) {
+	ShadowedLight& light = lights[slot];
+	LightShadowData& data = shadowData[slot];
+
+	glm::vec3 position = glm::vec3(light.current.positionRange);
+	GLfloat farPlane = glm::min(light.current.positionRange.w, MAX_SHADOW_RANGE);
+
+	// Only casters within the light's range can shadow anything it lights.
+	casterVisible.resize(casterBounds.size());
+	for (size_t i = 0; i < casterBounds.size(); i++) {
+		casterVisible[i] = glm::length(glm::vec3(casterBounds[i]) - position) <= farPlane + casterBounds[i].w;
+	}
+
+	GLintptr commands = 0;
+	if (!batch.UploadCommandSubset(ring, casterVisible, &commands)) {
+		return false;
+	}
+
+	if (light.current.type == LIGHT_DATA_SPOT) {
+		glm::vec3 direction = glm::normalize(glm::vec3(light.current.directionEdge));
+		GLfloat fov = glm::clamp(2.0f * acosf(light.current.directionEdge.w) + glm::radians(2.0f),
+			glm::radians(10.0f), glm::radians(160.0f));
+		glm::vec3 up = fabsf(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		data.matrices[0] = glm::perspective(fov, 1.0f, SHADOW_NEAR_PLANE, farPlane)
+			* glm::lookAt(position, position + direction, up);
+	}
+	else {
+		glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, farPlane);
+		for (int f = 0; f < MAX_FACES; f++) {
+			data.matrices[f] = faceProjection * glm::lookAt(position, position + faceDirections[f], faceUps[f]);
+		}
+	}
+
+	GLuint side = light.tileSize / MIN_TILE_SIZE;
+	for (int f = 0; f < light.faces; f++) {
+		GLuint cell = light.firstCell + f * side * side;
+		GLint x = CompactBits(cell) * MIN_TILE_SIZE;
+		GLint y = CompactBits(cell >> 1) * MIN_TILE_SIZE;
+
+		glViewport(x, y, light.tileSize, light.tileSize);
+		glScissor(x, y, light.tileSize, light.tileSize);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		glUniformMatrix4fv(uniformLightViewProjection, 1, GL_FALSE, glm::value_ptr(data.matrices[f]));
+		batch.RenderPositions(commands);
+
+		data.rects[f] = glm::vec4(x, y, light.tileSize, light.tileSize) / (GLfloat)atlasSize;
+	}
+
+	data.faceCount = light.faces;
+	shadowDataDirty = true;
+
+	light.rendered = light.current;
+	light.dirty = false;
+	light.framesWaiting = 0;
+	return true;
+}
+
+void ShadowAtlas::Update(DrawBatch& batch, RingBuffer& ring, const glm::mat4& view, const glm::mat4& projection,
+	PointLight* pLights, unsigned int pointLightCount,
+	SpotLight* sLights, unsigned int spotLightCount) {
+	stats.rendered = 0;
+	stats.pending = 0;
+	stats.tilesInUse = 0;
+	stats.estimatedMs = 0.0f;
+
+	if (atlasID == 0) {
+		return;
+	}
+
+	frame = (frame + 1) % QUERY_FRAMES;
+	ReadTimings();
+
+	GLfloat tanHalfY = 1.0f / fabsf(projection[1][1]);
+	bool resized = false;
+	for (int slot = 0; slot < MAX_SHADOWED_LIGHTS; slot++) {
+		LightData data;
+		const LightData* source = nullptr;
+		if (slot < MAX_POINT_LIGHTS && (unsigned int)slot < pointLightCount) {
+			pLights[slot].GetLightData(&data);
+			source = &data;
+		}
+		else if (slot >= MAX_POINT_LIGHTS && (unsigned int)(slot - MAX_POINT_LIGHTS) < spotLightCount) {
+			sLights[slot - MAX_POINT_LIGHTS].GetLightData(&data);
+			source = &data;
+		}
+
+		GLsizei previous = lights[slot].requestedSize;
+		GatherLight(slot, source, view, tanHalfY);
+		resized |= lights[slot].requestedSize != previous;
+	}
+
+	if (resized) {
+		Pack();
+	}
+
+	batch.GetDrawBounds(casterBounds);
+	MarkCasterChanges();
+
+	// Most visible and longest waiting lights first.
+	int order[MAX_SHADOWED_LIGHTS];
+	GLfloat priority[MAX_SHADOWED_LIGHTS];
+	int candidates = 0;
+	for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+		if (lights[i].tileSize == 0) {
+			continue;
+		}
+		stats.tilesInUse += lights[i].faces;
+		if (!lights[i].dirty) {
+			continue;
+		}
+		priority[i] = lights[i].coverage * (1.0f + lights[i].framesWaiting);
+		int j = candidates++;
+		while (j > 0 && priority[order[j - 1]] < priority[i]) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	GLdouble texels = 0.0;
+	bool passStarted = false;
+	for (int n = 0; n < candidates; n++) {
+		ShadowedLight& light = lights[order[n]];
+		GLdouble lightTexels = (GLdouble)light.faces * light.tileSize * light.tileSize;
+		GLfloat cost = (GLfloat)(lightTexels / 1e6) * msPerMegatexel;
+
+		// Always make some progress, even if one light is over budget alone.
+		if (stats.rendered > 0 && stats.estimatedMs + cost > budgetMs) {
+			light.framesWaiting++;
+			stats.pending++;
+			continue;
+		}
+
+		if (!passStarted) {
+			passStarted = true;
+			glQueryCounter(timeQueries[frame][0], GL_TIMESTAMP);
+
+			GLState::BindFramebuffer(framebufferID);
+			GLState::Enable(GL_DEPTH_TEST);
+			GLState::Enable(GL_SCISSOR_TEST);
+			GLState::Enable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+			glDepthMask(GL_TRUE);
+			shadowShader.UseShader();
+		}
+
+		// Casters that didn't fit the ring: the light stays dirty and waits.
+		if (!RenderLight(order[n], batch, ring)) {
+			light.framesWaiting++;
+			stats.pending++;
+			continue;
+		}
+		stats.rendered++;
+		stats.estimatedMs += cost;
+		texels += lightTexels;
+	}
+
+	if (passStarted) {
+		// Timings only mean something with texels to divide them by.
+		if (stats.rendered > 0) {
+			glQueryCounter(timeQueries[frame][1], GL_TIMESTAMP);
+			queryTexels[frame] = texels;
+			queryPending[frame] = true;
+		}
+
+		glPolygonOffset(0.0f, 0.0f);
+		GLState::Disable(GL_POLYGON_OFFSET_FILL);
+		GLState::Disable(GL_SCISSOR_TEST);
+		GLState::BindFramebuffer(0);
+	}
+
+	if (shadowDataDirty) {
+		glNamedBufferSubData(shadowBuffer, 0, sizeof(shadowData), shadowData);
+		shadowDataDirty = false;
+	}
+}
+
+void ShadowAtlas::UseShadowAtlas(GLuint atlasShadowsLocation) {
+	GLState::BindTexture(SHADOW_ATLAS_TEXTURE_UNIT, GL_TEXTURE_2D, atlasID);
+	GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_SHADOW_BINDING, shadowBuffer);
+	glUniform1i(atlasShadowsLocation, 1);
+}
+
+void ShadowAtlas::ClearShadowAtlas() {
+	if (framebufferID != 0) {
+		GLState::ForgetFramebuffer(framebufferID);
+		glDeleteFramebuffers(1, &framebufferID);
+		framebufferID = 0;
+	}
+	GpuMemory::DeleteTexture(atlasID);
+	GpuMemory::DeleteBuffer(shadowBuffer);
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		if (timeQueries[i][0] != 0) {
+			glDeleteQueries(2, timeQueries[i]);
+		}
+		timeQueries[i][0] = 0;
+		timeQueries[i][1] = 0;
+		queryPending[i] = false;
+	}
+
+	for (int i = 0; i < MAX_SHADOWED_LIGHTS; i++) {
+		lights[i] = ShadowedLight();
+		shadowData[i] = LightShadowData();
+	}
+	shadowDataDirty = false;
+	renderedCasterBounds.clear();
+	atlasSize = 0;
+	shadowShader.ClearShader();
+}
+
+ShadowAtlas::~ShadowAtlas() {
+	ClearShadowAtlas();
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "DrawBatch.h"
+#include "PointLight.h"
+#include "RingBuffer.h"
+#include "Shader.h"
+#include "SpotLight.h"
+
+// Shadows for point and spot lights, all rendered into one depth atlas.
+//
+// Every light gets a square tile (six for point lights, one per cube face)
+// sized by how much of the screen its range covers, as a power of two
+// between MIN_TILE_SIZE and MAX_TILE_SIZE. Tiles are packed in Z-order,
+// biggest first, which keeps every power-of-two tile aligned; sizes are
+// halved when the atlas runs out of room. Sizes only change past a factor
+// of two either way, so the packing stays put while the camera wanders.
+//
+// A light is re-rendered only when its tile moved or it, or a caster within
+// its range, changed. Pending lights are served by screen coverage and wait
+// time until the frame's update budget is used up; the cost per texel
+// behind that budget is measured with GPU timestamps.
+class ShadowAtlas {
+public:
+	struct UpdateStats {
+		unsigned int rendered;
+		unsigned int pending;
+		unsigned int tilesInUse;
+		GLfloat estimatedMs;
+		GLfloat measuredMs;
+	};
+
+	ShadowAtlas();
+
+	bool CreateShadowAtlas(GLsizei size);
+
+	void SetUpdateBudget(GLfloat milliseconds) { budgetMs = milliseconds; }
+
+	// Needs the batch's draw data for this frame to be uploaded already.
+	void Update(DrawBatch& batch, RingBuffer& ring, const glm::mat4& view, const glm::mat4& projection,
+		PointLight* pLights, unsigned int pointLightCount,
+		SpotLight* sLights, unsigned int spotLightCount);
+	void UseShadowAtlas(GLuint atlasShadowsLocation);
+
+	UpdateStats GetLastStats() const { return stats; }
+
+	void ClearShadowAtlas();
+
+	~ShadowAtlas();
+
+	static const GLsizei MIN_TILE_SIZE = 64;
+	static const GLsizei MAX_TILE_SIZE = 1024;
+
+private:
+	static const int MAX_FACES = 6;
+	static const int QUERY_FRAMES = 3;
+
+	// Mirrors LightShadow in the shaders (std430). faceCount 0 means the
+	// light has nothing in the atlas yet.
+	struct LightShadowData {
+		glm::mat4 matrices[MAX_FACES];
+		glm::vec4 rects[MAX_FACES];
+		GLuint faceCount;
+		GLuint pad[3];
+	};
+	static_assert(sizeof(LightShadowData) == 496, "LightShadowData must match the std430 layout");
+
+	struct ShadowedLight {
+		LightData current;
+		LightData rendered;
+		GLfloat coverage;
+		GLsizei requestedSize;  // wanted tile size, with hysteresis
+		GLsizei tileSize;       // size actually packed, 0 when none
+		GLuint firstCell;
+		int faces;
+		bool dirty;
+		unsigned int framesWaiting;
+	};
+
+	Shader shadowShader;
+	GLuint uniformLightViewProjection;
+
+	GLuint framebufferID;
+	GLuint atlasID;
+	GLuint shadowBuffer;
+	GLsizei atlasSize;
+
+	ShadowedLight lights[MAX_SHADOWED_LIGHTS];
+	LightShadowData shadowData[MAX_SHADOWED_LIGHTS];
+	bool shadowDataDirty;
+
+	std::vector<glm::vec4> casterBounds;
+	std::vector<glm::vec4> renderedCasterBounds;
+	std::vector<bool> casterVisible;
+
+	GLfloat budgetMs;
+	GLfloat msPerMegatexel;
+	GLuint timeQueries[QUERY_FRAMES][2];
+	GLdouble queryTexels[QUERY_FRAMES];
+	bool queryPending[QUERY_FRAMES];
+	int frame;
+
+	UpdateStats stats;
+
+	static GLsizei DesiredTileSize(GLfloat coverage);
+	void GatherLight(int slot, const LightData* data, const glm::mat4& view, GLfloat tanHalfY);
+	void MarkCasterChanges();
+	bool Pack();
+	void ReadTimings();
+	// False when the light's caster commands don't fit the ring; nothing is
+	// drawn and the light stays dirty.
+	bool RenderLight(int slot, DrawBatch& batch, RingBuffer& ring);
+};
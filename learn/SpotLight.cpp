@@ -44,4 +44,10 @@ void SpotLight::SetFlash(glm::vec3 pos, glm::vec3 dir) {
 	direction = dir;
 }
 
+void SpotLight::GetLightData(LightData* data) const {
+	PointLight::GetLightData(data);
+	data->directionEdge = glm::vec4(direction, procEdge);
+	data->type = LIGHT_DATA_SPOT;
+}
+
 SpotLight::~SpotLight() {}
\ No newline at end of file
@@ -20,6 +20,7 @@ public:
         GLuint edgeLocation
     );
     void SetFlash(glm::vec3 pos, glm::vec3 dir);
+    void GetLightData(LightData* data) const;
     ~SpotLight();
 private:
     glm::vec3 direction;
@@ -1,5 +1,8 @@
 #include "Texture.h"
 #include "stb_image.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "CpuProfiler.h"
 
 
 Texture::Texture()
@@ -20,8 +23,33 @@ Texture::Texture(const char* fileLoc)
 	fileLocation = fileLoc;
 }
 
+Texture::Texture(Texture&& other)
+{
+	textureID = other.textureID;
+	width = other.width;
+	height = other.height;
+	bitDepth = other.bitDepth;
+	fileLocation = other.fileLocation;
+	other.textureID = 0;
+}
+
+Texture& Texture::operator=(Texture&& other)
+{
+	if (this != &other) {
+		ClearTexture();
+		textureID = other.textureID;
+		width = other.width;
+		height = other.height;
+		bitDepth = other.bitDepth;
+		fileLocation = other.fileLocation;
+		other.textureID = 0;
+	}
+	return *this;
+}
+
 bool Texture::LoadTextureA()
 {
+	PROFILE_ZONE("Texture::LoadTextureA");
 	unsigned char* texData = stbi_load(fileLocation, &width, &height, &bitDepth, 0);
 	if (!texData)
 	{
@@ -29,18 +57,7 @@ bool Texture::LoadTextureA()
 		return false;
 	}
 
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texData);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
+	CreateStorage(GL_RGBA8, GL_RGBA, texData);
 
 	stbi_image_free(texData);
 
@@ -48,40 +65,50 @@ bool Texture::LoadTextureA()
 }
 
 bool Texture::LoadTexture() {
+	PROFILE_ZONE("Texture::LoadTexture");
 	unsigned char* texData = stbi_load(fileLocation, &width, &height, &bitDepth, 0);
 	if (!texData) {
 		printf("Failed to find: %s\n", fileLocation);
 		return false;
 	}
 
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	CreateStorage(GL_RGB8, GL_RGB, texData);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	stbi_image_free(texData);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, texData);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	return true;
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+void Texture::CreateStorage(GLenum internalFormat, GLenum format, const unsigned char* texData)
+{
+	GLsizei levels = 1;
+	for (int size = width > height ? width : height; size > 1; size >>= 1) {
+		levels++;
+	}
 
-	stbi_image_free(texData);
+	// Immutable, DSA-created storage: no bind needed to fill it in. Loading
+	// again replaces the old storage rather than leaking it.
+	GpuMemory::DeleteTexture(textureID);
+	textureID = GpuMemory::CreateTexture(GPU_MEMORY_TEXTURE, fileLocation, GL_TEXTURE_2D,
+		levels, internalFormat, width, height, 1);
 
-	return true;
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glTextureSubImage2D(textureID, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, texData);
+	glGenerateTextureMipmap(textureID);
 }
 
 void Texture::UseTexture()
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLState::BindTexture(0, GL_TEXTURE_2D, textureID);
 }
 
 void Texture::ClearTexture()
 {
-	glDeleteTextures(1, &textureID);
-	textureID = 0;
+	GpuMemory::DeleteTexture(textureID);
 	width = 0;
 	height = 0;
 	bitDepth = 0;
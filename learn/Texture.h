@@ -4,6 +4,12 @@ public:
     Texture();  
     Texture(const char* fileLoc); // Updated constructor to accept const char*  
 
+    // Owns its GL texture, so a copy would delete it a second time: move only.
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+    Texture(Texture&& other);
+    Texture& operator=(Texture&& other);
+
     bool LoadTexture();  
     bool LoadTextureA();
 
@@ -15,4 +21,6 @@ private:
     GLuint textureID;  
     int width, height, bitDepth;  
     const char* fileLocation; // Updated to const char*  
+
+    void CreateStorage(GLenum internalFormat, GLenum format, const unsigned char* texData);
 };
\ No newline at end of file
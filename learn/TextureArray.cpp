@@ -0,0 +1,174 @@
+#include "TextureArray.h"
+#include <string.h>
+#include "stb_image.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+TextureArray::TextureArray() {
+	textureID = 0;
+	width = 0;
+	height = 0;
+	layerCount = 0;
+	levelCount = 0;
+	residentLevel = 0;
+}
+
+TextureArray::TextureArray(int layerWidth, int layerHeight) {
+	textureID = 0;
+	width = layerWidth;
+	height = layerHeight;
+	layerCount = 0;
+	levelCount = 0;
+	residentLevel = 0;
+}
+
+GLuint TextureArray::AddLayer(unsigned char* texData) {
+	pendingLayers.push_back(texData);
+	return layerCount++;
+}
+
+GLuint TextureArray::CountLevels(int width, int height) {
+	GLuint levels = 1;
+	for (int size = width > height ? width : height; size > 1; size >>= 1) {
+		levels++;
+	}
+	return levels;
+}
+
+bool TextureArray::Build(bool streamed, GLuint firstLevel) {
+	if (textureID != 0 || !levelData.empty()) {
+		printf("Texture array %dx%d is already built\n", width, height);
+		return false;
+	}
+	if (layerCount == 0) {
+		return false;
+	}
+
+	levelCount = CountLevels(width, height);
+	if (streamed) {
+		BuildMipChain();
+		return SetResidentLevel(firstLevel < levelCount ? firstLevel : levelCount - 1);
+	}
+
+	textureID = GpuMemory::CreateTexture(GPU_MEMORY_TEXTURE, "texture array", GL_TEXTURE_2D_ARRAY,
+		levelCount, GL_RGBA8, width, height, layerCount);
+
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	for (GLuint layer = 0; layer < layerCount; layer++) {
+		glTextureSubImage3D(textureID, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pendingLayers[layer]);
+		stbi_image_free(pendingLayers[layer]);
+	}
+	pendingLayers.clear();
+
+	glGenerateTextureMipmap(textureID);
+	residentLevel = 0;
+
+	return true;
+}
+
+void TextureArray::BuildMipChain() {
+	levelData.resize(levelCount);
+
+	// Level 0 is the layers back to back, so every level uploads in one call.
+	size_t layerBytes = static_cast<size_t>(width) * height * 4;
+	levelData[0].resize(layerBytes * layerCount);
+	for (GLuint layer = 0; layer < layerCount; layer++) {
+		memcpy(levelData[0].data() + layerBytes * layer, pendingLayers[layer], layerBytes);
+		stbi_image_free(pendingLayers[layer]);
+	}
+	pendingLayers.clear();
+
+	// 2x2 box filter; an odd edge repeats its last texel.
+	for (GLuint level = 1; level < levelCount; level++) {
+		int sourceWidth = width >> (level - 1) > 0 ? width >> (level - 1) : 1;
+		int sourceHeight = height >> (level - 1) > 0 ? height >> (level - 1) : 1;
+		int levelWidth = width >> level > 0 ? width >> level : 1;
+		int levelHeight = height >> level > 0 ? height >> level : 1;
+		levelData[level].resize(static_cast<size_t>(levelWidth) * levelHeight * 4 * layerCount);
+
+		for (GLuint layer = 0; layer < layerCount; layer++) {
+			const unsigned char* source = levelData[level - 1].data() + static_cast<size_t>(sourceWidth) * sourceHeight * 4 * layer;
+			unsigned char* target = levelData[level].data() + static_cast<size_t>(levelWidth) * levelHeight * 4 * layer;
+			for (int y = 0; y < levelHeight; y++) {
+				int y0 = y * 2 < sourceHeight ? y * 2 : sourceHeight - 1;
+				int y1 = y * 2 + 1 < sourceHeight ? y * 2 + 1 : sourceHeight - 1;
+				for (int x = 0; x < levelWidth; x++) {
+					int x0 = x * 2 < sourceWidth ? x * 2 : sourceWidth - 1;
+					int x1 = x * 2 + 1 < sourceWidth ? x * 2 + 1 : sourceWidth - 1;
+					for (int c = 0; c < 4; c++) {
+						int sum = source[(y0 * sourceWidth + x0) * 4 + c] + source[(y0 * sourceWidth + x1) * 4 + c]
+							+ source[(y1 * sourceWidth + x0) * 4 + c] + source[(y1 * sourceWidth + x1) * 4 + c];
+						target[(y * levelWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+}
+
+GLsizeiptr TextureArray::GetResidentBytes(GLuint level) const {
+	if (level >= levelCount) {
+		return 0;
+	}
+	return GpuMemory::TextureBytes(GL_RGBA8, width >> level > 0 ? width >> level : 1,
+		height >> level > 0 ? height >> level : 1, layerCount, levelCount - level);
+}
+
+bool TextureArray::SetResidentLevel(GLuint level) {
+	if (levelData.empty() || level >= levelCount) {
+		return false;
+	}
+	if (textureID != 0 && level == residentLevel) {
+		return true;
+	}
+
+	// Refilled from system memory, so the old storage can go first and the
+	// two never take GPU memory at the same time. Callers rebind afterwards.
+	GpuMemory::DeleteTexture(textureID);
+	GLsizei levelWidth = width >> level > 0 ? width >> level : 1;
+	GLsizei levelHeight = height >> level > 0 ? height >> level : 1;
+	GLuint streamed = GpuMemory::CreateTexture(GPU_MEMORY_TEXTURE, "streamed texture array", GL_TEXTURE_2D_ARRAY,
+		levelCount - level, GL_RGBA8, levelWidth, levelHeight, layerCount);
+
+	glTextureParameteri(streamed, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(streamed, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(streamed, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(streamed, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	for (GLuint source = level; source < levelCount; source++) {
+		GLsizei sourceWidth = width >> source > 0 ? width >> source : 1;
+		GLsizei sourceHeight = height >> source > 0 ? height >> source : 1;
+		glTextureSubImage3D(streamed, source - level, 0, 0, 0, sourceWidth, sourceHeight, layerCount,
+			GL_RGBA, GL_UNSIGNED_BYTE, levelData[source].data());
+	}
+
+	textureID = streamed;
+	residentLevel = level;
+	return true;
+}
+
+void TextureArray::UseTextureArray(GLuint unit) {
+	GLState::BindTexture(unit, GL_TEXTURE_2D_ARRAY, textureID);
+}
+
+void TextureArray::ClearTextureArray() {
+	for (size_t i = 0; i < pendingLayers.size(); i++) {
+		stbi_image_free(pendingLayers[i]);
+	}
+	pendingLayers.clear();
+
+	levelData.clear();
+
+	GpuMemory::DeleteTexture(textureID);
+	layerCount = 0;
+	levelCount = 0;
+	residentLevel = 0;
+}
+
+TextureArray::~TextureArray() {
+	ClearTextureArray();
+}
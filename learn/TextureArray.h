@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+
+// A GL_TEXTURE_2D_ARRAY whose layers all share one size. Layers are decoded up
+// front and uploaded in one go by Build(), since the storage is immutable.
+//
+// A streamed array keeps its whole mip chain in system memory and only has
+// the levels from GetResidentLevel() down on the GPU. SetResidentLevel()
+// swaps in storage for a different set of levels; texture coordinates are
+// normalised, so samplers never notice the size change.
+class TextureArray {
+public:
+	TextureArray();
+	TextureArray(int layerWidth, int layerHeight);
+
+	GLuint AddLayer(unsigned char* texData);
+	// Unstreamed arrays get every level at once and free the layer data.
+	// Streamed ones build the mip chain on the CPU and upload from firstLevel.
+	bool Build(bool streamed = false, GLuint firstLevel = 0);
+
+	void UseTextureArray(GLuint unit);
+	void ClearTextureArray();
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	GLuint GetLayerCount() const { return layerCount; }
+	GLuint GetLevelCount() const { return levelCount; }
+
+	bool IsStreamed() const { return !levelData.empty(); }
+	GLuint GetResidentLevel() const { return residentLevel; }
+	// GPU bytes with every level from level down resident.
+	GLsizeiptr GetResidentBytes(GLuint level) const;
+	bool SetResidentLevel(GLuint level);
+
+	~TextureArray();
+
+private:
+	GLuint textureID;
+	int width, height;
+	GLuint layerCount;
+	GLuint levelCount;
+	GLuint residentLevel;
+	std::vector<unsigned char*> pendingLayers;
+	// Streamed arrays only: RGBA8 texels of every layer, one entry per level.
+	std::vector<std::vector<unsigned char>> levelData;
+
+	static GLuint CountLevels(int width, int height);
+	void BuildMipChain();
+};
@@ -0,0 +1,140 @@
+#include "TextureLibrary.h"
+#include <stdlib.h>
+#include "stb_image.h"
+#include "CpuProfiler.h"
+
+TextureLibrary::TextureLibrary() {
+	streaming = false;
+}
+
+bool TextureLibrary::AddTexture(const char* fileLocation, TextureHandle* handle) {
+	if (!fileLocation || !handle) {
+		return false;
+	}
+	PendingTexture texture = { fileLocation, handle, nullptr, 0, 0, false, 0 };
+	pending.push_back(texture);
+	return true;
+}
+
+bool TextureLibrary::AddGeneratedTexture(int width, int height, unsigned int seed, TextureHandle* handle) {
+	if (width <= 0 || height <= 0 || !handle) {
+		return false;
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "generated %dx%d #%u", width, height, seed);
+	PendingTexture texture = { name, handle, nullptr, width, height, true, seed };
+	pending.push_back(texture);
+	return true;
+}
+
+unsigned char* TextureLibrary::GenerateTexture(int width, int height, unsigned int seed) {
+	// malloc so the layer can be released with stbi_image_free like a decoded one.
+	unsigned char* texData = static_cast<unsigned char*>(malloc(static_cast<size_t>(width) * height * 4));
+	if (!texData) {
+		return nullptr;
+	}
+
+	const int CHECKER_SIZE = 64;
+	unsigned char tint[3] = {
+		static_cast<unsigned char>(96 + seed * 53 % 160),
+		static_cast<unsigned char>(96 + seed * 97 % 160),
+		static_cast<unsigned char>(96 + seed * 29 % 160)
+	};
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			unsigned int hash = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+			hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+			int noise = static_cast<int>(hash >> 26);
+			int light = ((x / CHECKER_SIZE + y / CHECKER_SIZE) & 1) ? 255 : 160;
+			unsigned char* texel = texData + (static_cast<size_t>(y) * width + x) * 4;
+			for (int c = 0; c < 3; c++) {
+				int value = tint[c] * light / 255 + noise;
+				texel[c] = static_cast<unsigned char>(value > 255 ? 255 : value);
+			}
+			texel[3] = 255;
+		}
+	}
+	return texData;
+}
+
+bool TextureLibrary::PlaceTexture(PendingTexture& texture) {
+	if (!texture.texData) {
+		printf("Failed to find: %s\n", texture.fileLocation.c_str());
+		return false;
+	}
+
+	for (size_t i = 0; i < arrays.size(); i++) {
+		if (arrays[i]->GetWidth() == texture.width && arrays[i]->GetHeight() == texture.height) {
+			texture.handle->array = static_cast<GLuint>(i);
+			texture.handle->layer = arrays[i]->AddLayer(texture.texData);
+			return true;
+		}
+	}
+
+	if (arrays.size() >= MAX_TEXTURE_ARRAYS) {
+		printf("Can't place %s: all %d texture arrays are in use\n", texture.fileLocation.c_str(), MAX_TEXTURE_ARRAYS);
+		stbi_image_free(texture.texData);
+		return false;
+	}
+
+	arrays.push_back(new TextureArray(texture.width, texture.height));
+	texture.handle->array = static_cast<GLuint>(arrays.size() - 1);
+	texture.handle->layer = arrays.back()->AddLayer(texture.texData);
+	return true;
+}
+
+bool TextureLibrary::Build(JobSystem& jobs) {
+	// Decoding is the slow part and each file is independent. Placement
+	// stays serial and in AddTexture order, so layers don't depend on which
+	// decode finished first.
+	jobs.ParallelFor(pending.size(), 1, [this](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			PROFILE_ZONE("TextureLibrary decode");
+			if (pending[i].generated) {
+				pending[i].texData = GenerateTexture(pending[i].width, pending[i].height, pending[i].seed);
+				continue;
+			}
+			int bitDepth;
+			// Everything is expanded to RGBA so same-size images always fit one array.
+			pending[i].texData = stbi_load(pending[i].fileLocation.c_str(), &pending[i].width, &pending[i].height, &bitDepth, 4);
+		}
+	});
+
+	bool built = true;
+	for (size_t i = 0; i < pending.size(); i++) {
+		built = PlaceTexture(pending[i]) && built;
+	}
+	pending.clear();
+
+	for (size_t i = 0; i < arrays.size(); i++) {
+		built = arrays[i]->Build(streaming, GetStreamStartLevel(static_cast<unsigned int>(i))) && built;
+	}
+	return built;
+}
+
+GLuint TextureLibrary::GetStreamStartLevel(unsigned int index) const {
+	const TextureArray* array = arrays[index];
+	GLuint level = 0;
+	for (int size = array->GetWidth() > array->GetHeight() ? array->GetWidth() : array->GetHeight(); size > STREAM_START_SIZE; size >>= 1) {
+		level++;
+	}
+	return level;
+}
+
+void TextureLibrary::UseTextures() {
+	for (size_t i = 0; i < arrays.size(); i++) {
+		arrays[i]->UseTextureArray(static_cast<GLuint>(i));
+	}
+}
+
+void TextureLibrary::ClearTextureLibrary() {
+	for (size_t i = 0; i < arrays.size(); i++) {
+		delete arrays[i];
+	}
+	arrays.clear();
+	pending.clear();
+}
+
+TextureLibrary::~TextureLibrary() {
+	ClearTextureLibrary();
+}
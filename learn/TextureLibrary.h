@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "TextureArray.h"
+#include "JobSystem.h"
+
+// Where a texture ended up: which array (and so which texture unit) and which
+// layer inside it. Small enough to live in per-draw data.
+struct TextureHandle {
+	GLuint array;
+	GLuint layer;
+};
+
+// Packs every loaded texture into a handful of texture arrays, one per image
+// size, so draws using different textures can share a single multi-draw.
+class TextureLibrary {
+public:
+	TextureLibrary();
+
+	// Queues a file; handle is filled in by Build().
+	bool AddTexture(const char* fileLocation, TextureHandle* handle);
+	// Queues a procedural width x height texture (a noisy checkerboard that
+	// varies with seed), for scenes that need textures larger than any file.
+	bool AddGeneratedTexture(int width, int height, unsigned int seed, TextureHandle* handle);
+	// Streamed libraries keep every mip level in system memory and start with
+	// only levels of at most STREAM_START_SIZE texels on the GPU; a
+	// TextureStreamer moves them from there. Set before Build().
+	void SetStreaming(bool enable) { streaming = enable; }
+	bool IsStreaming() const { return streaming; }
+	// Decodes every queued file in parallel, then packs and uploads them.
+	bool Build(JobSystem& jobs);
+
+	void UseTextures();
+	void ClearTextureLibrary();
+
+	unsigned int GetArrayCount() const { return static_cast<unsigned int>(arrays.size()); }
+	TextureArray* GetArray(unsigned int index) const { return arrays[index]; }
+	// Coarsest level a streamed array is allowed to drop to.
+	GLuint GetStreamStartLevel(unsigned int index) const;
+
+	static const int STREAM_START_SIZE = 128;
+
+	~TextureLibrary();
+
+private:
+	struct PendingTexture {
+		std::string fileLocation;
+		TextureHandle* handle;
+		unsigned char* texData;
+		int width, height;
+		bool generated;
+		unsigned int seed;
+	};
+
+	std::vector<TextureArray*> arrays;
+	std::vector<PendingTexture> pending;
+	bool streaming;
+
+	bool PlaceTexture(PendingTexture& texture);
+	static unsigned char* GenerateTexture(int width, int height, unsigned int seed);
+};
@@ -0,0 +1,199 @@
+#include "TextureStreamer.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "CpuProfiler.h"
+#include "GpuMemory.h"
+
+// Past this the budget can't be met by biasing; arrays are at their start
+// levels long before.
+static const GLuint MAX_BIAS = 16;
+
+// Draws closer than this are treated as this close.
+static const GLfloat MIN_DISTANCE = 0.1f;
+
+TextureStreamer::TextureStreamer() {
+	library = nullptr;
+	budget = 0;
+	uploadBudget = 0;
+	evictionCallback = 0;
+	updating = false;
+	owedBytes = 0;
+	stats = StreamStats();
+}
+
+bool TextureStreamer::CreateTextureStreamer(TextureLibrary& textureLibrary, GLsizeiptr budgetBytes, GLsizeiptr uploadBytesPerFrame) {
+	if (!textureLibrary.IsStreaming()) {
+		printf("Texture library isn't streamed, nothing to stream\n");
+		return false;
+	}
+
+	ClearTextureStreamer();
+	library = &textureLibrary;
+	budget = budgetBytes;
+	uploadBudget = uploadBytesPerFrame;
+
+	unsigned int arrayCount = library->GetArrayCount();
+	startLevels.resize(arrayCount);
+	wantedLevels.resize(arrayCount);
+	framesTooFine.assign(arrayCount, 0);
+	for (unsigned int a = 0; a < arrayCount; a++) {
+		startLevels[a] = library->GetStreamStartLevel(a);
+		wantedLevels[a] = startLevels[a];
+	}
+
+	evictionCallback = GpuMemory::AddEvictionCallback([this](GLsizeiptr bytes) {
+		return Evict(bytes);
+	});
+	return true;
+}
+
+GLsizeiptr TextureStreamer::ResidentBytes() const {
+	GLsizeiptr resident = 0;
+	for (unsigned int a = 0; a < library->GetArrayCount(); a++) {
+		resident += library->GetArray(a)->GetResidentBytes(library->GetArray(a)->GetResidentLevel());
+	}
+	return resident;
+}
+
+GLsizeiptr TextureStreamer::PressureBudget() {
+	GLsizeiptr resident = ResidentBytes();
+	GLsizeiptr allowed = budget;
+
+	// Whatever the global budget leaves beside everything else on the GPU.
+	GpuMemory::Stats memory = GpuMemory::GetStats();
+	if (memory.budgetBytes > 0) {
+		GLsizeiptr headroom = memory.budgetBytes - (memory.totalBytes - resident);
+		allowed = headroom < allowed ? headroom : allowed;
+	}
+	if (owedBytes > 0) {
+		GLsizeiptr repaid = resident - owedBytes;
+		allowed = repaid < allowed ? repaid : allowed;
+		owedBytes = 0;
+	}
+	return allowed > 0 ? allowed : 0;
+}
+
+GLsizeiptr TextureStreamer::TotalBytes(GLuint bias) const {
+	GLsizeiptr total = 0;
+	for (size_t a = 0; a < wantedLevels.size(); a++) {
+		GLuint level = wantedLevels[a] + bias < startLevels[a] ? wantedLevels[a] + bias : startLevels[a];
+		total += library->GetArray(static_cast<unsigned int>(a))->GetResidentBytes(level);
+	}
+	return total;
+}
+
+void TextureStreamer::Update(const std::vector<DrawPacket>& draws, const DrawBatch& batch, const MaterialRegistry& materials,
+	const glm::vec3& eyePosition, const glm::mat4& projection, GLsizei viewportHeight) {
+	if (!library) {
+		return;
+	}
+	PROFILE_ZONE("TextureStreamer::Update");
+	// Recomputed every frame, so streaming climbs back once pressure eases.
+	GLsizeiptr allowed = PressureBudget();
+	bool pressured = ResidentBytes() > allowed;
+	updating = true;
+
+	for (size_t a = 0; a < wantedLevels.size(); a++) {
+		wantedLevels[a] = startLevels[a];
+	}
+
+	// World units covered by one pixel at unit distance.
+	GLfloat pixelScale = 2.0f / (projection[1][1] * static_cast<GLfloat>(viewportHeight));
+	for (const DrawPacket& draw : draws) {
+		if (!draw.visible) {
+			continue;
+		}
+		GLfloat uvDensity = batch.GetMeshUvDensity(draw.mesh);
+		TextureHandle texture = materials.GetTexture(draw.material);
+		if (uvDensity <= 0.0f || texture.array >= wantedLevels.size()) {
+			continue;
+		}
+
+		glm::vec4 bounds = batch.GetMeshBounds(draw.mesh);
+		GLfloat scale = glm::max(glm::length(glm::vec3(draw.model[0])),
+			glm::max(glm::length(glm::vec3(draw.model[1])), glm::length(glm::vec3(draw.model[2]))));
+		glm::vec3 centre = glm::vec3(draw.model * glm::vec4(glm::vec3(bounds), 1.0f));
+		GLfloat distance = glm::max(glm::length(centre - eyePosition) - bounds.w * scale, MIN_DISTANCE);
+
+		const TextureArray* array = library->GetArray(texture.array);
+		GLfloat size = static_cast<GLfloat>(array->GetWidth() > array->GetHeight() ? array->GetWidth() : array->GetHeight());
+		GLfloat texelsPerPixel = size * uvDensity / scale * distance * pixelScale;
+		GLuint level = texelsPerPixel > 1.0f ? static_cast<GLuint>(floorf(log2f(texelsPerPixel))) : 0;
+		if (level < wantedLevels[texture.array]) {
+			wantedLevels[texture.array] = level;
+		}
+	}
+
+	stats.wantedBytes = TotalBytes(0);
+	GLuint bias = 0;
+	while (bias < MAX_BIAS && TotalBytes(bias) > allowed) {
+		bias++;
+	}
+
+	stats.uploadedBytes = 0;
+	stats.levelsIn = 0;
+	stats.levelsOut = 0;
+	stats.residentBytes = 0;
+	for (size_t a = 0; a < wantedLevels.size(); a++) {
+		TextureArray* array = library->GetArray(static_cast<unsigned int>(a));
+		GLuint target = wantedLevels[a] + bias < startLevels[a] ? wantedLevels[a] + bias : startLevels[a];
+		GLuint resident = array->GetResidentLevel();
+
+		if (target < resident) {
+			framesTooFine[a] = 0;
+			// Always let one array in, so a small allowance can't stall streaming.
+			GLsizeiptr bytes = array->GetResidentBytes(resident - 1);
+			if (stats.uploadedBytes == 0 || stats.uploadedBytes + bytes <= uploadBudget) {
+				array->SetResidentLevel(resident - 1);
+				stats.uploadedBytes += bytes;
+				stats.levelsIn++;
+			}
+		}
+		else if (target > resident) {
+			// Over budget can't wait out the delay.
+			if (pressured || ++framesTooFine[a] >= DROP_DELAY_FRAMES) {
+				array->SetResidentLevel(target);
+				stats.uploadedBytes += array->GetResidentBytes(target);
+				stats.levelsOut += target - resident;
+				framesTooFine[a] = 0;
+			}
+		}
+		else {
+			framesTooFine[a] = 0;
+		}
+		stats.residentBytes += array->GetResidentBytes(array->GetResidentLevel());
+	}
+	stats.budgetBytes = allowed;
+	stats.bias = bias;
+	updating = false;
+}
+
+GLsizeiptr TextureStreamer::Evict(GLsizeiptr bytes) {
+	// Called from inside whatever allocation went over, often mid-frame with
+	// the arrays already bound, so nothing is deleted here. The debt is paid
+	// by the next Update(), before anything is bound. Streaming's own
+	// allocations aren't owed back.
+	if (library && !updating) {
+		owedBytes += bytes;
+	}
+	return 0;
+}
+
+void TextureStreamer::ClearTextureStreamer() {
+	if (evictionCallback != 0) {
+		GpuMemory::RemoveEvictionCallback(evictionCallback);
+		evictionCallback = 0;
+	}
+	library = nullptr;
+	owedBytes = 0;
+	startLevels.clear();
+	wantedLevels.clear();
+	framesTooFine.clear();
+	stats = StreamStats();
+}
+
+TextureStreamer::~TextureStreamer() {
+	ClearTextureStreamer();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "DrawBatch.h"
+#include "FramePacket.h"
+#include "MaterialRegistry.h"
+#include "TextureLibrary.h"
+
+// Moves a streamed TextureLibrary's arrays between mip levels by what the
+// screen needs, under a GPU memory budget.
+//
+// Every visible draw asks for the level its texture is sampled at from its
+// closest point: the mesh's UV density scaled by the draw's size gives UV
+// per world unit, the projection gives world units per pixel, and the log2
+// of texels per pixel is the level trilinear filtering reads. An array holds
+// the finest level any of its layers asked for (layers share storage).
+// Arrays nothing asked for fall back to their start level.
+//
+// When the wanted levels don't fit the budget, every array is coarsened by
+// the same bias until they do. Arrays get finer one level per frame, as far
+// as the upload allowance stretches, and only get coarser once they've been
+// finer than needed for DROP_DELAY_FRAMES, so a turn of the camera doesn't
+// throw away what it will need again a moment later.
+//
+// The budget streaming works to each frame is the configured one, cut down to
+// what the global GpuMemory budget leaves beside everything else. Over it,
+// arrays are coarsened straight away rather than after the delay.
+//
+// Registered as a GpuMemory eviction callback too. That can run mid-frame,
+// after the arrays are bound, so it only records what it owes; the next
+// Update() coarsens enough to pay it back.
+//
+// Render thread only.
+class TextureStreamer {
+public:
+	struct StreamStats {
+		GLsizeiptr residentBytes;
+		GLsizeiptr wantedBytes;  // at the wanted levels, before the bias
+		GLsizeiptr budgetBytes;  // after pressure from the global budget
+		GLsizeiptr uploadedBytes;
+		GLuint bias;
+		unsigned int levelsIn;
+		unsigned int levelsOut;
+	};
+
+	static const unsigned int DROP_DELAY_FRAMES = 60;
+
+	TextureStreamer();
+
+	bool CreateTextureStreamer(TextureLibrary& textureLibrary, GLsizeiptr budgetBytes, GLsizeiptr uploadBytesPerFrame);
+
+	void Update(const std::vector<DrawPacket>& draws, const DrawBatch& batch, const MaterialRegistry& materials,
+		const glm::vec3& eyePosition, const glm::mat4& projection, GLsizei viewportHeight);
+
+	// GpuMemory eviction: records bytes for the next Update() to free and
+	// returns 0, since nothing is freed yet.
+	GLsizeiptr Evict(GLsizeiptr bytes);
+
+	StreamStats GetLastStats() const { return stats; }
+
+	void ClearTextureStreamer();
+
+	~TextureStreamer();
+
+private:
+	TextureLibrary* library;
+	GLsizeiptr budget;
+	GLsizeiptr uploadBudget;
+	unsigned int evictionCallback;
+	bool updating;
+	GLsizeiptr owedBytes;
+
+	std::vector<GLuint> startLevels;
+	std::vector<GLuint> wantedLevels;
+	std::vector<unsigned int> framesTooFine;
+
+	StreamStats stats;
+
+	GLsizeiptr ResidentBytes() const;
+	GLsizeiptr PressureBudget();
+	GLsizeiptr TotalBytes(GLuint bias) const;
+};
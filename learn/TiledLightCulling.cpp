@@ -0,0 +1,131 @@
+#include "TiledLightCulling.h"
+#include <stdio.h>
+#include <string.h>
+#include "GLState.h"
+#include "GpuMemory.h"
+
+static const char* cullComputeShader = "tileCullCompute.glsl";
+
+TiledLightCulling::TiledLightCulling() {
+	tileBuffer = 0;
+	tileCountX = 0;
+	tileCountY = 0;
+
+	lightBuffer = 0;
+	lightOffset = 0;
+	lightBytes = 0;
+	lightCount = 0;
+	lightsDropped = false;
+
+	uniformView = 0;
+	uniformInverseProjection = 0;
+	uniformLightCount = 0;
+	uniformScreenSize = 0;
+	width = 0;
+	height = 0;
+}
+
+bool TiledLightCulling::CreateTiledLightCulling(GLsizei screenWidth, GLsizei screenHeight) {
+	ClearTiledLightCulling();
+
+	cullShader.CreateComputeFromFile(cullComputeShader);
+	if (cullShader.GetShaderID() == 0) {
+		return false;
+	}
+
+	uniformView = cullShader.GetUniformLocation("view");
+	uniformInverseProjection = cullShader.GetUniformLocation("inverseProjection");
+	uniformLightCount = cullShader.GetUniformLocation("lightCount");
+	uniformScreenSize = cullShader.GetUniformLocation("screenSize");
+
+	CreateTileBuffer(screenWidth, screenHeight);
+
+	return true;
+}
+
+void TiledLightCulling::Resize(GLsizei screenWidth, GLsizei screenHeight) {
+	if (cullShader.GetShaderID() == 0 || (screenWidth == width && screenHeight == height)) {
+		return;
+	}
+	GpuMemory::DeleteBuffer(tileBuffer);
+	CreateTileBuffer(screenWidth, screenHeight);
+}
+
+void TiledLightCulling::CreateTileBuffer(GLsizei screenWidth, GLsizei screenHeight) {
+	width = screenWidth;
+	height = screenHeight;
+	tileCountX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tileCountY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	GLsizeiptr tileBytes = sizeof(GLuint) * (MAX_LIGHTS_PER_TILE + 1) * tileCountX * tileCountY;
+	tileBuffer = GpuMemory::CreateBuffer(GPU_MEMORY_DYNAMIC, "tile light lists", tileBytes, nullptr, 0);
+}
+
+bool TiledLightCulling::UploadLights(RingBuffer& ring, const LightData* sourceLights, unsigned int count) {
+	lightCount = count;
+	if (lightCount > MAX_LIGHTS) {
+		if (!lightsDropped) {
+			printf("%u lights exceed the culling limit of %d, dropping the rest\n", lightCount, MAX_LIGHTS);
+			lightsDropped = true;
+		}
+		lightCount = MAX_LIGHTS;
+	}
+
+	// Always reserve one record so the binding is never empty.
+	lightBytes = sizeof(LightData) * (lightCount > 0 ? lightCount : 1);
+	LightData* lights = static_cast<LightData*>(ring.Allocate(lightBytes, ring.GetStorageAlignment(), &lightOffset));
+	if (!lights) {
+		printf("Light buffer doesn't fit the frame ring, skipping tiled lights this frame\n");
+		lightCount = 0;
+		lightBuffer = 0;
+		return false;
+	}
+	lightBuffer = ring.GetBufferID();
+
+	memcpy(lights, sourceLights, sizeof(LightData) * lightCount);
+
+	return true;
+}
+
+void TiledLightCulling::Cull(GLuint depthTexture, const glm::mat4& view, const glm::mat4& projection) {
+	if (lightBuffer == 0) {
+		return;
+	}
+
+	cullShader.UseShader();
+	glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(uniformInverseProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+	glUniform1ui(uniformLightCount, lightCount);
+	glUniform2i(uniformScreenSize, width, height);
+
+	GLState::BindTexture(TILE_DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, depthTexture);
+	UseTiles();
+
+	glDispatchCompute(tileCountX, tileCountY, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// The depth texture stays attached to the target the shading pass draws
+	// into, so don't leave it bound as a sampler.
+	GLState::BindTexture(TILE_DEPTH_TEXTURE_UNIT, GL_TEXTURE_2D, 0);
+}
+
+void TiledLightCulling::UseTiles() {
+	if (lightBuffer != 0) {
+		GLState::BindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_DATA_BINDING, lightBuffer, lightOffset, lightBytes);
+	}
+	GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_LIGHT_BINDING, tileBuffer);
+}
+
+void TiledLightCulling::ClearTiledLightCulling() {
+	GpuMemory::DeleteBuffer(tileBuffer);
+	tileCountX = 0;
+	tileCountY = 0;
+	lightBuffer = 0;
+	lightCount = 0;
+	lightsDropped = false;
+	cullShader.ClearShader();
+}
+
+TiledLightCulling::~TiledLightCulling() {
+	ClearTiledLightCulling();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "CommonValues.h"
+#include "Light.h"
+#include "RingBuffer.h"
+#include "Shader.h"
+
+// Forward+ light culling. A compute pass reads the scene depth, finds the
+// depth range of every TILE_SIZE x TILE_SIZE screen tile and writes the list
+// of point and spot lights whose range reaches into that tile. The forward
+// shader then only loops over its own tile's list.
+//
+// Tile buffer layout, per tile: light count, then MAX_LIGHTS_PER_TILE indices
+// into the light buffer.
+class TiledLightCulling {
+public:
+	TiledLightCulling();
+
+	bool CreateTiledLightCulling(GLsizei screenWidth, GLsizei screenHeight);
+	// Regrows the tile lists when the screen size changes.
+	void Resize(GLsizei screenWidth, GLsizei screenHeight);
+
+	// Lights go into the frame ring; call once per frame before Cull().
+	// shadowIndex in each record is passed through untouched.
+	bool UploadLights(RingBuffer& ring, const LightData* lights, unsigned int count);
+	void Cull(GLuint depthTexture, const glm::mat4& view, const glm::mat4& projection);
+	// Binds the light and tile buffers for the shading pass.
+	void UseTiles();
+
+	GLuint GetTileCountX() const { return tileCountX; }
+	GLuint GetTileCountY() const { return tileCountY; }
+	GLuint GetLightCount() const { return lightCount; }
+
+	void ClearTiledLightCulling();
+
+	~TiledLightCulling();
+
+private:
+	Shader cullShader;
+	GLuint tileBuffer;
+	GLuint tileCountX, tileCountY;
+
+	GLuint lightBuffer;
+	GLintptr lightOffset;
+	GLsizeiptr lightBytes;
+	GLuint lightCount;
+	// The overflow is reported once, not every frame it persists.
+	bool lightsDropped;
+
+	GLuint uniformView, uniformInverseProjection, uniformLightCount, uniformScreenSize;
+	GLsizei width, height;
+
+	void CreateTileBuffer(GLsizei screenWidth, GLsizei screenHeight);
+};
@@ -0,0 +1,190 @@
+#include "TransformMath.h"
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_MATH_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Scalar path, also used for the last few nodes the SSE path can't group in fours.
+static inline void StoreLocalMatrix(const LocalTransformArrays& l, size_t i, glm::mat4& out) {
+	float x = l.rotationX[i], y = l.rotationY[i], z = l.rotationZ[i], w = l.rotationW[i];
+	float sx = l.scaleX[i], sy = l.scaleY[i], sz = l.scaleZ[i];
+
+	out[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f);
+	out[1] = glm::vec4(2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f);
+	out[2] = glm::vec4(2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f);
+	out[3] = glm::vec4(l.positionX[i], l.positionY[i], l.positionZ[i], 1.0f);
+}
+
+#ifdef TRANSFORM_MATH_SSE
+
+static inline __m128 Cross(__m128 a, __m128 b) {
+	__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline __m128 Dot3(__m128 a, __m128 b) {
+	__m128 m = _mm_mul_ps(a, b);
+	__m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 x = _mm_shuffle_ps(m, m, _MM_SHUFFLE(0, 0, 0, 0));
+	return _mm_add_ps(_mm_add_ps(x, y), z);
+}
+
+void ComputeDrawTransforms(const glm::mat4& viewProjection, const glm::mat4* models,
+	size_t count, DrawTransform* out, size_t outStride) {
+	const float* vp = &viewProjection[0][0];
+	__m128 vp0 = _mm_loadu_ps(vp + 0);
+	__m128 vp1 = _mm_loadu_ps(vp + 4);
+	__m128 vp2 = _mm_loadu_ps(vp + 8);
+	__m128 vp3 = _mm_loadu_ps(vp + 12);
+	__m128 w0 = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+	unsigned char* target = reinterpret_cast<unsigned char*>(out);
+	for (size_t i = 0; i < count; i++, target += outStride) {
+		const float* m = &models[i][0][0];
+		DrawTransform* t = reinterpret_cast<DrawTransform*>(target);
+		float* model = &t->model[0][0];
+		float* mvp = &t->mvp[0][0];
+
+		__m128 c[4];
+		for (int col = 0; col < 4; col++) {
+			c[col] = _mm_loadu_ps(m + col * 4);
+			_mm_storeu_ps(model + col * 4, c[col]);
+
+			// Column col of vp * m is vp applied to column col of m.
+			__m128 x = _mm_shuffle_ps(c[col], c[col], _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 y = _mm_shuffle_ps(c[col], c[col], _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 z = _mm_shuffle_ps(c[col], c[col], _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 w = _mm_shuffle_ps(c[col], c[col], _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 r = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(vp0, x), _mm_mul_ps(vp1, y)),
+				_mm_add_ps(_mm_mul_ps(vp2, z), _mm_mul_ps(vp3, w)));
+			_mm_storeu_ps(mvp + col * 4, r);
+		}
+
+		// inverse-transpose of the upper 3x3 is its cofactor matrix over the
+		// determinant; the cofactor columns are cross products of the columns.
+		__m128 a = _mm_and_ps(c[0], w0);
+		__m128 b = _mm_and_ps(c[1], w0);
+		__m128 d = _mm_and_ps(c[2], w0);
+		__m128 bxd = Cross(b, d);
+		__m128 det = Dot3(a, bxd);
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+		_mm_storeu_ps(t->normalMatrix[0], _mm_mul_ps(bxd, invDet));
+		_mm_storeu_ps(t->normalMatrix[1], _mm_mul_ps(Cross(d, a), invDet));
+		_mm_storeu_ps(t->normalMatrix[2], _mm_mul_ps(Cross(a, b), invDet));
+	}
+}
+
+
+void ComputeLocalMatrices(const LocalTransformArrays& l, size_t begin, size_t end, glm::mat4* out) {
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(l.rotationX + i);
+		__m128 y = _mm_loadu_ps(l.rotationY + i);
+		__m128 z = _mm_loadu_ps(l.rotationZ + i);
+		__m128 w = _mm_loadu_ps(l.rotationW + i);
+		__m128 sx = _mm_loadu_ps(l.scaleX + i);
+		__m128 sy = _mm_loadu_ps(l.scaleY + i);
+		__m128 sz = _mm_loadu_ps(l.scaleZ + i);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// Each register holds one matrix element for four nodes.
+		__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		__m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		__m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		__m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		__m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		__m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		__m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		__m128 c3x = _mm_loadu_ps(l.positionX + i);
+		__m128 c3y = _mm_loadu_ps(l.positionY + i);
+		__m128 c3z = _mm_loadu_ps(l.positionZ + i);
+		__m128 c0w = zero, c1w = zero, c2w = zero, c3w = one;
+
+		// Transposing turns "element e of nodes 0-3" into "column of node n".
+		_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+		_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+		_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+		_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+		__m128 columns[4][4] = {
+			{ c0x, c1x, c2x, c3x },
+			{ c0y, c1y, c2y, c3y },
+			{ c0z, c1z, c2z, c3z },
+			{ c0w, c1w, c2w, c3w },
+		};
+		for (int n = 0; n < 4; n++) {
+			float* m = &out[i + n][0][0];
+			for (int col = 0; col < 4; col++) {
+				_mm_storeu_ps(m + col * 4, columns[n][col]);
+			}
+		}
+	}
+	for (; i < end; i++) {
+		StoreLocalMatrix(l, i, out[i]);
+	}
+}
+
+void MultiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+	const float* pa = &a[0][0];
+	const float* pb = &b[0][0];
+	float* po = &out[0][0];
+	__m128 a0 = _mm_loadu_ps(pa + 0);
+	__m128 a1 = _mm_loadu_ps(pa + 4);
+	__m128 a2 = _mm_loadu_ps(pa + 8);
+	__m128 a3 = _mm_loadu_ps(pa + 12);
+	for (int col = 0; col < 4; col++) {
+		__m128 c = _mm_loadu_ps(pb + col * 4);
+		__m128 x = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 y = _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 z = _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 w = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(po + col * 4, _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(a0, x), _mm_mul_ps(a1, y)),
+			_mm_add_ps(_mm_mul_ps(a2, z), _mm_mul_ps(a3, w))));
+	}
+}
+
+#else
+
+void ComputeDrawTransforms(const glm::mat4& viewProjection, const glm::mat4* models,
+	size_t count, DrawTransform* out, size_t outStride) {
+	unsigned char* target = reinterpret_cast<unsigned char*>(out);
+	for (size_t i = 0; i < count; i++, target += outStride) {
+		DrawTransform* t = reinterpret_cast<DrawTransform*>(target);
+		t->model = models[i];
+		t->mvp = viewProjection * models[i];
+
+		glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(models[i])));
+		for (int col = 0; col < 3; col++) {
+			t->normalMatrix[col][0] = normal[col][0];
+			t->normalMatrix[col][1] = normal[col][1];
+			t->normalMatrix[col][2] = normal[col][2];
+			t->normalMatrix[col][3] = 0.0f;
+		}
+	}
+}
+
+void ComputeLocalMatrices(const LocalTransformArrays& l, size_t begin, size_t end, glm::mat4* out) {
+	for (size_t i = begin; i < end; i++) {
+		StoreLocalMatrix(l, i, out[i]);
+	}
+}
+
+void MultiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+	out = a * b;
+}
+
+#endif
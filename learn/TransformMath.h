@@ -0,0 +1,40 @@
+#pragma once
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+// Per-object transform data the vertex shader used to derive itself for every
+// vertex. Matches the layout the shaders expect (std430: the mat3 columns are
+// padded to vec4).
+struct DrawTransform {
+	glm::mat4 model;
+	glm::mat4 mvp;
+	float normalMatrix[3][4];
+};
+
+// Fills count transforms from count model matrices: mvp = viewProjection * model
+// and normalMatrix = transpose(inverse(mat3(model))). out may be write-combined
+// GPU memory; it is written front to back and never read.
+void ComputeDrawTransforms(const glm::mat4& viewProjection, const glm::mat4* models,
+	size_t count, DrawTransform* out, size_t outStride);
+
+// Local transforms as separate arrays per component (structure of arrays):
+// position, rotation quaternion (x, y, z, w) and scale.
+struct LocalTransformArrays {
+	const float* positionX;
+	const float* positionY;
+	const float* positionZ;
+	const float* rotationX;
+	const float* rotationY;
+	const float* rotationZ;
+	const float* rotationW;
+	const float* scaleX;
+	const float* scaleY;
+	const float* scaleZ;
+};
+
+// out[i] = translate * rotate * scale for i in [begin, end), four at a time
+// where SSE is available.
+void ComputeLocalMatrices(const LocalTransformArrays& locals, size_t begin, size_t end, glm::mat4* out);
+
+// out = a * b. out may not alias a or b.
+void MultiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
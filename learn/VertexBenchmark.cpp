@@ -0,0 +1,182 @@
+#include "VertexBenchmark.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "DrawBatch.h"
+#include "RingBuffer.h"
+#include "Shader.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* cpuMatrixVertexShader = "vertexShader.glsl";
+static const char* perVertexMatrixVertexShader = "perVertexMatrixVertex.glsl";
+static const char* benchmarkFragmentShader = "vertexBenchmarkFragment.glsl";
+
+// 129 x 513 vertices, 256k triangles per sphere.
+static const unsigned int SPHERE_RINGS = 128;
+static const unsigned int SPHERE_SEGMENTS = 512;
+static const int GRID_SIDE = 8;
+static const int WARMUP_FRAMES = 10;
+static const int MEASURED_FRAMES = 50;
+static const GLsizeiptr RING_SECTION_SIZE = 1024 * 1024;
+static const unsigned int RING_SECTIONS = 3;
+
+enum VertexPath {
+	PATH_CPU_MATRICES,
+	PATH_PER_VERTEX_MATRICES,
+	PATH_COUNT
+};
+
+static const char* pathNames[PATH_COUNT] = { "CPU matrices", "per-vertex matrices" };
+
+struct PathTimes {
+	double totalMs;
+	double bestMs;
+};
+
+static double ElapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void CreateSphere(std::vector<GLfloat>& vertices, std::vector<unsigned int>& indices) {
+	const float pi = 3.14159265f;
+	for (unsigned int ring = 0; ring <= SPHERE_RINGS; ring++) {
+		float theta = pi * ring / SPHERE_RINGS;
+		for (unsigned int segment = 0; segment <= SPHERE_SEGMENTS; segment++) {
+			float phi = 2.0f * pi * segment / SPHERE_SEGMENTS;
+			float x = sinf(theta) * cosf(phi);
+			float y = cosf(theta);
+			float z = sinf(theta) * sinf(phi);
+			GLfloat vertex[8] = {
+				x, y, z,
+				static_cast<float>(segment) / SPHERE_SEGMENTS, static_cast<float>(ring) / SPHERE_RINGS,
+				x, y, z
+			};
+			vertices.insert(vertices.end(), vertex, vertex + 8);
+		}
+	}
+
+	unsigned int row = SPHERE_SEGMENTS + 1;
+	for (unsigned int ring = 0; ring < SPHERE_RINGS; ring++) {
+		for (unsigned int segment = 0; segment < SPHERE_SEGMENTS; segment++) {
+			unsigned int first = ring * row + segment;
+			unsigned int quad[6] = { first, first + row, first + 1, first + 1, first + row, first + row + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+// Rotated and unevenly scaled, so the inverse-transpose is a real one.
+static glm::mat4 GridModel(int x, int z) {
+	glm::mat4 model(1.0f);
+	model = glm::translate(model, glm::vec3((x - GRID_SIDE / 2) * 3.0f, 0.0f, -z * 3.0f - 5.0f));
+	model = glm::rotate(model, 0.3f * (x + z), glm::normalize(glm::vec3(1.0f, 2.0f, 0.5f)));
+	return glm::scale(model, glm::vec3(1.0f + 0.1f * x, 1.0f, 1.0f + 0.1f * z));
+}
+
+void RunVertexBenchmark(JobSystem& jobs) {
+	std::vector<GLfloat> vertices;
+	std::vector<unsigned int> indices;
+	CreateSphere(vertices, indices);
+
+	DrawBatch batch;
+	batch.SetJobSystem(&jobs);
+	unsigned int sphere = batch.AddMesh(vertices.data(), indices.data(),
+		static_cast<unsigned int>(vertices.size()), static_cast<unsigned int>(indices.size()));
+
+	RingBuffer ring;
+	if (!ring.CreateRingBuffer(RING_SECTION_SIZE, RING_SECTIONS)) {
+		return;
+	}
+
+	Shader shaders[PATH_COUNT];
+	shaders[PATH_CPU_MATRICES].CreateFromFiles(cpuMatrixVertexShader, benchmarkFragmentShader);
+	shaders[PATH_PER_VERTEX_MATRICES].CreateFromFiles(perVertexMatrixVertexShader, benchmarkFragmentShader);
+
+	GLuint timeQueries[PATH_COUNT];
+	glGenQueries(PATH_COUNT, timeQueries);
+
+	glm::mat4 projection = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 8.0f, 10.0f), glm::vec3(0.0f, 0.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = projection * view;
+
+	unsigned long long vertexCount = static_cast<unsigned long long>(vertices.size() / 8) * GRID_SIDE * GRID_SIDE;
+	printf("Vertex stage benchmark, %d draws of %u vertices (%llu vertices a frame)\n",
+		GRID_SIDE * GRID_SIDE, static_cast<unsigned int>(vertices.size() / 8), vertexCount);
+
+	PathTimes times[PATH_COUNT] = {};
+	double uploadMs = 0.0;
+	glEnable(GL_RASTERIZER_DISCARD);
+	for (int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++) {
+		ring.BeginFrame();
+		batch.Begin();
+		for (int z = 0; z < GRID_SIDE; z++) {
+			for (int x = 0; x < GRID_SIDE; x++) {
+				batch.Submit(sphere, GridModel(x, z), 0);
+			}
+		}
+		Clock::time_point uploadStart = Clock::now();
+		bool uploaded = batch.Upload(ring, viewProjection);
+		double frameUploadMs = ElapsedMs(uploadStart);
+		if (!uploaded) {
+			ring.EndFrame();
+			break;
+		}
+
+		// Alternating the order keeps either path from always running on a
+		// GPU the other one has just warmed up.
+		for (int i = 0; i < PATH_COUNT; i++) {
+			int path = (i + frame) % PATH_COUNT;
+			shaders[path].UseShader();
+			if (path == PATH_PER_VERTEX_MATRICES) {
+				glUniformMatrix4fv(shaders[path].GetProjectionLocation(), 1, GL_FALSE, glm::value_ptr(projection));
+				glUniformMatrix4fv(shaders[path].GetViewLocation(), 1, GL_FALSE, glm::value_ptr(view));
+			}
+			glBeginQuery(GL_TIME_ELAPSED, timeQueries[path]);
+			batch.Render();
+			glEndQuery(GL_TIME_ELAPSED);
+		}
+		ring.EndFrame();
+
+		if (frame < WARMUP_FRAMES) {
+			continue;
+		}
+		uploadMs += frameUploadMs;
+		for (int path = 0; path < PATH_COUNT; path++) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(timeQueries[path], GL_QUERY_RESULT, &elapsed);
+			double ms = elapsed / 1.0e6;
+			times[path].totalMs += ms;
+			if (times[path].bestMs == 0.0 || ms < times[path].bestMs) {
+				times[path].bestMs = ms;
+			}
+		}
+	}
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	printf("%22s %12s %12s\n", "path", "mean ms", "best ms");
+	for (int path = 0; path < PATH_COUNT; path++) {
+		printf("%22s %12.3f %12.3f\n", pathNames[path], times[path].totalMs / MEASURED_FRAMES, times[path].bestMs);
+	}
+	double cpuMs = times[PATH_CPU_MATRICES].totalMs;
+	double perVertexMs = times[PATH_PER_VERTEX_MATRICES].totalMs;
+	if (perVertexMs > 0.0) {
+		printf("CPU matrices save %.1f%% of the vertex stage; computing them in Upload takes %.3f ms a frame\n",
+			100.0 * (perVertexMs - cpuMs) / perVertexMs, uploadMs / MEASURED_FRAMES);
+	}
+
+	glDeleteQueries(PATH_COUNT, timeQueries);
+	for (int path = 0; path < PATH_COUNT; path++) {
+		shaders[path].ClearShader();
+	}
+	batch.ClearBatch();
+	ring.ClearRingBuffer();
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "JobSystem.h"
+
+// Measures what moving mvp and normal matrices to the CPU saves in the vertex
+// stage. A grid of high-poly spheres goes through DrawBatch and is drawn both
+// with vertexShader.glsl and with perVertexMatrixVertex.glsl, the old shader
+// that rebuilds projection * view * model and the inverse-transpose per
+// vertex. Primitives are discarded before rasterisation, so the GPU times are
+// the vertex stage alone. Needs a current context; run the program with
+// --vertex-benchmark.
+void RunVertexBenchmark(JobSystem& jobs);
@@ -0,0 +1,448 @@
+#include "VirtualTexture.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+#include "CommonValues.h"
+#include "CpuProfiler.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+static const char* feedbackVertexShader = "vertexShader.glsl";
+static const char* feedbackFragmentShader = "virtualFeedbackFragment.glsl";
+
+// Set on every pixel that asked for a page, so zero means "no request".
+static const GLuint FEEDBACK_VALID_BIT = 0x80000000u;
+
+VirtualTexture::VirtualTexture() {
+	uniformLodBias = 0;
+	pageTable = 0;
+	pageCache = 0;
+	frame = 0;
+	feedbackWidth = 0;
+	feedbackHeight = 0;
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		readbacks[i].buffer = 0;
+		readbacks[i].fence = 0;
+		readbacks[i].count = 0;
+	}
+	readbackIndex = 0;
+	loadingPage = NO_PAGE;
+	stopping = false;
+	stats = VirtualTextureStats();
+}
+
+bool VirtualTexture::CreateVirtualTexture(const char* path, GLsizei screenWidth, GLsizei screenHeight, JobSystem& jobs) {
+	ClearVirtualTexture();
+
+	FILE* existing = fopen(path, "rb");
+	if (existing) {
+		fclose(existing);
+	}
+	else {
+		printf("%s doesn't exist, generating a terrain for it\n", path);
+		if (!VirtualTextureFile::Generate(path, GENERATED_PAGES_PER_SIDE, jobs)) {
+			return false;
+		}
+	}
+	if (!source.Open(path)) {
+		return false;
+	}
+	// The shaders have the page layout built in.
+	if (source.GetPageSize() != VirtualTextureFile::PAGE_SIZE || source.GetBorder() != VirtualTextureFile::PAGE_BORDER
+		|| source.GetPagesPerSide(0) > MAX_PAGES_PER_SIDE) {
+		printf("%s needs %u texel pages with a %u texel border, at most %u across\n", path,
+			VirtualTextureFile::PAGE_SIZE, VirtualTextureFile::PAGE_BORDER, MAX_PAGES_PER_SIDE);
+		source.Close();
+		return false;
+	}
+
+	GLuint levels = source.GetLevelCount();
+	GLsizei pagesPerSide = static_cast<GLsizei>(source.GetPagesPerSide(0));
+	pageTable = GpuMemory::CreateTexture(GPU_MEMORY_TEXTURE, "virtual texture page table", GL_TEXTURE_2D,
+		levels, GL_RGBA8UI, pagesPerSide, pagesPerSide, 1);
+	glTextureParameteri(pageTable, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(pageTable, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	tableLevels.resize(levels);
+	for (GLuint level = 0; level < levels; level++) {
+		tableLevels[level].assign(static_cast<size_t>(source.GetPagesPerSide(level)) * source.GetPagesPerSide(level) * 4, 0);
+	}
+
+	GLsizei cacheSize = static_cast<GLsizei>(CACHE_PAGES_PER_SIDE * source.GetStoredPageSize());
+	pageCache = GpuMemory::CreateTexture(GPU_MEMORY_TEXTURE, "virtual texture page cache", GL_TEXTURE_2D,
+		1, GL_RGBA8, cacheSize, cacheSize, 1);
+	glTextureParameteri(pageCache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(pageCache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(pageCache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(pageCache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	CacheSlot empty = { NO_PAGE, 0, false };
+	slots.assign(CACHE_PAGES_PER_SIDE * CACHE_PAGES_PER_SIDE, empty);
+
+	CreateReadbacks(screenWidth, screenHeight);
+	feedbackShader.CreateFromFiles(feedbackVertexShader, feedbackFragmentShader);
+	uniformLodBias = feedbackShader.GetUniformLocation("lodBias");
+
+	// Everything falls back to the coarsest page, so it's in before anything else.
+	std::vector<unsigned char> texels(source.GetPageBytes());
+	if (!source.ReadPage(levels - 1, 0, 0, texels.data()) || !UploadPage(PageKey(levels - 1, 0, 0), texels.data(), true)) {
+		printf("Failed to read the coarsest page of %s\n", path);
+		ClearVirtualTexture();
+		return false;
+	}
+	// The coarsest page covers the whole table, so this fills every entry.
+	UpdatePageTable();
+
+	stopping = false;
+	loader = std::thread(&VirtualTexture::RunLoader, this);
+
+	printf("Virtual texture %s: %u x %u texels in %u levels, %u page cache slots\n", path,
+		GetWidth(), GetWidth(), levels, static_cast<unsigned int>(slots.size()));
+	return true;
+}
+
+void VirtualTexture::Update() {
+	if (!IsAvailable()) {
+		return;
+	}
+	PROFILE_ZONE("VirtualTexture::Update");
+	frame++;
+
+	ReadFeedback();
+	UploadPages();
+	UpdatePageTable();
+}
+
+void VirtualTexture::ReadFeedback() {
+	// Oldest first; once one isn't ready the later ones won't be either.
+	bool arrived = false;
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		FeedbackReadback& readback = readbacks[(readbackIndex + i) % QUERY_FRAMES];
+		if (!readback.fence) {
+			continue;
+		}
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+		feedback.resize(readback.count);
+		glGetNamedBufferSubData(readback.buffer, 0, readback.count * sizeof(GLuint), feedback.data());
+		arrived = true;
+	}
+	if (!arrived) {
+		return;
+	}
+
+	requested.clear();
+	for (GLuint request : feedback) {
+		if (request & FEEDBACK_VALID_BIT) {
+			requested.push_back(request & ~FEEDBACK_VALID_BIT);
+		}
+	}
+	std::sort(requested.begin(), requested.end());
+	requested.erase(std::unique(requested.begin(), requested.end()), requested.end());
+	QueueLoads();
+}
+
+void VirtualTexture::QueueLoads() {
+	GLuint levels = source.GetLevelCount();
+	std::vector<uint32_t> missing;
+	stats.pagesRequested = static_cast<unsigned int>(requested.size());
+	stats.pagesMissing = 0;
+	for (uint32_t page : requested) {
+		uint32_t level = KeyLevel(page);
+		uint32_t x = KeyX(page);
+		uint32_t y = KeyY(page);
+		if (level >= levels || x >= source.GetPagesPerSide(level) || y >= source.GetPagesPerSide(level)) {
+			continue;
+		}
+		if (residentPages.find(page) == residentPages.end()) {
+			stats.pagesMissing++;
+		}
+
+		// The page's ancestors are what it falls back to, so they count as used too.
+		for (; level < levels; level++, x >>= 1, y >>= 1) {
+			uint32_t key = PageKey(level, x, y);
+			std::unordered_map<uint32_t, unsigned int>::iterator resident = residentPages.find(key);
+			if (resident != residentPages.end()) {
+				slots[resident->second].lastUsed = frame;
+			}
+			else {
+				missing.push_back(key);
+			}
+		}
+	}
+
+	// Keys sort by level, so the coarsest pages end up at the back and load first.
+	std::sort(missing.begin(), missing.end());
+	missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+	std::lock_guard<std::mutex> guard(loaderLock);
+	missing.erase(std::remove_if(missing.begin(), missing.end(), [this](uint32_t key) {
+		if (key == loadingPage) {
+			return true;
+		}
+		for (const LoadedPage& loaded : loadedPages) {
+			if (loaded.page == key) {
+				return true;
+			}
+		}
+		return false;
+	}), missing.end());
+	// Loaded pages still waiting for upload count against the limit, so the
+	// loader can't run ahead of what uploads keep up with.
+	size_t room = loadedPages.size() < MAX_QUEUED_LOADS ? MAX_QUEUED_LOADS - loadedPages.size() : 0;
+	if (missing.size() > room) {
+		missing.erase(missing.begin(), missing.end() - room);
+	}
+	// Replaces what's still queued: pages the view has moved away from aren't loaded.
+	loadQueue.swap(missing);
+	loadQueued.notify_one();
+}
+
+void VirtualTexture::UploadPages() {
+	std::vector<LoadedPage> pages;
+	{
+		std::lock_guard<std::mutex> guard(loaderLock);
+		size_t count = loadedPages.size() < MAX_UPLOADS_PER_FRAME ? loadedPages.size() : MAX_UPLOADS_PER_FRAME;
+		for (size_t i = 0; i < count; i++) {
+			pages.push_back(std::move(loadedPages[i]));
+		}
+		loadedPages.erase(loadedPages.begin(), loadedPages.begin() + count);
+	}
+
+	for (const LoadedPage& page : pages) {
+		if (residentPages.find(page.page) == residentPages.end() && UploadPage(page.page, page.texels.data(), false)) {
+			stats.pagesUploaded++;
+		}
+	}
+}
+
+bool VirtualTexture::UploadPage(uint32_t page, const unsigned char* texels, bool pinned) {
+	// A free slot, or else the one requested longest ago. Pages this frame's
+	// feedback asked for stay; a page that doesn't fit is asked for again later.
+	int chosen = -1;
+	for (size_t i = 0; i < slots.size(); i++) {
+		const CacheSlot& slot = slots[i];
+		if (slot.pinned) {
+			continue;
+		}
+		if (slot.page == NO_PAGE) {
+			chosen = static_cast<int>(i);
+			break;
+		}
+		if (slot.lastUsed < frame && (chosen < 0 || slot.lastUsed < slots[chosen].lastUsed)) {
+			chosen = static_cast<int>(i);
+		}
+	}
+	if (chosen < 0) {
+		return false;
+	}
+
+	CacheSlot& slot = slots[chosen];
+	if (slot.page != NO_PAGE) {
+		residentPages.erase(slot.page);
+		changedPages.push_back(slot.page);
+		stats.pagesEvicted++;
+	}
+
+	GLsizei stored = static_cast<GLsizei>(source.GetStoredPageSize());
+	glTextureSubImage2D(pageCache, 0, (chosen % CACHE_PAGES_PER_SIDE) * stored, (chosen / CACHE_PAGES_PER_SIDE) * stored,
+		stored, stored, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+	slot.page = page;
+	slot.lastUsed = frame;
+	slot.pinned = pinned;
+	residentPages[page] = static_cast<unsigned int>(chosen);
+	changedPages.push_back(page);
+	return true;
+}
+
+void VirtualTexture::UpdatePageTable() {
+	// Only entries under a changed page can change: its own and, level by
+	// level, the square of finer entries inside it that may fall back to it.
+	// Keys sort by level first, so coarser changes go first and every entry
+	// copies a parent that's already up to date.
+	std::sort(changedPages.begin(), changedPages.end(), std::greater<uint32_t>());
+	changedPages.erase(std::unique(changedPages.begin(), changedPages.end()), changedPages.end());
+	for (uint32_t page : changedPages) {
+		GLuint pageLevel = KeyLevel(page);
+		for (GLuint level = pageLevel + 1; level-- > 0;) {
+			GLuint shift = pageLevel - level;
+			UpdatePageTableRegion(level, KeyX(page) << shift, KeyY(page) << shift, 1u << shift);
+		}
+	}
+	changedPages.clear();
+}
+
+void VirtualTexture::UpdatePageTableRegion(GLuint level, GLuint firstX, GLuint firstY, GLuint size) {
+	GLuint pages = source.GetPagesPerSide(level);
+	bool coarsest = level + 1 == source.GetLevelCount();
+	std::vector<GLubyte>& entries = tableLevels[level];
+	tableRegion.resize(static_cast<size_t>(size) * size * 4);
+	for (GLuint y = firstY; y < firstY + size; y++) {
+		for (GLuint x = firstX; x < firstX + size; x++) {
+			GLubyte* entry = &entries[(static_cast<size_t>(y) * pages + x) * 4];
+			std::unordered_map<uint32_t, unsigned int>::const_iterator resident = residentPages.find(PageKey(level, x, y));
+			if (resident != residentPages.end()) {
+				entry[0] = static_cast<GLubyte>(resident->second % CACHE_PAGES_PER_SIDE);
+				entry[1] = static_cast<GLubyte>(resident->second / CACHE_PAGES_PER_SIDE);
+				entry[2] = static_cast<GLubyte>(level);
+				entry[3] = 1;
+			}
+			else if (!coarsest) {
+				memcpy(entry, &tableLevels[level + 1][(static_cast<size_t>(y / 2) * (pages / 2) + x / 2) * 4], 4);
+			}
+			memcpy(&tableRegion[(static_cast<size_t>(y - firstY) * size + x - firstX) * 4], entry, 4);
+		}
+	}
+	glTextureSubImage2D(pageTable, level, firstX, firstY, size, size, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, tableRegion.data());
+}
+
+void VirtualTexture::UseVirtualTexture() {
+	if (!IsAvailable()) {
+		return;
+	}
+	GLState::BindTexture(VIRTUAL_PAGE_TABLE_TEXTURE_UNIT, GL_TEXTURE_2D, pageTable);
+	GLState::BindTexture(VIRTUAL_PAGE_CACHE_TEXTURE_UNIT, GL_TEXTURE_2D, pageCache);
+}
+
+void VirtualTexture::RenderFeedback(DrawBatch& batch, GLuint feedbackTexture) {
+	const GLuint noRequest[4] = { 0, 0, 0, 0 };
+	GLState::Enable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glClearBufferuiv(GL_COLOR, 0, noRequest);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	feedbackShader.UseShader();
+	// Derivatives are FEEDBACK_SCALE times larger than at full resolution.
+	glUniform1f(uniformLodBias, -log2f(static_cast<GLfloat>(FEEDBACK_SCALE)));
+	batch.Render();
+
+	// Still unread after QUERY_FRAMES frames: the GPU is that far behind, so
+	// the old feedback is dropped rather than waited for.
+	FeedbackReadback& readback = readbacks[readbackIndex];
+	if (readback.fence) {
+		glDeleteSync(readback.fence);
+		stats.feedbackDropped++;
+	}
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glGetTextureImage(feedbackTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, readback.count * sizeof(GLuint), nullptr);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readbackIndex = (readbackIndex + 1) % QUERY_FRAMES;
+}
+
+void VirtualTexture::Resize(GLsizei screenWidth, GLsizei screenHeight) {
+	if (!IsAvailable()) {
+		return;
+	}
+	GLsizei width = static_cast<GLsizei>((screenWidth + FEEDBACK_SCALE - 1) / FEEDBACK_SCALE);
+	GLsizei height = static_cast<GLsizei>((screenHeight + FEEDBACK_SCALE - 1) / FEEDBACK_SCALE);
+	if (width == feedbackWidth && height == feedbackHeight) {
+		return;
+	}
+	// Feedback still in flight has the old size; the next readback replaces it.
+	ClearReadbacks();
+	CreateReadbacks(screenWidth, screenHeight);
+}
+
+void VirtualTexture::CreateReadbacks(GLsizei screenWidth, GLsizei screenHeight) {
+	feedbackWidth = static_cast<GLsizei>((screenWidth + FEEDBACK_SCALE - 1) / FEEDBACK_SCALE);
+	feedbackHeight = static_cast<GLsizei>((screenHeight + FEEDBACK_SCALE - 1) / FEEDBACK_SCALE);
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		readbacks[i].count = feedbackWidth * feedbackHeight;
+		readbacks[i].buffer = GpuMemory::CreateBuffer(GPU_MEMORY_DYNAMIC, "virtual texture feedback",
+			readbacks[i].count * sizeof(GLuint), nullptr, GL_CLIENT_STORAGE_BIT);
+	}
+}
+
+void VirtualTexture::ClearReadbacks() {
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		if (readbacks[i].fence) {
+			glDeleteSync(readbacks[i].fence);
+			readbacks[i].fence = 0;
+		}
+		GpuMemory::DeleteBuffer(readbacks[i].buffer);
+		readbacks[i].count = 0;
+	}
+	readbackIndex = 0;
+}
+
+void VirtualTexture::RunLoader() {
+	PROFILE_THREAD("virtual texture loader");
+	std::unique_lock<std::mutex> guard(loaderLock);
+	while (true) {
+		loadQueued.wait(guard, [this]() { return stopping || !loadQueue.empty(); });
+		if (stopping) {
+			return;
+		}
+		LoadedPage loaded;
+		loaded.page = loadQueue.back();
+		loadQueue.pop_back();
+		loadingPage = loaded.page;
+		guard.unlock();
+
+		loaded.texels.resize(source.GetPageBytes());
+		bool read = source.ReadPage(KeyLevel(loaded.page), KeyX(loaded.page), KeyY(loaded.page), loaded.texels.data());
+
+		guard.lock();
+		loadingPage = NO_PAGE;
+		if (read) {
+			loadedPages.push_back(std::move(loaded));
+		}
+		else {
+			printf("Failed to read virtual texture page %u, %u of level %u\n", KeyX(loaded.page), KeyY(loaded.page), KeyLevel(loaded.page));
+		}
+	}
+}
+
+VirtualTexture::VirtualTextureStats VirtualTexture::TakeStats() {
+	stats.residentPages = static_cast<unsigned int>(residentPages.size());
+	{
+		std::lock_guard<std::mutex> guard(loaderLock);
+		stats.loadsPending = static_cast<unsigned int>(loadQueue.size() + loadedPages.size()) + (loadingPage != NO_PAGE ? 1 : 0);
+	}
+
+	VirtualTextureStats taken = stats;
+	stats.pagesUploaded = 0;
+	stats.pagesEvicted = 0;
+	stats.feedbackDropped = 0;
+	return taken;
+}
+
+void VirtualTexture::ClearVirtualTexture() {
+	if (loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(loaderLock);
+			stopping = true;
+		}
+		loadQueued.notify_all();
+		loader.join();
+	}
+	loadQueue.clear();
+	loadedPages.clear();
+	loadingPage = NO_PAGE;
+
+	ClearReadbacks();
+	GpuMemory::DeleteTexture(pageTable);
+	GpuMemory::DeleteTexture(pageCache);
+	feedbackShader.ClearShader();
+
+	slots.clear();
+	residentPages.clear();
+	tableLevels.clear();
+	changedPages.clear();
+	feedback.clear();
+	requested.clear();
+	source.Close();
+	stats = VirtualTextureStats();
+}
+
+VirtualTexture::~VirtualTexture() {
+	ClearVirtualTexture();
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "DrawBatch.h"
+#include "Shader.h"
+#include "VirtualTextureFile.h"
+
+// Sparse virtual texturing: a texture far bigger than GPU memory (read from a
+// VirtualTextureFile) of which only the pages the screen shows are resident.
+//
+// Resident pages live in a fixed-size page cache, one 2D texture of
+// CACHE_PAGES_PER_SIDE^2 page slots. The page table has a texel per virtual
+// page and a mip per virtual level; each entry holds the cache slot and level
+// of the page to sample. Pages that aren't resident point at their closest
+// resident ancestor, so shading always finds something, just blurrier. The
+// coarsest page is loaded up front and never evicted, so there always is one.
+//
+// What's needed comes from a feedback pass: the scene is drawn at
+// 1/FEEDBACK_SCALE of the screen, writing the page each virtual-textured
+// pixel samples. It's read back through a buffer a few frames later, so
+// the GPU never waits. Missing pages are queued coarsest first and read from
+// the file by a loader thread; the render thread uploads at most
+// MAX_UPLOADS_PER_FRAME of them a frame, replacing the least recently
+// requested pages once the cache is full.
+//
+// Materials use it through the VIRTUAL_TEXTURE_ARRAY texture handle.
+class VirtualTexture {
+public:
+	struct VirtualTextureStats {
+		unsigned int residentPages;
+		unsigned int pagesRequested;  // distinct pages the latest feedback asked for
+		unsigned int pagesMissing;    // of those, drawn from a coarser page
+		unsigned int loadsPending;
+		unsigned int pagesUploaded;   // totals since the previous Take
+		unsigned int pagesEvicted;
+		unsigned int feedbackDropped;
+	};
+
+	VirtualTexture();
+
+	// Opens path, generating a terrain there first if there's nothing to open.
+	bool CreateVirtualTexture(const char* path, GLsizei screenWidth, GLsizei screenHeight, JobSystem& jobs);
+
+	// Start of a frame: takes in feedback that has arrived, queues missing
+	// pages, uploads loaded ones and refreshes the page table.
+	void Update();
+	void UseVirtualTexture();
+
+	// Clears the bound GL_R32UI + depth target, draws the batch's page
+	// requests into it and starts reading feedbackTexture back.
+	void RenderFeedback(DrawBatch& batch, GLuint feedbackTexture);
+	GLsizei GetFeedbackWidth() const { return feedbackWidth; }
+	GLsizei GetFeedbackHeight() const { return feedbackHeight; }
+	// Recreates the feedback readbacks for a new screen size.
+	void Resize(GLsizei screenWidth, GLsizei screenHeight);
+
+	bool IsAvailable() const { return pageCache != 0; }
+	// Page counts are current; upload, eviction and drop counts are reset.
+	VirtualTextureStats TakeStats();
+	GLuint GetWidth() const { return source.GetPagesPerSide(0) * source.GetPageSize(); }
+
+	void ClearVirtualTexture();
+
+	~VirtualTexture();
+
+	static const GLuint FEEDBACK_SCALE = 8;
+	static const GLuint CACHE_PAGES_PER_SIDE = 16;
+	static const unsigned int MAX_UPLOADS_PER_FRAME = 16;
+	static const unsigned int MAX_QUEUED_LOADS = 64;
+	// Feedback packs page coordinates into 12 bits each.
+	static const uint32_t MAX_PAGES_PER_SIDE = 4096;
+	// Pages per side of the terrain generated when the file is missing.
+	static const uint32_t GENERATED_PAGES_PER_SIDE = 32;
+
+private:
+	static const int QUERY_FRAMES = 3;
+	static const uint32_t NO_PAGE = 0xFFFFFFFFu;
+
+	struct CacheSlot {
+		uint32_t page;
+		unsigned int lastUsed;
+		bool pinned;
+	};
+
+	struct LoadedPage {
+		uint32_t page;
+		std::vector<unsigned char> texels;
+	};
+
+	struct FeedbackReadback {
+		GLuint buffer;
+		GLsync fence;
+		GLsizei count;
+	};
+
+	VirtualTextureFile source;
+	Shader feedbackShader;
+	GLuint uniformLodBias;
+
+	GLuint pageTable;
+	GLuint pageCache;
+	std::vector<CacheSlot> slots;
+	// Page key -> cache slot.
+	std::unordered_map<uint32_t, unsigned int> residentPages;
+	// RGBA8UI entries of every page table level.
+	std::vector<std::vector<GLubyte>> tableLevels;
+	// Pages uploaded or evicted since the table was last updated.
+	std::vector<uint32_t> changedPages;
+	std::vector<GLubyte> tableRegion;
+	unsigned int frame;
+
+	GLsizei feedbackWidth, feedbackHeight;
+	FeedbackReadback readbacks[QUERY_FRAMES];
+	int readbackIndex;
+	std::vector<GLuint> feedback;
+	std::vector<uint32_t> requested;
+
+	// Shared with the loader thread.
+	std::mutex loaderLock;
+	std::condition_variable loadQueued;
+	std::vector<uint32_t> loadQueue;  // next load at the back
+	std::vector<LoadedPage> loadedPages;
+	uint32_t loadingPage;
+	bool stopping;
+	std::thread loader;
+
+	VirtualTextureStats stats;
+
+	// Keys match the feedback encoding without its valid bit.
+	static uint32_t PageKey(uint32_t level, uint32_t x, uint32_t y) { return level << 24 | y << 12 | x; }
+	static uint32_t KeyLevel(uint32_t key) { return key >> 24 & 0x7Fu; }
+	static uint32_t KeyX(uint32_t key) { return key & 0xFFFu; }
+	static uint32_t KeyY(uint32_t key) { return key >> 12 & 0xFFFu; }
+
+	void CreateReadbacks(GLsizei screenWidth, GLsizei screenHeight);
+	void ClearReadbacks();
+	void ReadFeedback();
+	void QueueLoads();
+	void UploadPages();
+	bool UploadPage(uint32_t page, const unsigned char* texels, bool pinned);
+	void UpdatePageTable();
+	// Recomputes and uploads the size x size entries of level from firstX, firstY.
+	void UpdatePageTableRegion(GLuint level, GLuint firstX, GLuint firstY, GLuint size);
+	void RunLoader();
+};
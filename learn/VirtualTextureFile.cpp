@@ -0,0 +1,211 @@
+#include "VirtualTextureFile.h"
+
+#include <math.h>
+
+static const uint32_t VIRTUAL_TEXTURE_MAGIC = 0x58455456;  // "VTEX"
+static const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+static const int HEADER_WORDS = 6;
+
+// Wavelengths of the terrain's noise octaves, in finest-level texels.
+static const float TERRAIN_LARGEST_WAVELENGTH = 2048.0f;
+static const float TERRAIN_SMALLEST_WAVELENGTH = 2.0f;
+
+static bool SeekTo(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+	return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+static float LatticeValue(int x, int y, uint32_t seed) {
+	uint32_t hash = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+	hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+	hash ^= hash >> 15;
+	return (hash >> 8) / 16777216.0f;
+}
+
+static float ValueNoise(float x, float y, uint32_t seed) {
+	float cellX = floorf(x);
+	float cellY = floorf(y);
+	float fx = x - cellX;
+	float fy = y - cellY;
+	fx = fx * fx * (3.0f - 2.0f * fx);
+	fy = fy * fy * (3.0f - 2.0f * fy);
+
+	int ix = static_cast<int>(cellX);
+	int iy = static_cast<int>(cellY);
+	float top = LatticeValue(ix, iy, seed) + (LatticeValue(ix + 1, iy, seed) - LatticeValue(ix, iy, seed)) * fx;
+	float bottom = LatticeValue(ix, iy + 1, seed) + (LatticeValue(ix + 1, iy + 1, seed) - LatticeValue(ix, iy + 1, seed)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// Octaves finer than cutoff would alias at this level; they're replaced by
+// their average, so every level keeps the same overall brightness.
+static float Fbm(float x, float y, float largest, float cutoff, uint32_t seed) {
+	float sum = 0.0f;
+	float weight = 0.0f;
+	float amplitude = 1.0f;
+	for (float wavelength = largest; wavelength >= TERRAIN_SMALLEST_WAVELENGTH; wavelength *= 0.5f) {
+		sum += amplitude * (wavelength >= cutoff ? ValueNoise(x / wavelength, y / wavelength, seed) : 0.5f);
+		weight += amplitude;
+		amplitude *= 0.5f;
+		seed++;
+	}
+	return sum / weight;
+}
+
+static float SmoothStep(float edge0, float edge1, float x) {
+	float t = (x - edge0) / (edge1 - edge0);
+	t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+	return t * t * (3.0f - 2.0f * t);
+}
+
+VirtualTextureFile::VirtualTextureFile() {
+	file = nullptr;
+	pageSize = 0;
+	border = 0;
+	pagesPerSide = 0;
+	levelCount = 0;
+}
+
+void VirtualTextureFile::CountPages() {
+	levelStarts.resize(levelCount);
+	uint64_t pages = 0;
+	for (uint32_t level = 0; level < levelCount; level++) {
+		levelStarts[level] = pages;
+		pages += static_cast<uint64_t>(GetPagesPerSide(level)) * GetPagesPerSide(level);
+	}
+}
+
+bool VirtualTextureFile::Open(const char* path) {
+	Close();
+	file = fopen(path, "rb");
+	if (!file) {
+		printf("Failed to find: %s\n", path);
+		return false;
+	}
+
+	uint32_t header[HEADER_WORDS];
+	if (fread(header, sizeof(header), 1, file) != 1 || header[0] != VIRTUAL_TEXTURE_MAGIC || header[1] != VIRTUAL_TEXTURE_VERSION) {
+		printf("%s isn't a version %u virtual texture\n", path, VIRTUAL_TEXTURE_VERSION);
+		Close();
+		return false;
+	}
+
+	pageSize = header[2];
+	border = header[3];
+	pagesPerSide = header[4];
+	levelCount = header[5];
+	if (pageSize == 0 || pagesPerSide == 0 || levelCount == 0 || levelCount > 32 || (pagesPerSide & (pagesPerSide - 1)) != 0 || (pagesPerSide >> (levelCount - 1)) != 1) {
+		printf("%s has an unusable page layout (%u pages of %u texels, %u levels)\n", path, pagesPerSide, pageSize, levelCount);
+		Close();
+		return false;
+	}
+	CountPages();
+	return true;
+}
+
+bool VirtualTextureFile::ReadPage(uint32_t level, uint32_t x, uint32_t y, unsigned char* texels) {
+	if (!file || level >= levelCount || x >= GetPagesPerSide(level) || y >= GetPagesPerSide(level)) {
+		return false;
+	}
+
+	uint64_t page = levelStarts[level] + static_cast<uint64_t>(y) * GetPagesPerSide(level) + x;
+	uint64_t offset = sizeof(uint32_t) * HEADER_WORDS + page * GetPageBytes();
+	return SeekTo(file, offset) && fread(texels, GetPageBytes(), 1, file) == 1;
+}
+
+void VirtualTextureFile::GeneratePage(uint32_t level, uint32_t pageX, uint32_t pageY, uint32_t pagesPerSide, unsigned char* texels) {
+	const float dirt[3] = { 0.45f, 0.34f, 0.22f };
+	const float grass[3] = { 0.30f, 0.42f, 0.18f };
+	const float rock[3] = { 0.52f, 0.50f, 0.47f };
+
+	int levelSize = static_cast<int>((pagesPerSide >> level) * PAGE_SIZE);
+	float texelSize = static_cast<float>(1u << level);
+	// A texel of this level covers texelSize finest texels; noise finer than
+	// two of them can't be shown.
+	float cutoff = 2.0f * texelSize;
+	int stored = static_cast<int>(PAGE_SIZE + 2 * PAGE_BORDER);
+
+	for (int y = 0; y < stored; y++) {
+		for (int x = 0; x < stored; x++) {
+			// The border repeats the edge texels at the texture's own edges.
+			int levelX = static_cast<int>(pageX * PAGE_SIZE) + x - static_cast<int>(PAGE_BORDER);
+			int levelY = static_cast<int>(pageY * PAGE_SIZE) + y - static_cast<int>(PAGE_BORDER);
+			levelX = levelX < 0 ? 0 : levelX >= levelSize ? levelSize - 1 : levelX;
+			levelY = levelY < 0 ? 0 : levelY >= levelSize ? levelSize - 1 : levelY;
+			float fineX = (levelX + 0.5f) * texelSize;
+			float fineY = (levelY + 0.5f) * texelSize;
+
+			float height = Fbm(fineX, fineY, TERRAIN_LARGEST_WAVELENGTH, cutoff, 1);
+			float moisture = Fbm(fineX, fineY, TERRAIN_LARGEST_WAVELENGTH / 2.0f, cutoff > 16.0f ? cutoff : 16.0f, 17);
+			float detail = Fbm(fineX, fineY, 32.0f, cutoff, 33);
+
+			float grassAmount = SmoothStep(0.45f, 0.6f, moisture);
+			float rockAmount = SmoothStep(0.58f, 0.68f, height);
+			float shade = 0.75f + 0.5f * detail;
+			unsigned char* texel = texels + (static_cast<size_t>(y) * stored + x) * 4;
+			for (int c = 0; c < 3; c++) {
+				float ground = dirt[c] + (grass[c] - dirt[c]) * grassAmount;
+				float value = (ground + (rock[c] - ground) * rockAmount) * shade;
+				texel[c] = static_cast<unsigned char>(value >= 1.0f ? 255 : value * 255.0f);
+			}
+			texel[3] = 255;
+		}
+	}
+}
+
+bool VirtualTextureFile::Generate(const char* path, uint32_t pagesPerSide, JobSystem& jobs) {
+	if (pagesPerSide == 0 || (pagesPerSide & (pagesPerSide - 1)) != 0) {
+		printf("Virtual textures need a power of two pages across, not %u\n", pagesPerSide);
+		return false;
+	}
+
+	FILE* output = fopen(path, "wb");
+	if (!output) {
+		printf("Failed to open %s for the virtual texture\n", path);
+		return false;
+	}
+
+	uint32_t levels = 1;
+	while ((pagesPerSide >> (levels - 1)) > 1) {
+		levels++;
+	}
+	uint32_t header[HEADER_WORDS] = { VIRTUAL_TEXTURE_MAGIC, VIRTUAL_TEXTURE_VERSION, PAGE_SIZE, PAGE_BORDER, pagesPerSide, levels };
+	bool written = fwrite(header, sizeof(header), 1, output) == 1;
+
+	size_t pageBytes = static_cast<size_t>(PAGE_SIZE + 2 * PAGE_BORDER) * (PAGE_SIZE + 2 * PAGE_BORDER) * 4;
+	std::vector<unsigned char> row(pagesPerSide * pageBytes);
+	for (uint32_t level = 0; level < levels && written; level++) {
+		uint32_t pages = pagesPerSide >> level;
+		for (uint32_t y = 0; y < pages && written; y++) {
+			jobs.ParallelFor(pages, 1, [&](size_t begin, size_t end) {
+				for (size_t x = begin; x < end; x++) {
+					GeneratePage(level, static_cast<uint32_t>(x), y, pagesPerSide, row.data() + x * pageBytes);
+				}
+			});
+			written = fwrite(row.data(), pageBytes, pages, output) == pages;
+		}
+	}
+	fclose(output);
+
+	if (!written) {
+		printf("Failed to write the virtual texture to %s\n", path);
+		return false;
+	}
+	printf("Generated a %u x %u virtual texture in %s\n", pagesPerSide * PAGE_SIZE, pagesPerSide * PAGE_SIZE, path);
+	return true;
+}
+
+void VirtualTextureFile::Close() {
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+	levelStarts.clear();
+}
+
+VirtualTextureFile::~VirtualTextureFile() {
+	Close();
+}
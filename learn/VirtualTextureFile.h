@@ -0,0 +1,54 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "JobSystem.h"
+
+// A virtual texture on disk, cut into square pages so any one of them can be
+// read without touching the rest. After a small header come the RGBA8 pages
+// of every level, finest first and row by row within a level. Each page
+// carries a border copied from its neighbours, so bilinear filtering across
+// page edges needs nothing from the pages next to it.
+//
+// Level L is pagesPerSide >> L pages across; the last level is one page.
+class VirtualTextureFile {
+public:
+	VirtualTextureFile();
+
+	bool Open(const char* path);
+	// Writes a procedural terrain pagesPerSide pages across (a power of two)
+	// to path, generating the pages of each row as jobs.
+	static bool Generate(const char* path, uint32_t pagesPerSide, JobSystem& jobs);
+
+	// Fills texels with GetPageBytes() bytes. Called from one thread at a time.
+	bool ReadPage(uint32_t level, uint32_t x, uint32_t y, unsigned char* texels);
+
+	bool IsOpen() const { return file != nullptr; }
+	uint32_t GetPageSize() const { return pageSize; }
+	uint32_t GetBorder() const { return border; }
+	// Page size plus the border on both sides.
+	uint32_t GetStoredPageSize() const { return pageSize + 2 * border; }
+	size_t GetPageBytes() const { return static_cast<size_t>(GetStoredPageSize()) * GetStoredPageSize() * 4; }
+	uint32_t GetPagesPerSide(uint32_t level) const { return pagesPerSide >> level; }
+	uint32_t GetLevelCount() const { return levelCount; }
+
+	void Close();
+
+	~VirtualTextureFile();
+
+	static const uint32_t PAGE_SIZE = 128;
+	static const uint32_t PAGE_BORDER = 1;
+
+private:
+	FILE* file;
+	uint32_t pageSize;
+	uint32_t border;
+	uint32_t pagesPerSide;
+	uint32_t levelCount;
+	// Index of the first page of each level.
+	std::vector<uint64_t> levelStarts;
+
+	void CountPages();
+	static void GeneratePage(uint32_t level, uint32_t pageX, uint32_t pageY, uint32_t pagesPerSide, unsigned char* texels);
+};
@@ -1,4 +1,5 @@
 #include "Window.h"
+#include "GLState.h"
 #include <iostream>
 
 Window::Window() :
@@ -79,19 +80,30 @@ int Window::Initialise()
     glViewport(0, 0, bufferWidth, bufferHeight);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // gray background
 
-    glEnable(GL_DEPTH_TEST);
+    GLState::Enable(GL_DEPTH_TEST);
 
     glfwSetWindowUserPointer(mainWindow, this);
 
-
-    // Set framebuffer size callback
-    glfwSetFramebufferSizeCallback(mainWindow, [](GLFWwindow* window, int width, int height) {
-        glViewport(0, 0, width, height);
-        });
+    // No framebuffer size callback: callbacks run on the thread polling
+    // events, which doesn't own the GL context once rendering moves to the
+    // render thread. pollBufferSize() picks the size up instead and the frame
+    // packet hands it over. Every pass sets its own viewport.
 
     return 0;
 }
 
+void Window::pollBufferSize()
+{
+    GLint newWidth, newHeight;
+    glfwGetFramebufferSize(mainWindow, &newWidth, &newHeight);
+
+    // A minimised window reports 0 x 0; keep the last real size.
+    if (newWidth > 0 && newHeight > 0) {
+        bufferWidth = newWidth;
+        bufferHeight = newHeight;
+    }
+}
+
 void Window::createCallBacks() {
     glfwSetKeyCallback(mainWindow, handleKeys);
     glfwSetCursorPosCallback(mainWindow, handleMouse);
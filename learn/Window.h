@@ -10,6 +10,8 @@ public:
 	int Initialise();
 	GLint getBufferWidth() const { return bufferWidth; }
 	GLint getBufferHeight() const { return bufferHeight; }
+	// Main thread only, after glfwPollEvents.
+	void pollBufferSize();
 	bool shouldClose() { return glfwWindowShouldClose(mainWindow); }
 	void swapBuffer() { glfwSwapBuffers(mainWindow); }
 	GLFWwindow* getGLFWWindow() const { return mainWindow; }
@@ -0,0 +1,60 @@
+#version 460
+
+out vec4 color;
+
+struct Material {
+	float specularIntensity;
+	float shininess;
+};
+
+layout(binding = 4) uniform sampler2D gAlbedo;
+layout(binding = 5) uniform sampler2D gNormal;
+layout(binding = 6) uniform sampler2D gMaterial;
+layout(binding = 7) uniform sampler2D gDepth;
+
+uniform int lightType;
+uniform int lightIndex;
+uniform vec4 volume;
+uniform mat4 inverseViewProjection;
+
+// Filled from the G-buffer for lighting.glsl, which the forward shader
+// shares.
+vec3 Normal;
+vec3 FragPos;
+Material material;
+
+#include "lighting.glsl"
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	if (depth >= 1.0f) {
+		discard;
+	}
+
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+	vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0f - 1.0f, 1.0f);
+	FragPos = world.xyz / world.w;
+
+	if (volume.w > 0.0f && distance(FragPos, volume.xyz) > volume.w) {
+		discard;
+	}
+
+	Normal = texelFetch(gNormal, pixel, 0).xyz;
+	vec2 params = texelFetch(gMaterial, pixel, 0).rg;
+	material.specularIntensity = params.x;
+	material.shininess = params.y;
+
+	vec4 lightColor;
+	if (lightType == 0) {
+		lightColor = CalcDirectionalLight();
+	} else if (lightType == 1) {
+		lightShadow = CalcAtlasShadow(uint(lightIndex), pointLights[lightIndex].position);
+		lightColor = CalcPointLight(pointLights[lightIndex]);
+	} else {
+		lightShadow = CalcAtlasShadow(uint(MAX_POINT_LIGHTS + lightIndex), spotLights[lightIndex].base.position);
+		lightColor = CalcSpotLight(spotLights[lightIndex]);
+	}
+
+	color = texelFetch(gAlbedo, pixel, 0) * lightColor;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 460 core
+
+layout(location = 0) in vec3 position;
+
+// Bounded lights are drawn as a sphere of radius volume.w around volume.xyz;
+// a radius of zero draws a full-screen triangle instead.
+uniform vec4 volume;
+uniform mat4 viewProjection;
+
+void main() {
+    if (volume.w <= 0.0) {
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    } else {
+        gl_Position = viewProjection * vec4(position * volume.w + volume.xyz, 1.0);
+    }
+}
@@ -0,0 +1,20 @@
+#version 460 core
+
+layout(location = 0) in vec3 position;
+
+struct DrawData {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+	uint materialIndex;
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+	DrawData draws[];
+};
+
+invariant gl_Position;
+
+void main() {
+    gl_Position = draws[gl_DrawID].mvp * vec4(position, 1.0);
+}
@@ -3,117 +3,156 @@
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 FragPos;
+flat in uint DrawIndex;
 
 out vec4 color;
 
-const int MAX_POINT_LIGHTS = 3;
-const int MAX_SPOT_LIGHTS  = 3;
-
-struct Light {
-	vec3 color;
-	float ambientIntensity;
-	float diffuseIntensity;
-};
-
-struct DirectionalLight {
-	Light base;
-	vec3 direction;
-};
-
-struct PointLight {
-	Light base;
-	vec3 position;
-	float constant;
-	float linear;
-	float exponent;
+const int MAX_TEXTURE_ARRAYS = 4;
+const int TILE_SIZE = 16;
+const int MAX_LIGHTS_PER_TILE = 64;
+const uint LIGHT_DATA_SPOT = 1u;
+// Tiles with this many lights show up fully red in the heatmap.
+const float HEATMAP_FULL = 16.0f;
+
+struct DrawData {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+	uint materialIndex;
 };
-struct SpotLight {
-	PointLight base;
-	vec3 direction;
-	float edge;
+struct LightData {
+	vec4 positionRange;
+	vec4 colorAmbient;
+	vec4 directionEdge;
+	vec4 attenuation;
+	uint type;
+	uint shadowIndex;
+	uint pad0;
+	uint pad1;
 };
 struct Material {
 	float specularIntensity;
 	float shininess;
+	uint textureArray;
+	uint textureLayer;
 };
 
-uniform int pointLightCount;
-uniform int  spotLightCount;
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+	DrawData draws[];
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+	Material materials[];
+};
 
-uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[MAX_POINT_LIGHTS];
-uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
+layout(std430, binding = 2) readonly buffer LightBuffer {
+	LightData lights[];
+};
 
+layout(std430, binding = 3) readonly buffer TileBuffer {
+	uint tileLights[];
+};
 
-uniform sampler2D theTexture;
-uniform Material material;
+layout(binding = 0) uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
 
-uniform vec3 eyePosition;
+#include "virtualTexture.glsl"
 
-vec4 CalcLightByDirection(Light light, vec3 direction) {
-	vec4 ambientColor = vec4(light.color, 1.0f) * light.ambientIntensity;
-	
-	float diffuseFactor = max(dot(normalize(Normal), normalize(direction)), 0.0f);
-	vec4 diffuseColor = vec4(light.color, 1.0f) * light.diffuseIntensity * diffuseFactor;
+// Tiled mode takes point and spot lights from the culled per-tile lists
+// instead of the uniform arrays.
+uniform bool tiledLighting;
+uniform bool lightHeatmap;
+uniform uint tileCountX;
 
-	vec4 specularColor = vec4(0.0f, 0.0f, 0.0f, 0.0f);
-	
-	if (diffuseFactor > 0.0f) {
-		vec3 fragToEye = normalize(eyePosition - FragPos);
-		vec3 reflectedVertex = normalize(reflect(direction, normalize(Normal)));
-		float specularFactor = dot(fragToEye, reflectedVertex);
-		if (specularFactor > 0.0f) {
-			specularFactor = pow(specularFactor, material.shininess);
-			specularColor = vec4(light.color * material.specularIntensity * specularFactor, 1.0f);
-		}
-	}
-	
-	return (ambientColor + diffuseColor + specularColor);
-}
-vec4 CalcDirectionalLight() {
-	return CalcLightByDirection(directionalLight.base, directionalLight.direction);
-}
-vec4 CalcPointLight(PointLight pLight) {
-	vec3 direction = FragPos - pLight.position;
-	float distance = length(direction);
-	direction = normalize(direction); 
-		
-	vec4 color = CalcLightByDirection(pLight.base, direction);
-
-	float attenuation = pLight.exponent * distance * distance +
-		                pLight.linear * distance +
-						pLight.constant;
-	return color/attenuation;
-}
-vec4 CalcSpotLight(SpotLight sLight) {
-	vec3 rayDirection = normalize(FragPos - sLight.base.position);
-	float slFactor = dot(rayDirection, sLight.direction);
+Material material;
+
+#include "lighting.glsl"
 
-	if (slFactor > sLight.edge) {
-		vec4 color = CalcPointLight(sLight.base);
-		return color * (1.0f - (1.0f - slFactor) * (1.0f/(1.0f - sLight.edge)));
-	} else {
-		return vec4(0); // 0, 0, 0, 0
-	}
-}
 vec4 CalcSpotLights() {
 	vec4 totalColor = vec4(0);
 	for(int i = 0; i < spotLightCount; i++) {
+		lightShadow = CalcAtlasShadow(uint(MAX_POINT_LIGHTS + i), spotLights[i].base.position);
 		totalColor += CalcSpotLight(spotLights[i]);
 	}
+	lightShadow = 1.0f;
 	return totalColor;
 }
 vec4 CalcPointLights() {
 	vec4 totalColor = vec4(0);
 	for(int i = 0; i < pointLightCount; i++) {
+		lightShadow = CalcAtlasShadow(uint(i), pointLights[i].position);
 		totalColor += CalcPointLight(pointLights[i]);
 	}
+	lightShadow = 1.0f;
+	return totalColor;
+}
+
+uint TileBase() {
+	uvec2 tile = uvec2(gl_FragCoord.xy) / uint(TILE_SIZE);
+	return (tile.y * tileCountX + tile.x) * uint(MAX_LIGHTS_PER_TILE + 1);
+}
+vec4 CalcTiledLights() {
+	uint base = TileBase();
+	uint count = tileLights[base];
+
+	vec4 totalColor = vec4(0);
+	for (uint i = 0u; i < count; i++) {
+		LightData data = lights[tileLights[base + 1u + i]];
+
+		PointLight pLight;
+		pLight.base.color = data.colorAmbient.rgb;
+		pLight.base.ambientIntensity = data.colorAmbient.a;
+		pLight.base.diffuseIntensity = data.attenuation.w;
+		pLight.position = data.positionRange.xyz;
+		pLight.constant = data.attenuation.x;
+		pLight.linear = data.attenuation.y;
+		pLight.exponent = data.attenuation.z;
+
+		lightShadow = CalcAtlasShadow(data.shadowIndex, pLight.position);
+		if (data.type == LIGHT_DATA_SPOT) {
+			SpotLight sLight;
+			sLight.base = pLight;
+			sLight.direction = data.directionEdge.xyz;
+			sLight.edge = data.directionEdge.w;
+			totalColor += CalcSpotLight(sLight);
+		} else {
+			totalColor += CalcPointLight(pLight);
+		}
+	}
+	lightShadow = 1.0f;
 	return totalColor;
 }
+vec4 TileHeat() {
+	float t = clamp(float(tileLights[TileBase()]) / HEATMAP_FULL, 0.0f, 1.0f);
+	vec3 heat = t < 0.5f ? mix(vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f), t * 2.0f)
+	                     : mix(vec3(0.0f, 1.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), t * 2.0f - 1.0f);
+	return vec4(heat, 1.0f);
+}
+
+vec4 SampleTexture(uint array, vec3 coord) {
+	// Constant indices only: the array index is not dynamically uniform
+	// across the draws of a multi-draw.
+	switch (array) {
+	case 0u: return texture(textureArrays[0], coord);
+	case 1u: return texture(textureArrays[1], coord);
+	case 2u: return texture(textureArrays[2], coord);
+	case VIRTUAL_TEXTURE_ARRAY: return SampleVirtualTexture(coord.xy);
+	default: return texture(textureArrays[3], coord);
+	}
+}
 
 void main() {
+	material = materials[draws[DrawIndex].materialIndex];
+
 	vec4 finalColor  = CalcDirectionalLight(); 
-	     finalColor += CalcPointLights();
-	     finalColor += CalcSpotLights();
-	color = texture(theTexture, TexCoord) * finalColor;
+	if (tiledLighting) {
+		finalColor += CalcTiledLights();
+	} else {
+		finalColor += CalcPointLights();
+		finalColor += CalcSpotLights();
+	}
+	color = SampleTexture(material.textureArray, vec3(TexCoord, float(material.textureLayer))) * finalColor;
+
+	if (tiledLighting && lightHeatmap) {
+		color = mix(color, TileHeat(), 0.6f);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 460
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragPos;
+flat in uint DrawIndex;
+
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec2 gMaterial;
+
+const int MAX_TEXTURE_ARRAYS = 4;
+
+struct DrawData {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+	uint materialIndex;
+};
+struct Material {
+	float specularIntensity;
+	float shininess;
+	uint textureArray;
+	uint textureLayer;
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+	DrawData draws[];
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+	Material materials[];
+};
+
+layout(binding = 0) uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+
+#include "virtualTexture.glsl"
+
+vec4 SampleTexture(uint array, vec3 coord) {
+	switch (array) {
+	case 0u: return texture(textureArrays[0], coord);
+	case 1u: return texture(textureArrays[1], coord);
+	case 2u: return texture(textureArrays[2], coord);
+	case VIRTUAL_TEXTURE_ARRAY: return SampleVirtualTexture(coord.xy);
+	default: return texture(textureArrays[3], coord);
+	}
+}
+
+void main() {
+	Material material = materials[draws[DrawIndex].materialIndex];
+
+	gAlbedo = SampleTexture(material.textureArray, vec3(TexCoord, float(material.textureLayer)));
+	gNormal = vec4(normalize(Normal), 0.0f);
+	gMaterial = vec2(material.specularIntensity, material.shininess);
+}
\ No newline at end of file
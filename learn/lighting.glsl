@@ -0,0 +1,168 @@
+// Light sources, shadows and the Phong lighting of one fragment, shared by
+// the forward shader and the deferred light pass. The including shader
+// declares Normal, FragPos and a material with specularIntensity and
+// shininess before including this.
+
+const int MAX_POINT_LIGHTS = 3;
+const int MAX_SPOT_LIGHTS  = 3;
+const int MAX_SHADOW_CASCADES = 4;
+const uint NO_SHADOW = 0xFFFFFFFFu;
+
+struct Light {
+	vec3 color;
+	float ambientIntensity;
+	float diffuseIntensity;
+};
+
+struct DirectionalLight {
+	Light base;
+	vec3 direction;
+};
+
+struct PointLight {
+	Light base;
+	vec3 position;
+	float constant;
+	float linear;
+	float exponent;
+};
+struct SpotLight {
+	PointLight base;
+	vec3 direction;
+	float edge;
+};
+
+uniform int pointLightCount;
+uniform int  spotLightCount;
+
+uniform DirectionalLight directionalLight;
+uniform PointLight pointLights[MAX_POINT_LIGHTS];
+uniform SpotLight spotLights[MAX_SPOT_LIGHTS];
+
+uniform vec3 eyePosition;
+
+// Cascaded shadow map of the directional light; no shadows while cascadeCount is 0.
+uniform mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+uniform int cascadeCount;
+layout(binding = 9) uniform sampler2DArrayShadow cascadeShadowMap;
+
+// Point and spot light shadows; slot i is point light i, slot
+// MAX_POINT_LIGHTS + i spot light i.
+struct LightShadow {
+	mat4 matrices[6];
+	vec4 rects[6];
+	uint faceCount;
+	uint pad0;
+	uint pad1;
+	uint pad2;
+};
+layout(std430, binding = 4) readonly buffer LightShadowBuffer {
+	LightShadow lightShadows[];
+};
+uniform bool atlasShadows;
+layout(binding = 10) uniform sampler2DShadow shadowAtlas;
+
+// Scales the diffuse and specular terms of the light being evaluated.
+float lightShadow = 1.0f;
+
+vec4 CalcLightByDirection(Light light, vec3 direction) {
+	vec4 ambientColor = vec4(light.color, 1.0f) * light.ambientIntensity;
+	
+	float diffuseFactor = max(dot(normalize(Normal), normalize(direction)), 0.0f);
+	vec4 diffuseColor = vec4(light.color, 1.0f) * light.diffuseIntensity * diffuseFactor;
+
+	vec4 specularColor = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	
+	if (diffuseFactor > 0.0f) {
+		vec3 fragToEye = normalize(eyePosition - FragPos);
+		vec3 reflectedVertex = normalize(reflect(direction, normalize(Normal)));
+		float specularFactor = dot(fragToEye, reflectedVertex);
+		if (specularFactor > 0.0f) {
+			specularFactor = pow(specularFactor, material.shininess);
+			specularColor = vec4(light.color * material.specularIntensity * specularFactor, 1.0f);
+		}
+	}
+	
+	return ambientColor + (diffuseColor + specularColor) * lightShadow;
+}
+float CalcCascadeShadow() {
+	// Cascades can be a few frames old, so pick the first whose box actually
+	// holds the fragment rather than going by view depth.
+	for (int i = 0; i < cascadeCount; i++) {
+		vec3 coord = (cascadeMatrices[i] * vec4(FragPos, 1.0f)).xyz * 0.5f + 0.5f;
+		if (all(greaterThan(coord.xy, vec2(0.0f))) && all(lessThan(coord.xy, vec2(1.0f))) && coord.z < 1.0f) {
+			vec2 texel = 1.0f / vec2(textureSize(cascadeShadowMap, 0).xy);
+			float lit = 0.0f;
+			for (int x = -1; x <= 1; x++) {
+				for (int y = -1; y <= 1; y++) {
+					lit += texture(cascadeShadowMap, vec4(coord.xy + vec2(x, y) * texel, float(i), coord.z));
+				}
+			}
+			return lit / 9.0f;
+		}
+	}
+	return 1.0f;
+}
+float CalcAtlasShadow(uint slot, vec3 lightPosition) {
+	if (!atlasShadows || slot == NO_SHADOW || lightShadows[slot].faceCount == 0u) {
+		return 1.0f;
+	}
+
+	// Point lights: pick the cube face by the major axis, +X -X +Y -Y +Z -Z.
+	uint face = 0u;
+	if (lightShadows[slot].faceCount == 6u) {
+		vec3 toFragment = FragPos - lightPosition;
+		vec3 axis = abs(toFragment);
+		if (axis.x >= axis.y && axis.x >= axis.z) {
+			face = toFragment.x > 0.0f ? 0u : 1u;
+		} else if (axis.y >= axis.z) {
+			face = toFragment.y > 0.0f ? 2u : 3u;
+		} else {
+			face = toFragment.z > 0.0f ? 4u : 5u;
+		}
+	}
+
+	vec4 clip = lightShadows[slot].matrices[face] * vec4(FragPos, 1.0f);
+	if (clip.w <= 0.0f) {
+		return 1.0f;
+	}
+	vec3 ndc = clip.xyz / clip.w;
+	if (any(greaterThan(abs(ndc), vec3(1.0f)))) {
+		return 1.0f;
+	}
+
+	// Stay half a texel inside the tile so filtering never reads a neighbour.
+	vec4 rect = lightShadows[slot].rects[face];
+	vec2 halfTexel = 0.5f / (rect.zw * vec2(textureSize(shadowAtlas, 0)));
+	vec2 uv = clamp(ndc.xy * 0.5f + 0.5f, halfTexel, 1.0f - halfTexel);
+	return texture(shadowAtlas, vec3(rect.xy + uv * rect.zw, ndc.z * 0.5f + 0.5f));
+}
+vec4 CalcDirectionalLight() {
+	lightShadow = CalcCascadeShadow();
+	vec4 color = CalcLightByDirection(directionalLight.base, directionalLight.direction);
+	lightShadow = 1.0f;
+	return color;
+}
+vec4 CalcPointLight(PointLight pLight) {
+	vec3 direction = FragPos - pLight.position;
+	float distance = length(direction);
+	direction = normalize(direction); 
+		
+	vec4 color = CalcLightByDirection(pLight.base, direction);
+
+	float attenuation = pLight.exponent * distance * distance +
+		                pLight.linear * distance +
+						pLight.constant;
+	return color/attenuation;
+}
+vec4 CalcSpotLight(SpotLight sLight) {
+	vec3 rayDirection = normalize(FragPos - sLight.base.position);
+	float slFactor = dot(rayDirection, sLight.direction);
+
+	if (slFactor > sLight.edge) {
+		vec4 color = CalcPointLight(sLight.base);
+		return color * (1.0f - (1.0f - slFactor) * (1.0f/(1.0f - sLight.edge)));
+	} else {
+		return vec4(0); // 0, 0, 0, 0
+	}
+}
@@ -5,6 +5,8 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <thread>
+#include <cstdlib>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -14,18 +16,49 @@
 
 #include "Window.h"
 #include "Camera.h"
-#include "Texture.h"
-#include "Mesh.h"
+#include "TextureLibrary.h"
+#include "TextureStreamer.h"
+#include "VirtualTexture.h"
+#include "DrawBatch.h"
+#include "RingBuffer.h"
+#include "DeferredRenderer.h"
+#include "DepthPrepass.h"
+#include "FrameGraph.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "PipelineStatistics.h"
+#include "CpuProfiler.h"
+#include "ChromeTrace.h"
+#include "FrameTimer.h"
+#include "CameraPath.h"
+#include "SceneGenerator.h"
+#include "TiledLightCulling.h"
+#include "CascadedShadowMap.h"
+#include "ShadowAtlas.h"
 #include "Shader.h"
 #include "DirectionalLight.h"
 #include "PointLight.h"
 #include "SpotLight.h"
 #include "Material.h"
+#include "MaterialRegistry.h"
+#include "GLState.h"
+#include "FramePacket.h"
+#include "RenderThread.h"
+#include "CommandRecorder.h"
+#include "JobSystem.h"
+#include "JobBenchmark.h"
+#include "VertexBenchmark.h"
+#include "SceneGraph.h"
+#include "EntityWorld.h"
+#include "Components.h"
 
 void update();
+void RenderFrame(FramePacket& frame);
 static void CreateObjects();
+static void CreateBenchmarkScene();
 static void CreateShaders();
-void calculateFPS();
+void calculateFPS(const FramePacket& frame);
+static void printPipelineStatistics(const std::vector<PipelineStatistics::PassStatistics>& passes);
 void calcAverageNormals(
 	unsigned int* indices,
 	unsigned int indexCount,
@@ -41,6 +74,13 @@ const unsigned int SCR_HEIGHT = 600;
 const GLfloat RED_TRIANGLE_Z = +0.0f;
 const GLfloat BLUE_TRIANGLE_Z = -0.5f;
 
+// Per-frame dynamic data (draw commands, transforms) is triple buffered.
+const GLsizeiptr FRAME_RING_SECTION_SIZE = 4 * 1024 * 1024;
+// Generated scenes grow the sections to fit: per draw that's its draw data
+// and command plus the command copies the shadow passes make.
+const GLsizeiptr FRAME_RING_BYTES_PER_DRAW = 512;
+const unsigned int FRAME_RING_SECTIONS = 3;
+
 const GLuint VERTS_PER_TRI = 3;
 const GLuint ATTRIB_PER_VERT = 6;
 const GLuint TRI_BYTE_SIZE = VERTS_PER_TRI * ATTRIB_PER_VERT * sizeof(GLfloat);
@@ -55,7 +95,13 @@ uniformDirection,
 uniformDiffuseIntensity,
 uniformEyePosition,
 uniformSpecularIntensity,
-uniformShininess
+uniformShininess,
+uniformTiledLighting,
+uniformLightHeatmap,
+uniformTileCountX,
+uniformCascadeMatrices,
+uniformCascadeCount,
+uniformAtlasShadows
 ;
 
 bool isMovingRight = true;
@@ -65,53 +111,305 @@ const float triIncrement = 0.1f;
 
 const float toRadians = 3.14f / 180;
 
-GLfloat deltaTime = 0.0f;
-GLfloat lastTime = 0.0f;
+// The simulation thread's timer paces the whole pipeline; the render
+// thread's only measures how evenly frames reach the screen.
+// --frame-cap <fps> caps the frame rate, --pacing sleep|spin picks how the
+// rest of a frame is waited out (spin sleeps most of it, then spins).
+FrameTimer simulationTimer;
+FrameTimer renderTimer;
+
+// --scene meshes|lights|textures adds a canned benchmark load to the scene.
+// --record <file> saves the camera path flown this session; --replay <file>
+// flies a saved one with a fixed timestep, prints frame time statistics and
+// exits, so runs before and after a change can be compared directly.
+enum BenchmarkScene {
+	SCENE_DEFAULT,
+	SCENE_MESHES,
+	SCENE_LIGHTS,
+	SCENE_TEXTURES,
+	SCENE_COUNT
+};
+static const char* benchmarkSceneNames[] = { "default", "meshes", "lights", "textures" };
+BenchmarkScene benchmarkScene = SCENE_DEFAULT;
+const int BENCHMARK_MESH_GRID = 100;
+const int BENCHMARK_LIGHT_COUNT = 512;
+const int BENCHMARK_TEXTURE_SIZE = 4096;
+const int BENCHMARK_TEXTURE_COUNT = 2;
+TextureHandle benchmarkTextures[BENCHMARK_TEXTURE_COUNT];
+
+CameraPath cameraPath;
+const char* recordPath = nullptr;
+const char* replayPath = nullptr;
+
+// --stress key=value,... generates a scaling-test scene on top of the default
+// one, e.g. --stress seed=7,meshes=100,instances=100000,lights=512,
+// distribution=clustered. See SceneGenerator::Config for every key.
+SceneGenerator sceneGenerator;
+SceneGenerator::Config stressConfig = SceneGenerator::DefaultConfig();
+bool stressScene = false;
 
 Window window(1366, 768);
 
-std::vector<Mesh*> meshList;
+// --gpu-budget <MB> caps tracked GPU memory; going over it first evicts the
+// frame graph's idle pooled textures. Allocations left at exit are reported.
+double gpuBudgetMegabytes = 0.0;
+
+// F1 selects forward shading, F2 deferred shading, F5 tiled forward shading,
+// O the overdraw view.
+// F3 / F4 turn the forward depth pre-pass on / off.
+// F6 / F7 turn the tiled lights-per-tile heatmap on / off.
+// F8 / F9 turn directional light shadows on / off.
+// F10 / F11 turn point and spot light shadows on / off.
+// F12 prints the frame graph's schedule.
+// P writes the profilers' recent frames to one Chrome trace.
+static const char* renderModeNames[] = { "forward", "deferred", "tiled forward", "overdraw" };
+RenderMode renderMode = RENDER_FORWARD;
+FrameGraph frameGraph;
+bool scheduleKeyHeld = false;
+GpuProfiler gpuProfiler;
+bool profilerAvailable = false;
+PipelineStatistics pipelineStatistics;
+bool statisticsAvailable = false;
+bool traceKeyHeld = false;
+static const char* traceFile = "profile_trace.json";
+DeferredRenderer deferredRenderer;
+bool deferredAvailable = false;
+DepthPrepass depthPrepass;
+bool prepassEnabled = false;
+TiledLightCulling tiledCulling;
+bool tiledAvailable = false;
+bool lightHeatmap = false;
+
+const GLsizei SHADOW_MAP_RESOLUTION = 1024;
+const int SHADOW_CASCADES = 4;
+CascadedShadowMap cascadedShadows;
+bool shadowsAvailable = false;
+bool shadowsEnabled = true;
+
+const GLsizei SHADOW_ATLAS_SIZE = 4096;
+const GLfloat SHADOW_ATLAS_BUDGET_MS = 1.0f;
+ShadowAtlas shadowAtlas;
+bool atlasAvailable = false;
+bool atlasEnabled = true;
+
+// The main thread simulates and records frames; the render thread owns the
+// GL context and everything below that talks to GL. Both hand work to the
+// job system's workers.
+JobSystem jobSystem;
+RenderThread renderThread;
+CommandRecorder commandRecorder;
+SceneGraph sceneGraph;
+
+// Everything in the scene, drawables and lights alike, is an entity.
+EntityWorld entityWorld;
+Entity flashlight;
 
-Texture brickTexture;
-Texture dirtTexture;
-Texture plainTexture;
+RingBuffer frameRing;
+DrawBatch sceneBatch;
+unsigned int pyramidMesh;
+unsigned int floorMesh;
+unsigned int terrainMesh;
+
+TextureLibrary textureLibrary;
+// --texture-budget <MB> sets what streamed textures may keep on the GPU; 0
+// turns streaming off and keeps every level of every texture resident.
+TextureStreamer textureStreamer;
+double textureBudgetMegabytes = 256.0;
+const GLsizeiptr TEXTURE_UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+// --virtual-texture <file> gives the floor one unique terrain texture, paged
+// in from file as the view needs it. A procedural terrain is written to the
+// file first if it doesn't exist.
+VirtualTexture virtualTexture;
+const char* virtualTexturePath = nullptr;
+bool virtualTextureAvailable = false;
+TextureHandle brickTexture;
+TextureHandle dirtTexture;
+TextureHandle plainTexture;
 
 Material shinyMaterial;
 Material dullMaterial;
 
+MaterialRegistry materialRegistry;
+unsigned int pyramidMaterial;
+unsigned int floorMaterial;
+unsigned int terrainMaterial;
+
 std::vector<Shader> shaderList;
 
 static const char* vShader = "vertexShader.glsl";
 static const char* fShader = "fragmentShader.glsl";
 
 DirectionalLight mainLight;
-PointLight pointLights[MAX_POINT_LIGHTS];
-SpotLight spotLights[MAX_SPOT_LIGHTS];
-unsigned int pointLightCount = 0;
-unsigned int spotLightCount = 0;
 
-float lastTime_FPS = 0.0f;
+double lastTime_FPS = 0.0;
 int nbFrames = 0;
-float fps = 0.0f;
+double fps = 0.0;
+
+int main(int argc, char** argv) {
+	double frameCap = 0.0;
+	FramePacing pacing = PACING_SLEEP_SPIN;
+	bool vertexBenchmark = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--job-benchmark") {
+			RunJobBenchmark();
+			return 0;
+		}
+		if (arg == "--vertex-benchmark") {
+			vertexBenchmark = true;
+		}
+		if (arg == "--frame-cap" && i + 1 < argc) {
+			frameCap = atof(argv[++i]);
+		}
+		else if (arg == "--pacing" && i + 1 < argc) {
+			pacing = std::string(argv[++i]) == "sleep" ? PACING_SLEEP : PACING_SLEEP_SPIN;
+		}
+		else if (arg == "--scene" && i + 1 < argc) {
+			std::string name = argv[++i];
+			int scene = 0;
+			while (scene < SCENE_COUNT && name != benchmarkSceneNames[scene]) {
+				scene++;
+			}
+			if (scene == SCENE_COUNT) {
+				std::cout << "Unknown --scene " << name << ", expected default, meshes, lights or textures" << std::endl;
+				return -1;
+			}
+			benchmarkScene = static_cast<BenchmarkScene>(scene);
+		}
+		else if (arg == "--record" && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc) {
+			replayPath = argv[++i];
+		}
+		else if (arg == "--gpu-budget" && i + 1 < argc) {
+			gpuBudgetMegabytes = atof(argv[++i]);
+		}
+		else if (arg == "--texture-budget" && i + 1 < argc) {
+			textureBudgetMegabytes = atof(argv[++i]);
+		}
+		else if (arg == "--virtual-texture" && i + 1 < argc) {
+			virtualTexturePath = argv[++i];
+		}
+		else if (arg == "--stress" && i + 1 < argc) {
+			if (!SceneGenerator::ParseConfig(argv[++i], stressConfig)) {
+				return -1;
+			}
+			stressScene = true;
+		}
+	}
+	simulationTimer.SetFrameCap(frameCap, pacing);
+
+	if (replayPath) {
+		if (!cameraPath.Load(replayPath)) {
+			return -1;
+		}
+		// The summary covers the whole replay, not just the rolling window.
+		renderTimer.KeepAllFrames(cameraPath.GetFrameCount());
+	}
+
+	// One worker per core, minus the main and render threads.
+	unsigned int cores = std::thread::hardware_concurrency();
+	jobSystem.CreateJobSystem(cores > 3 ? cores - 2 : 1);
 
-int main() {
 	if (window.Initialise() != 0) {
 		return -1;
 	}
 
-	CreateObjects();
+	if (vertexBenchmark) {
+		RunVertexBenchmark(jobSystem);
+		jobSystem.ClearJobSystem();
+		return 0;
+	}
+
+	GpuMemory::SetBudget(static_cast<GLsizeiptr>(gpuBudgetMegabytes * 1024.0 * 1024.0));
+	GpuMemory::AddEvictionCallback([](GLsizeiptr bytes) {
+		return frameGraph.ReleaseUnusedTextures(bytes);
+	});
+
+	GLsizeiptr ringSectionSize = FRAME_RING_SECTION_SIZE;
+	if (stressScene) {
+		unsigned int stressDraws = stressConfig.instances > 0 ? stressConfig.instances : stressConfig.meshes;
+		GLsizeiptr stressBytes = FRAME_RING_SECTION_SIZE + FRAME_RING_BYTES_PER_DRAW * static_cast<GLsizeiptr>(stressDraws);
+		ringSectionSize = stressBytes > ringSectionSize ? stressBytes : ringSectionSize;
+	}
+	if (!frameRing.CreateRingBuffer(ringSectionSize, FRAME_RING_SECTIONS)) {
+		return -1;
+	}
+
 	CreateShaders();
 
-	brickTexture = Texture("Textures/brick.png");
-	dirtTexture = Texture("Textures/dirt.png");
-	plainTexture = Texture("Textures/plain.png");
-	brickTexture.LoadTexture();
-	dirtTexture.LoadTexture();
-	plainTexture.LoadTexture();
+	profilerAvailable = gpuProfiler.CreateGpuProfiler();
+	if (profilerAvailable) {
+		frameGraph.SetProfiler(&gpuProfiler);
+	}
+	statisticsAvailable = pipelineStatistics.CreatePipelineStatistics();
+	if (statisticsAvailable) {
+		frameGraph.SetPipelineStatistics(&pipelineStatistics);
+	}
+
+	depthPrepass.CreateDepthPrepass();
+
+	deferredAvailable = deferredRenderer.CreateDeferredRenderer();
+	if (!deferredAvailable) {
+		std::cout << "Deferred renderer unavailable, staying on forward shading" << std::endl;
+	}
+
+	shadowsAvailable = cascadedShadows.CreateCascadedShadowMap(SHADOW_MAP_RESOLUTION, SHADOW_CASCADES);
+	if (!shadowsAvailable) {
+		std::cout << "Cascaded shadow maps unavailable, rendering without shadows" << std::endl;
+	}
+
+	atlasAvailable = shadowAtlas.CreateShadowAtlas(SHADOW_ATLAS_SIZE);
+	if (atlasAvailable) {
+		shadowAtlas.SetUpdateBudget(SHADOW_ATLAS_BUDGET_MS);
+	}
+	else {
+		std::cout << "Shadow atlas unavailable, point and spot lights cast no shadows" << std::endl;
+	}
+
+	tiledAvailable = tiledCulling.CreateTiledLightCulling(window.getBufferWidth(), window.getBufferHeight());
+	if (!tiledAvailable) {
+		std::cout << "Tiled light culling unavailable" << std::endl;
+	}
+
+	textureLibrary.AddTexture("Textures/brick.png", &brickTexture);
+	textureLibrary.AddTexture("Textures/dirt.png", &dirtTexture);
+	textureLibrary.AddTexture("Textures/plain.png", &plainTexture);
+	if (benchmarkScene == SCENE_TEXTURES) {
+		for (int i = 0; i < BENCHMARK_TEXTURE_COUNT; i++) {
+			textureLibrary.AddGeneratedTexture(BENCHMARK_TEXTURE_SIZE, BENCHMARK_TEXTURE_SIZE, i + 1, &benchmarkTextures[i]);
+		}
+	}
+	if (stressScene) {
+		sceneGenerator.QueueTextures(stressConfig, textureLibrary);
+	}
+	textureLibrary.SetStreaming(textureBudgetMegabytes > 0.0);
+	textureLibrary.Build(jobSystem);
+	if (textureLibrary.IsStreaming()) {
+		textureStreamer.CreateTextureStreamer(textureLibrary,
+			static_cast<GLsizeiptr>(textureBudgetMegabytes * 1024.0 * 1024.0), TEXTURE_UPLOAD_BYTES_PER_FRAME);
+	}
+	if (virtualTexturePath) {
+		virtualTextureAvailable = virtualTexture.CreateVirtualTexture(virtualTexturePath,
+			window.getBufferWidth(), window.getBufferHeight(), jobSystem);
+		if (!virtualTextureAvailable) {
+			std::cout << "Virtual texture unavailable, the floor stays tiled" << std::endl;
+		}
+	}
 
 	shinyMaterial = Material(5.0f, 32);
 	dullMaterial = Material(0.3f, 4);
 
+	pyramidMaterial = materialRegistry.AddMaterial(shinyMaterial, plainTexture);
+	floorMaterial = materialRegistry.AddMaterial(shinyMaterial, dirtTexture);
+	if (virtualTextureAvailable) {
+		TextureHandle virtualHandle = { VIRTUAL_TEXTURE_ARRAY, 0 };
+		terrainMaterial = materialRegistry.AddMaterial(shinyMaterial, virtualHandle);
+	}
+
+	CreateObjects();
+
 	mainLight = DirectionalLight(
 		+1.0f, +1.0f, +1.0f,
 		+0.3f, +0.1f,
@@ -119,25 +417,27 @@ int main() {
 	);
 
 
-	pointLights[0] = PointLight(
+	PointLightComponent pointLight;
+	pointLight.light = PointLight(
 		+0.0f, +0.0f, +1.0f,
 		+0.1f, +0.1f,
 		+4.0f, +0.0f, +0.0f,
 		+0.3f, +0.2f, +0.1f
 		
 	);
-	pointLightCount++;
+	entityWorld.AddComponent(entityWorld.CreateEntity(), pointLight);
 
-	pointLights[1] = PointLight(
+	pointLight.light = PointLight(
 		+0.0f, +1.0f, +0.0f,
 		+0.1f, +0.1f,
 		-4.0f, +2.0f, +0.0f,
 		+0.3f, +0.1f, +0.1f
 		
 	);
-	pointLightCount++;
+	entityWorld.AddComponent(entityWorld.CreateEntity(), pointLight);
 
-	spotLights[0] = SpotLight(
+	SpotLightComponent spotLight;
+	spotLight.light = SpotLight(
 		+0.0f, +0.0f, +1.0f, // Color
 		+0.1f, +1.0f,		 // Intensities
 		+4.0f, +0.0f, +0.0f, // Position
@@ -145,9 +445,9 @@ int main() {
 		+1.0f, +0.0f, +0.0f, // Attenuation
 		20.0f                // Edge value
 	);
-	spotLightCount++;
+	entityWorld.AddComponent(entityWorld.CreateEntity(), spotLight);
 
-	spotLights[1] = SpotLight(
+	spotLight.light = SpotLight(
 		+1.0f, +1.0f, +1.0f,   // Color
 		+0.0f, +1.0f,		   // Intensities
 		+2.0f, +0.9f, +0.0f,   // Position
@@ -155,10 +455,71 @@ int main() {
 		+0.3f, +0.2f, +0.1f,   // Attenuation
 		20.0f                  // Edge value
 	);
-	spotLightCount++;
+	flashlight = entityWorld.CreateEntity();
+	entityWorld.AddComponent(flashlight, spotLight);
 
+	CreateBenchmarkScene();
+	if (stressScene) {
+		sceneGenerator.Generate(stressConfig, sceneBatch, materialRegistry, sceneGraph, entityWorld);
+		SceneGenerator::Stats stressStats = sceneGenerator.GetStats();
+		std::cout << "Stress scene (seed " << stressConfig.seed << "): " << stressStats.meshes << " meshes, "
+			<< stressStats.instances << " instances (" << stressStats.animated << " animated), "
+			<< stressStats.materials << " materials, " << stressStats.textures << " textures, "
+			<< stressStats.lights << " lights, generated in " << stressStats.generateMs << " ms" << std::endl;
+	}
+
+	commandRecorder.CreateCommandRecorder(jobSystem);
+	sceneBatch.SetJobSystem(&jobSystem);
+
+	glfwSwapInterval(0);
+	if (!renderThread.Start(window.getGLFWWindow(), RenderFrame)) {
+		return -1;
+	}
 
 	update();
+
+	renderThread.Stop();
+
+	if (replayPath) {
+		FrameTimer::FrameTimeStats frameTimes = renderTimer.GetAllFramesStats();
+		std::cout << "Replayed " << cameraPath.GetFrameCount() << " frames of " << replayPath
+			<< " (scene: " << benchmarkSceneNames[benchmarkScene] << ")" << std::endl
+			<< "Frame time over all " << frameTimes.frames << " frames (ms): mean " << frameTimes.meanMs
+			<< " | p50 " << frameTimes.p50Ms
+			<< " | p95 " << frameTimes.p95Ms
+			<< " | p99 " << frameTimes.p99Ms
+			<< " | max " << frameTimes.maxMs << std::endl;
+		GpuMemory::Stats memoryStats = GpuMemory::GetStats();
+		std::cout << "Peak GPU memory: " << memoryStats.peakBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+		if (statisticsAvailable) {
+			std::cout << "Pipeline statistics per frame over the run:" << std::endl;
+			printPipelineStatistics(pipelineStatistics.GetRunAverages());
+		}
+	}
+	else if (recordPath) {
+		cameraPath.Save(recordPath);
+	}
+	cameraPath.ClearCameraPath();
+	gpuProfiler.ClearGpuProfiler();
+	pipelineStatistics.ClearPipelineStatistics();
+	sceneGenerator.ClearSceneGenerator();
+	textureStreamer.ClearTextureStreamer();
+	virtualTexture.ClearVirtualTexture();
+	commandRecorder.ClearCommandRecorder();
+	entityWorld.ClearEntityWorld();
+	sceneGraph.ClearSceneGraph();
+	shadowAtlas.ClearShadowAtlas();
+	cascadedShadows.ClearCascadedShadowMap();
+	tiledCulling.ClearTiledLightCulling();
+	frameGraph.ClearFrameGraph();
+	deferredRenderer.ClearDeferredRenderer();
+	depthPrepass.ClearDepthPrepass();
+	sceneBatch.ClearBatch();
+	frameRing.ClearRingBuffer();
+	materialRegistry.ClearMaterials();
+	textureLibrary.ClearTextureLibrary();
+	jobSystem.ClearJobSystem();
+	GpuMemory::ReportLeaks();
 	glfwTerminate();
 	return 0;
 }
@@ -181,58 +542,377 @@ void update() {
 		"|" << std::endl;
 
 	Camera camera = Camera(glm::vec3(0.0f, 0.4f, 2.5f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -12.0f, 5.0f, 0.2f);
-	glm::mat4 projection = glm::perspective(45.0f, (GLfloat)window.getBufferWidth() / (GLfloat)window.getBufferHeight(), 0.1f, 100.0f);
-	glm::mat4 model = glm::mat4(1.0f);
 
-	glfwSwapInterval(0);
+	unsigned int replayFrame = 0;
+	double simulationTime = 0.0;
+	PROFILE_THREAD("main thread");
 	while (!window.shouldClose()) {
-
-		GLfloat now = static_cast<GLfloat>(glfwGetTime());
-		deltaTime = now - lastTime;
-		lastTime = now;
+		double deltaTime = simulationTimer.BeginFrame();
+		PROFILE_ZONE("simulate frame");
 
 		glfwPollEvents();
-		camera.keyControl(window.getKeys(), deltaTime);
-		camera.mouseControl(window.getXChange(), window.getYChange());
-		glClear(GL_DEPTH_BUFFER_BIT
-			| GL_COLOR_BUFFER_BIT);
-
-		shaderList[0].UseShader();
-
-		uniformModel = shaderList[0].GetModelLocation();
-		uniformProjection = shaderList[0].GetProjectionLocation();
-		uniformView = shaderList[0].GetViewLocation();
-		uniformEyePosition = shaderList[0].GetEyePositionLocation();
-		uniformSpecularIntensity = shaderList[0].GetSpecularIntensityLocation();
-		uniformShininess = shaderList[0].GetShininessLocation();
-
-		spotLights[1].SetFlash(camera.getCameraPosition() + glm::vec3(0.0f, -0.1f, 0.0f), camera.getCameraDirecion());
-
-		shaderList[0].SetDirectionalLight(&mainLight);
-		shaderList[0].SetPointLights(pointLights, pointLightCount);
-		shaderList[0].SetSpotLights(spotLights, spotLightCount);
-
-		glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(camera.calculateViewMatrix()));
-		glUniform3f(uniformEyePosition, camera.getCameraPosition().x, camera.getCameraPosition().y, camera.getCameraPosition().z);
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		plainTexture.UseTexture();
-		shinyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[0]->RenderMesh();
-
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, -1.0f, 0.0f));
-		glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-		dirtTexture.UseTexture();
-		shinyMaterial.UseMaterial(uniformSpecularIntensity, uniformShininess);
-		meshList[1]->RenderMesh();
-
-		calculateFPS();
-		window.swapBuffer();
+		// Resizes are seen here, on the thread polling events; the packet
+		// carries the new size to the render thread.
+		window.pollBufferSize();
+		glm::mat4 projection = glm::perspective(45.0f, (GLfloat)window.getBufferWidth() / (GLfloat)window.getBufferHeight(), 0.1f, 100.0f);
+		bool* keys = window.getKeys();
+		if (replayPath) {
+			if (replayFrame == cameraPath.GetFrameCount()) {
+				glfwSetWindowShouldClose(window.getGLFWWindow(), GL_TRUE);
+				break;
+			}
+			deltaTime = CameraPath::FIXED_TIMESTEP;
+			cameraPath.ApplyFrame(replayFrame++, camera, keys);
+		}
+		else {
+			camera.keyControl(keys, static_cast<GLfloat>(deltaTime));
+			camera.mouseControl(window.getXChange(), window.getYChange());
+			if (recordPath) {
+				cameraPath.RecordFrame(camera, keys);
+			}
+		}
+
+		RenderMode requestedMode = keys[GLFW_KEY_F1] ? RENDER_FORWARD
+			: keys[GLFW_KEY_F2] && deferredAvailable ? RENDER_DEFERRED
+			: keys[GLFW_KEY_F5] && tiledAvailable ? RENDER_TILED
+			: keys[GLFW_KEY_O] ? RENDER_OVERDRAW
+			: renderMode;
+		if (requestedMode != renderMode) {
+			renderMode = requestedMode;
+			std::cout << "Render mode: " << renderModeNames[renderMode] << std::endl;
+		}
+		bool requestedPrepass = keys[GLFW_KEY_F3] ? true : keys[GLFW_KEY_F4] ? false : prepassEnabled;
+		if (requestedPrepass != prepassEnabled) {
+			prepassEnabled = requestedPrepass;
+			std::cout << "Depth pre-pass: " << (prepassEnabled ? "on" : "off") << std::endl;
+		}
+		bool requestedHeatmap = keys[GLFW_KEY_F6] ? true : keys[GLFW_KEY_F7] ? false : lightHeatmap;
+		if (requestedHeatmap != lightHeatmap) {
+			lightHeatmap = requestedHeatmap;
+			std::cout << "Light heatmap: " << (lightHeatmap ? "on" : "off") << std::endl;
+		}
+		bool requestedShadows = keys[GLFW_KEY_F8] ? true : keys[GLFW_KEY_F9] ? false : shadowsEnabled;
+		if (requestedShadows != shadowsEnabled) {
+			shadowsEnabled = requestedShadows;
+			std::cout << "Shadows: " << (shadowsEnabled ? "on" : "off") << std::endl;
+		}
+		bool requestedAtlas = keys[GLFW_KEY_F10] ? true : keys[GLFW_KEY_F11] ? false : atlasEnabled;
+		if (requestedAtlas != atlasEnabled) {
+			atlasEnabled = requestedAtlas;
+			std::cout << "Point and spot light shadows: " << (atlasEnabled ? "on" : "off") << std::endl;
+		}
+
+		entityWorld.GetComponent<SpotLightComponent>(flashlight)->light.SetFlash(
+			camera.getCameraPosition() + glm::vec3(0.0f, -0.1f, 0.0f), camera.getCameraDirecion());
+
+		simulationTime += deltaTime;
+		if (stressScene) {
+			sceneGenerator.Animate(sceneGraph, static_cast<float>(simulationTime));
+		}
+		sceneGraph.Update(&jobSystem);
+		if (sceneGraph.GetLastUpdateCount() > 0) {
+			// Copy only the world matrices the graph just changed.
+			entityWorld.ParallelForEachChunk<TransformComponent>(jobSystem,
+				[](size_t, unsigned int count, const Entity*, TransformComponent* transforms) {
+				for (unsigned int i = 0; i < count; i++) {
+					if (sceneGraph.WasUpdated(transforms[i].node)) {
+						transforms[i].world = sceneGraph.GetWorldMatrix(transforms[i].node);
+					}
+				}
+			});
+		}
+
+		glm::mat4 view = camera.calculateViewMatrix();
+
+		// Blocks only while the render thread is a whole frame behind.
+		FramePacket& packet = renderThread.BeginPacket();
+		packet.view = view;
+		packet.projection = projection;
+		packet.eyePosition = camera.getCameraPosition();
+		packet.bufferWidth = window.getBufferWidth();
+		packet.bufferHeight = window.getBufferHeight();
+		packet.mainLight = mainLight;
+		// The first MAX_POINT_LIGHTS / MAX_SPOT_LIGHTS lights of each kind get
+		// the uniform path and a shadow atlas slot; the tiled path takes them all.
+		packet.pointLightCount = 0;
+		packet.spotLightCount = 0;
+		packet.lights.clear();
+		entityWorld.ForEach<PointLightComponent>([&packet](Entity, PointLightComponent& point) {
+			LightData data;
+			point.light.GetLightData(&data);
+			if (packet.pointLightCount < MAX_POINT_LIGHTS) {
+				data.shadowIndex = packet.pointLightCount;
+				packet.pointLights[packet.pointLightCount++] = point.light;
+			}
+			packet.lights.push_back(data);
+		});
+		entityWorld.ForEach<SpotLightComponent>([&packet](Entity, SpotLightComponent& spot) {
+			LightData data;
+			spot.light.GetLightData(&data);
+			if (packet.spotLightCount < MAX_SPOT_LIGHTS) {
+				data.shadowIndex = MAX_POINT_LIGHTS + packet.spotLightCount;
+				packet.spotLights[packet.spotLightCount++] = spot.light;
+			}
+			packet.lights.push_back(data);
+		});
+		packet.renderMode = renderMode;
+		packet.depthPrepass = prepassEnabled;
+		packet.lightHeatmap = lightHeatmap;
+		packet.shadows = shadowsAvailable && shadowsEnabled;
+		packet.lightShadows = atlasAvailable && atlasEnabled;
+		packet.printSchedule = keys[GLFW_KEY_F12] && !scheduleKeyHeld;
+		scheduleKeyHeld = keys[GLFW_KEY_F12];
+		packet.writeTrace = keys[GLFW_KEY_P] && !traceKeyHeld;
+		traceKeyHeld = keys[GLFW_KEY_P];
+
+		commandRecorder.Record(sceneBatch, entityWorld, projection * view, packet);
+		renderThread.SubmitPacket();
+	}
+}
+// Runs on the render thread. Everything it reads comes from the packet or
+// from objects only the render thread touches after start-up.
+void RenderFrame(FramePacket& frame) {
+	renderTimer.BeginFrame();
+	PROFILE_ZONE("render frame");
+	gpuProfiler.BeginFrame();
+	pipelineStatistics.BeginFrame();
+	unsigned int frameScope = gpuProfiler.BeginScope("frame");
+	GLState::BeginFrame();
+	frameRing.BeginFrame();
+
+	depthPrepass.SetEnabled(frame.depthPrepass);
+	depthPrepass.SetRequired(frame.renderMode == RENDER_TILED);
+
+	unsigned int uploadScope = gpuProfiler.BeginScope("draw upload");
+	sceneBatch.Begin();
+	for (size_t i = 0; i < frame.draws.size(); i++) {
+		const DrawPacket& draw = frame.draws[i];
+		sceneBatch.Submit(draw.mesh, draw.model, draw.material, draw.visible);
+	}
+
+	const glm::mat4& view = frame.view;
+	const glm::mat4& projection = frame.projection;
+	glm::mat4 viewProjection = projection * view;
+
+	GLsizei bufferWidth = frame.bufferWidth;
+	GLsizei bufferHeight = frame.bufferHeight;
+	// Both keep their current buffers unless the size changed.
+	tiledCulling.Resize(bufferWidth, bufferHeight);
+	virtualTexture.Resize(bufferWidth, bufferHeight);
+
+	textureStreamer.Update(frame.draws, sceneBatch, materialRegistry, frame.eyePosition, projection, bufferHeight);
+	virtualTexture.Update();
+	textureLibrary.UseTextures();
+	virtualTexture.UseVirtualTexture();
+	materialRegistry.UseMaterials();
+	sceneBatch.Upload(frameRing, viewProjection);
+	gpuProfiler.EndScope(uploadScope);
+
+	CascadedShadowMap* shadows = frame.shadows ? &cascadedShadows : nullptr;
+	ShadowAtlas* lightShadows = frame.lightShadows ? &shadowAtlas : nullptr;
+	bool tiled = frame.renderMode == RENDER_TILED;
+
+	frameGraph.Begin();
+
+	FrameGraphResource backbuffer = frameGraph.ImportResource("backbuffer");
+	frameGraph.MarkOutput(backbuffer);
+	FrameGraphResource cascadeMap = frameGraph.ImportResource("cascaded shadow map");
+	FrameGraphResource atlasMap = frameGraph.ImportResource("shadow atlas");
+	FrameGraphResource tileLights = frameGraph.ImportResource("tile light lists");
+
+	// Pass callbacks run in Execute(), so everything they capture lives out here.
+	FrameGraphResource gBuffer[DeferredRenderer::GBUFFER_ATTACHMENT_COUNT];
+	FrameGraphResource sceneColor = backbuffer;
+	FrameGraphResource sceneDepth = backbuffer;
+	FrameGraphResource virtualRequests = NO_RESOURCE;
+	FrameGraphResource virtualDepth = NO_RESOURCE;
+	auto bindSceneTarget = [&]() {
+		if (tiled) {
+			frameGraph.BindRenderTarget(&sceneColor, 1, sceneDepth);
+		}
+		else {
+			GLState::BindFramebuffer(0);
+			glViewport(0, 0, bufferWidth, bufferHeight);
+		}
+	};
+
+	if (shadows) {
+		unsigned int pass = frameGraph.AddPass("cascaded shadows", [&]() {
+			shadows->Update(sceneBatch, frameRing, view, projection, frame.mainLight.GetDirection());
+		});
+		frameGraph.Write(pass, cascadeMap);
+	}
+	if (lightShadows) {
+		unsigned int pass = frameGraph.AddPass("shadow atlas", [&]() {
+			lightShadows->Update(sceneBatch, frameRing, view, projection,
+				frame.pointLights, frame.pointLightCount, frame.spotLights, frame.spotLightCount);
+		});
+		frameGraph.Write(pass, atlasMap);
+	}
+
+	if (virtualTextureAvailable && frame.renderMode != RENDER_OVERDRAW) {
+		virtualRequests = frameGraph.CreateTexture("virtual texture requests",
+			virtualTexture.GetFeedbackWidth(), virtualTexture.GetFeedbackHeight(), GL_R32UI);
+		virtualDepth = frameGraph.CreateTexture("virtual texture feedback depth",
+			virtualTexture.GetFeedbackWidth(), virtualTexture.GetFeedbackHeight(), GL_DEPTH_COMPONENT32F);
+		// Read back on the CPU, so nothing in the graph consumes it.
+		FrameGraphResource virtualFeedback = frameGraph.ImportResource("virtual texture feedback");
+		frameGraph.MarkOutput(virtualFeedback);
+		unsigned int feedbackPass = frameGraph.AddPass("virtual texture feedback", [&]() {
+			frameGraph.BindRenderTarget(&virtualRequests, 1, virtualDepth);
+			virtualTexture.RenderFeedback(sceneBatch, frameGraph.GetTexture(virtualRequests));
+		});
+		frameGraph.Write(feedbackPass, virtualRequests);
+		frameGraph.Write(feedbackPass, virtualDepth);
+		frameGraph.Write(feedbackPass, virtualFeedback);
+	}
+
+	if (frame.renderMode == RENDER_DEFERRED) {
+		const char* gBufferNames[DeferredRenderer::GBUFFER_ATTACHMENT_COUNT] = {
+			"g-buffer albedo", "g-buffer normal", "g-buffer material", "g-buffer depth" };
+		for (int i = 0; i < DeferredRenderer::GBUFFER_ATTACHMENT_COUNT; i++) {
+			gBuffer[i] = frameGraph.CreateTexture(gBufferNames[i], bufferWidth, bufferHeight, DeferredRenderer::GetGBufferFormat(i));
+		}
+
+		unsigned int geometryPass = frameGraph.AddPass("deferred geometry", [&]() {
+			frameGraph.BindRenderTarget(gBuffer, DeferredRenderer::GBUFFER_DEPTH, gBuffer[DeferredRenderer::GBUFFER_DEPTH]);
+			deferredRenderer.RenderGeometry(sceneBatch);
+		});
+		for (int i = 0; i < DeferredRenderer::GBUFFER_ATTACHMENT_COUNT; i++) {
+			frameGraph.Write(geometryPass, gBuffer[i]);
+		}
+
+		unsigned int lightingPass = frameGraph.AddPass("deferred lighting", [&]() {
+			GLState::BindFramebuffer(0);
+			glViewport(0, 0, bufferWidth, bufferHeight);
+			for (int i = 0; i < DeferredRenderer::GBUFFER_ATTACHMENT_COUNT; i++) {
+				frameGraph.BindTexture(GBUFFER_TEXTURE_UNIT + i, gBuffer[i]);
+			}
+			deferredRenderer.RenderLighting(viewProjection, frame.eyePosition,
+				&frame.mainLight, frame.pointLights, frame.pointLightCount, frame.spotLights, frame.spotLightCount, shadows, lightShadows);
+		});
+		for (int i = 0; i < DeferredRenderer::GBUFFER_ATTACHMENT_COUNT; i++) {
+			frameGraph.Read(lightingPass, gBuffer[i]);
+		}
+		frameGraph.Read(lightingPass, cascadeMap);
+		frameGraph.Read(lightingPass, atlasMap);
+		frameGraph.Write(lightingPass, backbuffer);
+	}
+	else if (frame.renderMode == RENDER_OVERDRAW) {
+		unsigned int overdrawPass = frameGraph.AddPass("overdraw", [&]() {
+			const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			GLState::BindFramebuffer(0);
+			glViewport(0, 0, bufferWidth, bufferHeight);
+			glClearNamedFramebufferfv(0, GL_COLOR, 0, black);
+			depthPrepass.RenderOverdraw(sceneBatch);
+		});
+		frameGraph.Write(overdrawPass, backbuffer);
+	}
+	else {
+		// Tiled shading needs a depth buffer it can sample, so it renders
+		// off-screen and presents at the end.
+		if (tiled) {
+			sceneColor = frameGraph.CreateTexture("scene color", bufferWidth, bufferHeight, GL_RGBA8);
+			sceneDepth = frameGraph.CreateTexture("scene depth", bufferWidth, bufferHeight, GL_DEPTH_COMPONENT32F);
+		}
+
+		unsigned int depthPass = frameGraph.AddPass("depth pre-pass", [&]() {
+			bindSceneTarget();
+			glClear(GL_DEPTH_BUFFER_BIT
+				| GL_COLOR_BUFFER_BIT);
+			depthPrepass.RenderDepth(sceneBatch);
+		});
+		frameGraph.Write(depthPass, sceneColor);
+		frameGraph.Write(depthPass, sceneDepth);
+
+		if (tiled) {
+			unsigned int cullPass = frameGraph.AddPass("tiled light culling", [&]() {
+				tiledCulling.UploadLights(frameRing, frame.lights.data(), static_cast<unsigned int>(frame.lights.size()));
+				tiledCulling.Cull(frameGraph.GetTexture(sceneDepth), view, projection);
+			});
+			frameGraph.Read(cullPass, sceneDepth);
+			frameGraph.Write(cullPass, tileLights);
+		}
+
+		unsigned int shadingPass = frameGraph.AddPass("forward shading", [&]() {
+			bindSceneTarget();
+
+			shaderList[0].UseShader();
+			uniformEyePosition = shaderList[0].GetEyePositionLocation();
+
+			if (shadows) {
+				shadows->UseShadowMap(uniformCascadeMatrices, uniformCascadeCount);
+			}
+			else {
+				glUniform1i(uniformCascadeCount, 0);
+			}
+			if (lightShadows) {
+				lightShadows->UseShadowAtlas(uniformAtlasShadows);
+			}
+			else {
+				glUniform1i(uniformAtlasShadows, 0);
+			}
+
+			glUniform1i(uniformTiledLighting, tiled);
+			if (tiled) {
+				glUniform1i(uniformLightHeatmap, frame.lightHeatmap);
+				glUniform1ui(uniformTileCountX, tiledCulling.GetTileCountX());
+				tiledCulling.UseTiles();
+			}
+
+			shaderList[0].SetDirectionalLight(&frame.mainLight);
+			shaderList[0].SetPointLights(frame.pointLights, frame.pointLightCount);
+			shaderList[0].SetSpotLights(frame.spotLights, frame.spotLightCount);
+
+			glUniform3f(uniformEyePosition, frame.eyePosition.x, frame.eyePosition.y, frame.eyePosition.z);
+
+			depthPrepass.BeginShading();
+			sceneBatch.Render();
+			depthPrepass.EndShading();
+		});
+		frameGraph.Read(shadingPass, sceneDepth);
+		frameGraph.Read(shadingPass, cascadeMap);
+		frameGraph.Read(shadingPass, atlasMap);
+		if (tiled) {
+			frameGraph.Read(shadingPass, tileLights);
+		}
+		frameGraph.Write(shadingPass, sceneColor);
+
+		if (tiled) {
+			unsigned int presentPass = frameGraph.AddPass("present", [&]() {
+				glBlitNamedFramebuffer(frameGraph.GetFramebuffer(&sceneColor, 1, NO_RESOURCE), 0,
+					0, 0, bufferWidth, bufferHeight,
+					0, 0, bufferWidth, bufferHeight,
+					GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				GLState::BindFramebuffer(0);
+			});
+			frameGraph.Read(presentPass, sceneColor);
+			frameGraph.Write(presentPass, backbuffer);
+		}
+	}
+
+	if (frameGraph.Compile()) {
+		frameGraph.Execute();
 	}
+	if (frame.printSchedule) {
+		frameGraph.PrintSchedule();
+	}
+	frameRing.EndFrame();
+	pipelineStatistics.EndFrame();
+	gpuProfiler.EndScope(frameScope);
+	gpuProfiler.EndFrame();
+
+	if (frame.writeTrace) {
+		// CPU zones of every thread and the frame graph's CPU and GPU scopes,
+		// all on the same timeline.
+		ChromeTrace trace;
+		if (trace.Open(traceFile)) {
+			CpuProfiler::AddToTrace(trace);
+			gpuProfiler.AddToTrace(trace);
+			trace.Close();
+		}
+	}
+	calculateFPS(frame);
 }
 void CreateObjects() {
 	unsigned int indices[] = {
@@ -264,35 +944,268 @@ void CreateObjects() {
 
 	calcAverageNormals(indices, 12, vertices, 32, 8, 5);
 
-	Mesh* obj1 = new Mesh();
-	obj1->CreateMesh(vertices, indices, 32, 12);
-	meshList.push_back(obj1);
+	pyramidMesh = sceneBatch.AddMesh(vertices, indices, 32, 12);
+	floorMesh = sceneBatch.AddMesh(floorVertices, floorIndices, 32, 6);
+	if (virtualTextureAvailable) {
+		// The virtual texture covers the floor once instead of tiling.
+		for (int v = 0; v < 4; v++) {
+			floorVertices[v * 8 + 3] /= 10.0f;
+			floorVertices[v * 8 + 4] /= 10.0f;
+		}
+		terrainMesh = sceneBatch.AddMesh(floorVertices, floorIndices, 32, 6);
+	}
+
+	SceneNode floorNode = sceneGraph.AddNode();
+	sceneGraph.SetPosition(floorNode, glm::vec3(0.0f, -1.0f, 0.0f));
+
+	// The transform's world matrix is filled in by the first scene graph update.
+	TransformComponent transform = { glm::mat4(1.0f), sceneGraph.AddNode() };
+	MeshComponent mesh = { pyramidMesh };
+	MaterialComponent material = { pyramidMaterial };
+	Entity pyramid = entityWorld.CreateEntity();
+	entityWorld.AddComponent(pyramid, transform);
+	entityWorld.AddComponent(pyramid, mesh);
+	entityWorld.AddComponent(pyramid, material);
+
+	transform.node = floorNode;
+	mesh.mesh = virtualTextureAvailable ? terrainMesh : floorMesh;
+	material.material = virtualTextureAvailable ? terrainMaterial : floorMaterial;
+	Entity floor = entityWorld.CreateEntity();
+	entityWorld.AddComponent(floor, transform);
+	entityWorld.AddComponent(floor, mesh);
+	entityWorld.AddComponent(floor, material);
+
+}
+void CreateBenchmarkScene() {
+	// A fixed LCG, so every run of a scene builds exactly the same thing.
+	unsigned int state = 12345;
+	auto nextRandom = [&state]() {
+		state = state * 1664525u + 1013904223u;
+		return (state >> 8) / 16777216.0f;
+	};
+
+	auto addPyramid = [](glm::vec3 position, GLfloat scale, unsigned int material) {
+		TransformComponent transform = { glm::mat4(1.0f), sceneGraph.AddNode() };
+		sceneGraph.SetPosition(transform.node, position);
+		sceneGraph.SetScale(transform.node, glm::vec3(scale));
+		MeshComponent mesh = { pyramidMesh };
+		MaterialComponent materialComponent = { material };
+		Entity entity = entityWorld.CreateEntity();
+		entityWorld.AddComponent(entity, transform);
+		entityWorld.AddComponent(entity, mesh);
+		entityWorld.AddComponent(entity, materialComponent);
+	};
 
-	Mesh* obj2 = new Mesh();
-	obj2->CreateMesh(floorVertices, floorIndices, 32, 6);
-	meshList.push_back(obj2);
+	switch (benchmarkScene) {
+	case SCENE_MESHES: {
+		// A grid of small pyramids covering the floor.
+		GLfloat spacing = 20.0f / BENCHMARK_MESH_GRID;
+		GLfloat scale = spacing * 0.4f;
+		for (int z = 0; z < BENCHMARK_MESH_GRID; z++) {
+			for (int x = 0; x < BENCHMARK_MESH_GRID; x++) {
+				glm::vec3 position(-10.0f + (x + 0.5f) * spacing, -1.0f + scale, -10.0f + (z + 0.5f) * spacing);
+				addPyramid(position, scale, (x + z) % 2 ? pyramidMaterial : floorMaterial);
+			}
+		}
+		break;
+	}
+	case SCENE_LIGHTS: {
+		// Small coloured point lights scattered just above the floor.
+		for (int i = 0; i < BENCHMARK_LIGHT_COUNT; i++) {
+			// Drawn one at a time: argument evaluation order isn't fixed.
+			GLfloat values[6];
+			for (int v = 0; v < 6; v++) {
+				values[v] = nextRandom();
+			}
+			PointLightComponent light;
+			light.light = PointLight(
+				values[0], values[1], values[2],
+				+0.0f, +0.8f,
+				values[3] * 20.0f - 10.0f, -0.8f + values[4] * 0.5f, values[5] * 20.0f - 10.0f,
+				+1.0f, +2.0f, +20.0f
+			);
+			entityWorld.AddComponent(entityWorld.CreateEntity(), light);
+		}
+		break;
+	}
+	case SCENE_TEXTURES: {
+		// Large pyramids alternating between the big generated textures.
+		unsigned int materials[BENCHMARK_TEXTURE_COUNT];
+		for (int i = 0; i < BENCHMARK_TEXTURE_COUNT; i++) {
+			materials[i] = materialRegistry.AddMaterial(dullMaterial, benchmarkTextures[i]);
+		}
+		for (int z = 0; z < 4; z++) {
+			for (int x = 0; x < 4; x++) {
+				addPyramid(glm::vec3(-7.5f + x * 5.0f, 0.5f, -7.5f + z * 5.0f), 1.5f, materials[(x + z) % BENCHMARK_TEXTURE_COUNT]);
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
 
+	if (benchmarkScene != SCENE_DEFAULT) {
+		std::cout << "Benchmark scene: " << benchmarkSceneNames[benchmarkScene]
+			<< " (" << entityWorld.GetEntityCount() << " entities)" << std::endl;
+	}
 }
 void CreateShaders() {
 	Shader* shader1 = new Shader();
 	shader1->CreateFromFiles(vShader, fShader);
 	shaderList.push_back(*shader1);
 
+	uniformTiledLighting = shader1->GetUniformLocation("tiledLighting");
+	uniformLightHeatmap = shader1->GetUniformLocation("lightHeatmap");
+	uniformTileCountX = shader1->GetUniformLocation("tileCountX");
+	uniformCascadeMatrices = shader1->GetUniformLocation("cascadeMatrices");
+	uniformCascadeCount = shader1->GetUniformLocation("cascadeCount");
+	uniformAtlasShadows = shader1->GetUniformLocation("atlasShadows");
+
 
 }
-void calculateFPS() {
-	float currentTime = (float)glfwGetTime(); // Or GetTickCount() for Windows
-	float timeDelta = currentTime - lastTime_FPS;
+void calculateFPS(const FramePacket& frame) {
+	double currentTime = renderTimer.GetTime();
+	double timeDelta = currentTime - lastTime_FPS;
 
 	nbFrames++;
 
-	if (timeDelta >= 1.0f) {
-		fps = (float)nbFrames / timeDelta;
-		std::cout << "FPS: " << fps << std::endl;
+	if (timeDelta >= 1.0) {
+		fps = nbFrames / timeDelta;
+		GLState::FrameStats glStats = GLState::GetLastFrameStats();
+		std::cout << "FPS: " << fps
+			<< " | GL state calls issued: " << glStats.issued
+			<< ", elided: " << glStats.elided << std::endl;
+
+		FrameTimer::FrameTimeStats frameTimes = renderTimer.GetStats();
+		std::cout << "Frame time over the last " << frameTimes.frames << " frames (ms): mean " << frameTimes.meanMs
+			<< " | p50 " << frameTimes.p50Ms
+			<< " | p95 " << frameTimes.p95Ms
+			<< " | p99 " << frameTimes.p99Ms
+			<< " | max " << frameTimes.maxMs << std::endl;
+
+		FrameGraph::MemoryStats graphStats = frameGraph.GetLastStats();
+		const double megabyte = 1024.0 * 1024.0;
+		std::cout << "Frame graph passes: " << graphStats.passCount - graphStats.passesCulled
+			<< " (" << graphStats.passesCulled << " culled)"
+			<< " | transient textures: " << graphStats.declaredBytes / megabyte << " MB declared, "
+			<< graphStats.allocatedBytes / megabyte << " MB allocated, "
+			<< (graphStats.declaredBytes - graphStats.allocatedBytes) / megabyte << " MB saved by aliasing"
+			<< " | pool: " << graphStats.pooledBytes / megabyte << " MB" << std::endl;
+
+		GpuMemory::Stats memoryStats = GpuMemory::GetStats();
+		std::cout << "GPU memory: " << memoryStats.totalBytes / megabyte << " MB (peak " << memoryStats.peakBytes / megabyte << " MB";
+		if (memoryStats.budgetBytes > 0) {
+			std::cout << ", budget " << memoryStats.budgetBytes / megabyte << " MB, " << memoryStats.evictions << " evictions, "
+				<< memoryStats.overBudgetAllocations << " allocations over";
+		}
+		std::cout << ")";
+		for (int c = 0; c < GPU_MEMORY_CATEGORY_COUNT; c++) {
+			const GpuMemory::CategoryStats& category = memoryStats.categories[c];
+			std::cout << " | " << GpuMemory::GetCategoryName(static_cast<GpuMemoryCategory>(c)) << " "
+				<< category.bytes / megabyte << " MB in " << category.allocations;
+		}
+		std::cout << std::endl;
+
+		if (textureLibrary.IsStreaming()) {
+			TextureStreamer::StreamStats streamStats = textureStreamer.GetLastStats();
+			std::cout << "Texture streaming: " << streamStats.residentBytes / megabyte << " MB resident"
+				<< " | wanted " << streamStats.wantedBytes / megabyte << " MB of " << streamStats.budgetBytes / megabyte << " MB budget"
+				<< " (mip bias " << streamStats.bias << ")"
+				<< " | last frame: " << streamStats.levelsIn << " levels in, " << streamStats.levelsOut << " out, "
+				<< streamStats.uploadedBytes / megabyte << " MB uploaded" << std::endl;
+		}
+		if (virtualTextureAvailable) {
+			VirtualTexture::VirtualTextureStats virtualStats = virtualTexture.TakeStats();
+			std::cout << "Virtual texture: " << virtualStats.residentPages << " of "
+				<< VirtualTexture::CACHE_PAGES_PER_SIDE * VirtualTexture::CACHE_PAGES_PER_SIDE << " cache pages in use"
+				<< " | requested " << virtualStats.pagesRequested << ", " << virtualStats.pagesMissing << " drawn coarser"
+				<< " | " << virtualStats.loadsPending << " loads pending"
+				<< " | last second: " << virtualStats.pagesUploaded << " pages in, " << virtualStats.pagesEvicted << " evicted, "
+				<< virtualStats.feedbackDropped << " feedback frames dropped" << std::endl;
+		}
+
+		RenderThread::PipelineStats pipelineStats = renderThread.TakeStats();
+		pipelineStats.frames = pipelineStats.frames > 0 ? pipelineStats.frames : 1;
+		std::cout << "Draws recorded: " << frame.draws.size()
+			<< " (" << frame.drawsCulled << " outside the view)"
+			<< " | simulation waited " << pipelineStats.simulationWaitMs / pipelineStats.frames << " ms/frame"
+			<< ", render thread idle " << pipelineStats.renderWaitMs / pipelineStats.frames << " ms/frame" << std::endl;
+
+		if (profilerAvailable) {
+			std::vector<GpuProfiler::ScopeTiming> timings = gpuProfiler.GetAverages(nbFrames);
+			std::cout << "Scope timings (CPU / GPU ms):";
+			for (size_t i = 0; i < timings.size(); i++) {
+				// Scopes that didn't run lately (another render mode's passes) are skipped.
+				if (timings[i].cpuMs > 0.0 || timings[i].gpuMs > 0.0) {
+					std::cout << " " << timings[i].name << " " << timings[i].cpuMs << " / " << timings[i].gpuMs << " |";
+				}
+			}
+			std::cout << " profiler frames dropped: " << gpuProfiler.GetDroppedFrameCount() << std::endl;
+		}
+		if (statisticsAvailable) {
+			std::cout << "Pipeline statistics per frame (" << pipelineStatistics.GetDroppedFrameCount() << " frames dropped):" << std::endl;
+			printPipelineStatistics(pipelineStatistics.TakeAverages());
+		}
+
+		if (frame.shadows) {
+			CascadedShadowMap::UpdateStats shadowStats = cascadedShadows.GetLastStats();
+			std::cout << "Shadow cascades rendered: " << shadowStats.rendered
+				<< ", cached: " << shadowStats.cached
+				<< ", deferred: " << shadowStats.deferred
+				<< " | casters culled: " << shadowStats.castersCulled << std::endl;
+		}
+		if (frame.lightShadows) {
+			ShadowAtlas::UpdateStats atlasStats = shadowAtlas.GetLastStats();
+			std::cout << "Shadow atlas tiles: " << atlasStats.tilesInUse
+				<< " | lights rendered: " << atlasStats.rendered
+				<< ", pending: " << atlasStats.pending
+				<< " | estimated " << atlasStats.estimatedMs << " ms, measured " << atlasStats.measuredMs << " ms" << std::endl;
+		}
+
+		if (frame.renderMode == RENDER_FORWARD || frame.renderMode == RENDER_TILED) {
+			DepthPrepass::OverdrawStats overdraw = depthPrepass.GetLastStats();
+			double pixels = (double)frame.bufferWidth * frame.bufferHeight;
+			std::cout << "Shaded fragments: " << overdraw.shadedFragments
+				<< " (" << overdraw.shadedFragments / pixels << " per pixel)";
+			if (depthPrepass.IsActive()) {
+				std::cout << " | depth pass fragments: " << overdraw.depthFragments
+					<< " (" << overdraw.depthFragments / pixels << " per pixel)";
+			}
+			std::cout << std::endl;
+		}
 		nbFrames = 0;
 		lastTime_FPS = currentTime;
 	}
 }
+void printPipelineStatistics(const std::vector<PipelineStatistics::PassStatistics>& passes) {
+	for (size_t i = 0; i < passes.size(); i++) {
+		const double* counters = passes[i].counters;
+		bool ran = false;
+		for (int c = 0; c < PipelineStatistics::COUNTER_COUNT; c++) {
+			ran = ran || counters[c] > 0.0;
+		}
+		// Passes of other render modes that didn't run lately are skipped.
+		if (!ran) {
+			continue;
+		}
+
+		std::cout << "  " << passes[i].name << ":";
+		for (int c = 0; c < PipelineStatistics::COUNTER_COUNT; c++) {
+			if (counters[c] > 0.0) {
+				std::cout << " " << PipelineStatistics::GetCounterName(static_cast<PipelineStatistics::Counter>(c))
+					<< " " << static_cast<GLuint64>(counters[c]) << " |";
+			}
+		}
+		// Many fragments per primitive that survives clipping points at
+		// fragment-bound, few at vertex-bound.
+		double primitives = counters[PipelineStatistics::CLIPPING_OUTPUT_PRIMITIVES];
+		if (primitives > 0.0) {
+			std::cout << " fragments per primitive " << counters[PipelineStatistics::FRAGMENT_SHADER_INVOCATIONS] / primitives;
+		}
+		std::cout << std::endl;
+	}
+}
 void calcAverageNormals(
 	unsigned int* indices,
 	unsigned int indexCount,
@@ -301,26 +1214,39 @@ void calcAverageNormals(
 	unsigned int vLength,
 	unsigned int normalOffset
 ) {
-	for (size_t i = 0; i < indexCount; i += 3) {
-
-		unsigned int in0 = indices[i] * vLength;
-		unsigned int in1 = indices[i + 1] * vLength;
-		unsigned int in2 = indices[i + 2] * vLength;
+	// Face normals don't depend on each other, so they're computed as jobs.
+	// Adding them into shared vertices stays serial.
+	const size_t FACES_PER_JOB = 1024;
+	size_t faceCount = indexCount / 3;
+	std::vector<glm::vec3> faceNormals(faceCount);
+	jobSystem.ParallelFor(faceCount, FACES_PER_JOB, [&](size_t begin, size_t end) {
+		for (size_t face = begin; face < end; face++) {
+			unsigned int in0 = indices[face * 3] * vLength;
+			unsigned int in1 = indices[face * 3 + 1] * vLength;
+			unsigned int in2 = indices[face * 3 + 2] * vLength;
 
-		glm::vec3 v1(vertices[in1] - vertices[in0], vertices[in1 + 1] - vertices[in0 + 1], vertices[in1 + 2] - vertices[in0 + 2]);
-		glm::vec3 v2(vertices[in2] - vertices[in0], vertices[in2 + 1] - vertices[in0 + 1], vertices[in2 + 2] - vertices[in0 + 2]);
-		glm::vec3 normal = glm::cross(v1, v2);
-		normal = glm::normalize(normal);
+			glm::vec3 v1(vertices[in1] - vertices[in0], vertices[in1 + 1] - vertices[in0 + 1], vertices[in1 + 2] - vertices[in0 + 2]);
+			glm::vec3 v2(vertices[in2] - vertices[in0], vertices[in2 + 1] - vertices[in0 + 1], vertices[in2 + 2] - vertices[in0 + 2]);
+			faceNormals[face] = glm::normalize(glm::cross(v1, v2));
+		}
+	});
 
-		in0 += normalOffset; in1 += normalOffset; in2 += normalOffset;
+	for (size_t face = 0; face < faceCount; face++) {
+		glm::vec3 normal = faceNormals[face];
+		unsigned int in0 = indices[face * 3] * vLength + normalOffset;
+		unsigned int in1 = indices[face * 3 + 1] * vLength + normalOffset;
+		unsigned int in2 = indices[face * 3 + 2] * vLength + normalOffset;
 		vertices[in0] += normal.x; vertices[in0 + 1] += normal.y; vertices[in0 + 2] += normal.z;
 		vertices[in1] += normal.x; vertices[in1 + 1] += normal.y; vertices[in1 + 2] += normal.z;
 		vertices[in2] += normal.x; vertices[in2 + 1] += normal.y; vertices[in2 + 2] += normal.z;
 	}
-	for (unsigned int i = 0; i < vertexCount / vLength; i++) {
-		unsigned int nOffset = i * vLength + normalOffset;
-		glm::vec3 vec(vertices[nOffset], vertices[nOffset + 1], vertices[nOffset + 2]);
-		vec = glm::normalize(vec);
-		vertices[nOffset] = vec.x; vertices[nOffset + 1] = vec.y; vertices[nOffset + 2] = vec.z;
-	}
+
+	jobSystem.ParallelFor(vertexCount / vLength, FACES_PER_JOB, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			size_t nOffset = i * vLength + normalOffset;
+			glm::vec3 vec(vertices[nOffset], vertices[nOffset + 1], vertices[nOffset + 2]);
+			vec = glm::normalize(vec);
+			vertices[nOffset] = vec.x; vertices[nOffset + 1] = vec.y; vertices[nOffset + 2] = vec.z;
+		}
+	});
 }
\ No newline at end of file
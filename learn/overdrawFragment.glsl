@@ -0,0 +1,10 @@
+#version 460
+
+out vec4 color;
+
+// Added once per fragment: 8 layers saturate red, 16 orange-yellow, 32 white.
+const vec4 LAYER_COLOR = vec4(1.0 / 8.0, 1.0 / 16.0, 1.0 / 32.0, 1.0);
+
+void main() {
+	color = LAYER_COLOR;
+}
@@ -0,0 +1,38 @@
+#version 460 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 tex;
+layout(location = 2) in vec3 norm;
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec3 FragPos;
+flat out uint DrawIndex;
+
+// vertexShader.glsl as it was before mvp and normalMatrix moved to the CPU:
+// both are rebuilt for every vertex. Only --vertex-benchmark uses it, as the
+// baseline the CPU path is measured against.
+struct DrawData {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+	uint materialIndex;
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+	DrawData draws[];
+};
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main() {
+    mat4 model = draws[gl_DrawID].model;
+
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    TexCoord = tex;
+
+    Normal = mat3(transpose(inverse(model))) * norm;
+    FragPos = (model * vec4(position, 1.0)).xyz;
+    DrawIndex = gl_DrawID;
+}
@@ -0,0 +1,108 @@
+#version 460
+
+const int TILE_SIZE = 16;
+const int MAX_LIGHTS_PER_TILE = 64;
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+struct LightData {
+	vec4 positionRange;
+	vec4 colorAmbient;
+	vec4 directionEdge;
+	vec4 attenuation;
+	uint type;
+	uint shadowIndex;
+	uint pad0;
+	uint pad1;
+};
+
+layout(std430, binding = 2) readonly buffer LightBuffer {
+	LightData lights[];
+};
+
+layout(std430, binding = 3) writeonly buffer TileBuffer {
+	uint tileLights[];
+};
+
+layout(binding = 8) uniform sampler2D sceneDepth;
+
+uniform mat4 view;
+uniform mat4 inverseProjection;
+uniform uint lightCount;
+uniform ivec2 screenSize;
+
+// Depths are in [0, 1], so their bit patterns sort like the floats do.
+shared uint minDepthBits;
+shared uint maxDepthBits;
+shared uint tileLightCount;
+shared uint tileLightIndices[MAX_LIGHTS_PER_TILE];
+
+vec3 Unproject(vec2 ndc, float depth) {
+	vec4 position = inverseProjection * vec4(ndc, depth * 2.0f - 1.0f, 1.0f);
+	return position.xyz / position.w;
+}
+
+void main() {
+	uint threadIndex = gl_LocalInvocationIndex;
+	uint threadCount = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+	if (threadIndex == 0) {
+		minDepthBits = 0xFFFFFFFFu;
+		maxDepthBits = 0u;
+		tileLightCount = 0u;
+	}
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (pixel.x < screenSize.x && pixel.y < screenSize.y) {
+		float depth = texelFetch(sceneDepth, pixel, 0).r;
+		// Cleared pixels have nothing to light.
+		if (depth < 1.0f) {
+			atomicMin(minDepthBits, floatBitsToUint(depth));
+			atomicMax(maxDepthBits, floatBitsToUint(depth));
+		}
+	}
+	barrier();
+
+	if (minDepthBits <= maxDepthBits) {
+		float minDepth = uintBitsToFloat(minDepthBits);
+		float maxDepth = uintBitsToFloat(maxDepthBits);
+
+		// View-space box around the part of the tile's frustum that holds geometry.
+		vec2 tileMin = vec2(gl_WorkGroupID.xy * TILE_SIZE) / vec2(screenSize) * 2.0f - 1.0f;
+		vec2 tileMax = vec2((gl_WorkGroupID.xy + 1u) * TILE_SIZE) / vec2(screenSize) * 2.0f - 1.0f;
+
+		vec3 boxMin = vec3(1e30f);
+		vec3 boxMax = vec3(-1e30f);
+		for (int i = 0; i < 8; i++) {
+			vec2 ndc = vec2((i & 1) != 0 ? tileMax.x : tileMin.x, (i & 2) != 0 ? tileMax.y : tileMin.y);
+			vec3 corner = Unproject(ndc, (i & 4) != 0 ? maxDepth : minDepth);
+			boxMin = min(boxMin, corner);
+			boxMax = max(boxMax, corner);
+		}
+
+		for (uint i = threadIndex; i < lightCount; i += threadCount) {
+			vec3 center = (view * vec4(lights[i].positionRange.xyz, 1.0f)).xyz;
+			float range = lights[i].positionRange.w;
+
+			vec3 offset = center - clamp(center, boxMin, boxMax);
+			if (dot(offset, offset) <= range * range) {
+				uint slot = atomicAdd(tileLightCount, 1u);
+				if (slot < MAX_LIGHTS_PER_TILE) {
+					tileLightIndices[slot] = i;
+				}
+			}
+		}
+	}
+	barrier();
+
+	uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+	uint base = tile * (MAX_LIGHTS_PER_TILE + 1);
+	uint count = min(tileLightCount, uint(MAX_LIGHTS_PER_TILE));
+	if (threadIndex == 0) {
+		tileLights[base] = count;
+	}
+	for (uint i = threadIndex; i < count; i += threadCount) {
+		tileLights[base + 1 + i] = tileLightIndices[i];
+	}
+}
@@ -0,0 +1,14 @@
+#version 460 core
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragPos;
+flat in uint DrawIndex;
+
+out vec4 color;
+
+// Reads every vertex output so none of them is compiled away; the benchmark
+// discards primitives before rasterisation, so this never actually runs.
+void main() {
+	color = vec4(Normal + FragPos, TexCoord.x + TexCoord.y + float(DrawIndex));
+}
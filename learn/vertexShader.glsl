@@ -7,15 +7,31 @@ layout(location = 2) in vec3 norm;
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
+flat out uint DrawIndex;
 
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+// The depth pre-pass computes gl_Position the same way; invariance keeps the
+// two bit-identical so the GL_EQUAL shading pass never drops fragments.
+invariant gl_Position;
+
+struct DrawData {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+	uint materialIndex;
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+	DrawData draws[];
+};
 
 void main() {
-    gl_Position =  projection * view * model * vec4(position, 1.0);
+    // mvp and normalMatrix are computed per object on the CPU.
+    DrawData draw = draws[gl_DrawID];
+
+    gl_Position = draw.mvp * vec4(position, 1.0);
     TexCoord = tex;
 
-    Normal = mat3(transpose(inverse(model))) * norm;
-    FragPos = (model * vec4(position, 1.0)).xyz;
+    Normal = draw.normalMatrix * norm;
+    FragPos = (draw.model * vec4(position, 1.0)).xyz;
+    DrawIndex = gl_DrawID;
 }
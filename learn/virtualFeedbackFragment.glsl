@@ -0,0 +1,53 @@
+#version 460
+
+in vec2 TexCoord;
+in vec3 Normal;
+in vec3 FragPos;
+flat in uint DrawIndex;
+
+// The virtual texture page this pixel samples, packed as valid bit, level,
+// page y and page x; zero where nothing virtual is drawn.
+layout(location = 0) out uint request;
+
+const uint FEEDBACK_VALID_BIT = 0x80000000u;
+
+struct DrawData {
+	mat4 model;
+	mat4 mvp;
+	mat3 normalMatrix;
+	uint materialIndex;
+};
+struct Material {
+	float specularIntensity;
+	float shininess;
+	uint textureArray;
+	uint textureLayer;
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer {
+	DrawData draws[];
+};
+
+layout(std430, binding = 1) readonly buffer MaterialBuffer {
+	Material materials[];
+};
+
+#include "virtualTexture.glsl"
+
+// The pass renders below screen resolution; this brings the level back to
+// the one shading will pick.
+uniform float lodBias;
+
+void main() {
+	Material material = materials[draws[DrawIndex].materialIndex];
+	if (material.textureArray != VIRTUAL_TEXTURE_ARRAY) {
+		request = 0u;
+		return;
+	}
+
+	vec2 uv = clamp(TexCoord, 0.0f, 0.99999f);
+	int level = VirtualTextureLevel(uv, lodBias);
+
+	uvec2 page = uvec2(uv * float(textureSize(virtualPageTable, level).x));
+	request = FEEDBACK_VALID_BIT | uint(level) << 24 | page.y << 12 | page.x;
+}
@@ -0,0 +1,33 @@
+// Virtual texture sampling, included by every shader that shades or requests
+// virtual texture pages so they all agree on the level a pixel needs.
+//
+// The page table has a texel per page and a mip per level, holding the cache
+// slot and level of the page to sample. Pages that aren't resident point at
+// their closest resident ancestor.
+
+const uint VIRTUAL_TEXTURE_ARRAY = 4u;
+const float VIRTUAL_PAGE_SIZE = 128.0f;
+const float VIRTUAL_PAGE_BORDER = 1.0f;
+layout(binding = 11) uniform usampler2D virtualPageTable;
+layout(binding = 12) uniform sampler2D virtualPageCache;
+
+// uv is already clamped inside the texture.
+int VirtualTextureLevel(vec2 uv, float lodBias) {
+	int levels = textureQueryLevels(virtualPageTable);
+	vec2 texel = uv * float(textureSize(virtualPageTable, 0).x) * VIRTUAL_PAGE_SIZE;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float lod = 0.5f * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8f)) + lodBias;
+	return clamp(int(floor(lod)), 0, levels - 1);
+}
+
+vec4 SampleVirtualTexture(vec2 uv) {
+	uv = clamp(uv, 0.0f, 0.99999f);
+	int level = VirtualTextureLevel(uv, 0.0f);
+
+	uvec4 entry = texelFetch(virtualPageTable, ivec2(uv * float(textureSize(virtualPageTable, level).x)), level);
+	vec2 inPage = fract(uv * float(textureSize(virtualPageTable, int(entry.z)).x));
+	vec2 cacheTexel = vec2(entry.xy) * (VIRTUAL_PAGE_SIZE + 2.0f * VIRTUAL_PAGE_BORDER)
+		+ VIRTUAL_PAGE_BORDER + inPage * VIRTUAL_PAGE_SIZE;
+	return textureLod(virtualPageCache, cacheTexel / vec2(textureSize(virtualPageCache, 0)), 0.0f);
+}